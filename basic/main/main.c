@@ -128,6 +128,15 @@ void wifi_init_sta(void)
 
 void app_main()
 {
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE
+	// Keep the records of the WiFi connection until the network is up
+#if CONFIG_WRITE_TO_STDOUT
+	net_logging_early_init(1);
+#else
+	net_logging_early_init(0);
+#endif
+#endif
+
 	//Initialize NVS
 	esp_err_t ret = nvs_flash_init();
 	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -0,0 +1,454 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Collector for a fleet of devices.
+# UDP, TCP, HTTP and MQTT inputs are served by one asyncio loop.
+# The records of each device are written to their own rotating file.
+
+import argparse
+import asyncio
+import collections
+import json
+import os
+import re
+import socket
+import sys
+import time
+import netlog
+
+# Datagrams read for one readiness event, like one recvmmsg call
+UDP_DRAIN_MAX = 256
+UDP_RECEIVE_BUFFER = 4 * 1024 * 1024
+TCP_READ_SIZE = 65536
+HTTP_HEADER_MAX = 8192
+# Statistics record of the device, see NET_LOGGING_STATS_INTERVAL
+STATS_TAG = 'netlog_stats:'
+STATS_RECORD = re.compile(r'netlog_stats: ((?:\w+=[\w,]+ ?)+)')
+
+class DeviceLog:
+	"""Buffered output file of one device, rotated by size."""
+	def __init__(self, output, name):
+		self.output = output
+		self.path = os.path.join(output.directory, name + '.log')
+		self.buffer = []
+		self.buffered = 0
+		self.file = None
+		self.size = os.path.getsize(self.path) if os.path.exists(self.path) else 0
+
+	def write(self, text):
+		self.buffer.append(text)
+		self.buffered += len(text)
+		if self.buffered >= self.output.buffer_size: self.flush()
+
+	def flush(self):
+		if not self.buffer: return
+		data = ''.join(self.buffer).encode('utf-8', errors='replace')
+		self.buffer = []
+		self.buffered = 0
+		if self.file is None: self.file = self.output.open(self)
+		self.file.write(data)
+		self.size += len(data)
+		if self.size >= self.output.max_bytes: self.rotate()
+
+	def close(self):
+		if self.file is None: return
+		self.file.close()
+		self.file = None
+
+	def rotate(self):
+		self.output.close(self)
+		count = self.output.backup_count
+		if count > 0:
+			for i in range(count - 1, 0, -1):
+				older = '{}.{}'.format(self.path, i)
+				if os.path.exists(older): os.replace(older, '{}.{}'.format(self.path, i + 1))
+			os.replace(self.path, self.path + '.1')
+		else:
+			os.remove(self.path)
+		self.size = 0
+
+class Output:
+	"""Files of all devices, only the most recently used ones are kept open."""
+	def __init__(self, args):
+		self.directory = args.outdir
+		self.max_bytes = args.max_bytes
+		self.backup_count = args.backup_count
+		self.buffer_size = args.buffer_size
+		self.max_open = args.max_open
+		self.echo = args.echo
+		self.devices = {}
+		self.opened = collections.OrderedDict()
+		self.lines = 0
+		self.bytes = 0
+		# Last netlog_stats record of each device, per sink
+		self.device_stats = {}
+		os.makedirs(self.directory, exist_ok=True)
+
+	def write(self, device, text):
+		if not text: return
+		if self.echo: print(text, end='')
+		name = re.sub(r'[^0-9A-Za-z._-]', '_', device)
+		log = self.devices.get(name)
+		if log is None:
+			log = self.devices[name] = DeviceLog(self, name)
+		log.write(text)
+		self.lines += text.count('\n')
+		self.bytes += len(text)
+		if STATS_TAG in text: self.stats(device, text)
+
+	def stats(self, device, text):
+		for match in STATS_RECORD.finditer(text):
+			fields = dict(field.split('=', 1) for field in match.group(1).split())
+			self.device_stats.setdefault(device, {})[fields.pop('sink', '')] = fields
+
+	def open(self, log):
+		while len(self.opened) >= self.max_open:
+			oldest, _ = self.opened.popitem(last=False)
+			oldest.close()
+		# Buffered by DeviceLog, the file itself writes through
+		file = open(log.path, 'ab', buffering=0)
+		self.opened[log] = True
+		return file
+
+	def close(self, log):
+		self.opened.pop(log, None)
+		log.close()
+
+	def flush(self):
+		for log in self.devices.values(): log.flush()
+
+	def close_all(self):
+		self.flush()
+		for log in list(self.opened): self.close(log)
+
+def decode_datagram(parser, data):
+	parser.new_datagram()
+	text = ''.join(parser.feed(data))
+	# A datagram ends the last record
+	if text and not text.endswith('\n'): text += '\n'
+	return text
+
+class UdpInput:
+	"""Every datagram that is waiting is read for one readiness event."""
+	def __init__(self, loop, output, args):
+		self.output = output
+		self.format = args.format
+		self.elf = args.elf
+		self.control = args.control
+		self.parsers = {}
+		# Sequence frames of each device
+		self.trackers = {}
+		self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+		self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+		self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, UDP_RECEIVE_BUFFER)
+		self.sock.bind(('0.0.0.0', args.udp))
+		self.sock.setblocking(False)
+		loop.add_reader(self.sock.fileno(), self.readable)
+
+	def readable(self):
+		for _ in range(UDP_DRAIN_MAX):
+			try:
+				data, address = self.sock.recvfrom(65535)
+			except (BlockingIOError, InterruptedError):
+				break
+			self.datagram(data, address)
+
+	def datagram(self, data, address):
+		parser = self.parsers.get(address)
+		if parser is None:
+			if self.format == 'gelf':
+				parser = netlog.GelfReassembler()
+			else:
+				parser = netlog.RecordParser(self.elf)
+			self.parsers[address] = parser
+			# The device reads control packets on the socket it sends from
+			if self.control: self.sock.sendto(self.control.encode(), address)
+		device = address[0]
+		try:
+			if self.format == 'syslog':
+				self.output.write(device, netlog.format_syslog(netlog.parse_syslog(data)))
+			elif self.format == 'gelf':
+				message = parser.feed(data)
+				if message is not None: self.output.write(device, netlog.format_gelf(message))
+			else:
+				text = decode_datagram(parser, data)
+				if parser.sequence is not None: self.sequence(device, parser.sequence)
+				self.output.write(device, text)
+		except ValueError as e:
+			self.output.write(device, '[invalid {} message: {}]\n'.format(self.format, e))
+
+	def sequence(self, device, sequence):
+		tracker = self.trackers.get(device)
+		if tracker is None: tracker = self.trackers[device] = netlog.LossTracker()
+		reboots = tracker.reboots
+		lost = tracker.update(*sequence)
+		if tracker.reboots != reboots: self.output.write(device, '[restarted]\n')
+		if lost: self.output.write(device, '[{} datagrams lost]\n'.format(lost))
+
+# Prometheus metric name, help and LossTracker attribute
+LOSS_METRICS = [
+	('netlog_datagrams_received_total', 'counter', 'Datagrams received', 'received'),
+	('netlog_records_received_total', 'counter', 'Records in the received datagrams', 'records'),
+	('netlog_datagrams_lost', 'gauge', 'Datagrams that have not arrived', 'lost'),
+	('netlog_datagram_loss_ratio', 'gauge', 'Lost datagrams over all datagrams sent', 'loss_ratio'),
+	('netlog_gaps_total', 'counter', 'Jumps in the sequence numbers', 'gaps'),
+	('netlog_datagrams_reordered_total', 'counter', 'Datagrams that arrived after a later one', 'reordered'),
+	('netlog_reorder_depth_max', 'gauge', 'Largest number of datagrams a late datagram was behind', 'reorder_depth'),
+	('netlog_datagrams_duplicated_total', 'counter', 'Datagrams received twice', 'duplicates'),
+	('netlog_reboots_total', 'counter', 'New boot ids seen', 'reboots'),
+]
+
+def loss_metrics(trackers):
+	lines = []
+	for name, kind, text, attribute in LOSS_METRICS:
+		lines.append('# HELP {} {}'.format(name, text))
+		lines.append('# TYPE {} {}'.format(name, kind))
+		for device, tracker in sorted(trackers.items()):
+			lines.append('{}{{device="{}"}} {}'.format(name, device, getattr(tracker, attribute)))
+	return '\n'.join(lines) + '\n'
+
+# Prometheus metric name, help and field of the netlog_stats record
+DEVICE_METRICS = [
+	('netlog_device_enqueued_total', 'counter', 'Records written to the buffer', 'enqueued'),
+	('netlog_device_dispatched_total', 'counter', 'Records moved to the sinks', 'dispatched'),
+	('netlog_device_dropped_total', 'counter', 'Records dropped when the buffer was full', 'dropped'),
+	('netlog_device_suppressed_total', 'counter', 'Records over the rate limit of their tag', 'suppressed'),
+	('netlog_device_buffer_bytes', 'gauge', 'Size of the buffer', 'buffer_size'),
+	('netlog_device_buffer_high_water_bytes', 'gauge', 'Largest number of bytes in the buffer', 'buffer_hwm'),
+	('netlog_device_vprintf_calls_total', 'counter', 'Calls of the log function', 'vprintf_calls'),
+	('netlog_device_vprintf_seconds_total', 'counter', 'Time spent in the log function', 'vprintf_us'),
+	('netlog_device_vprintf_max_seconds', 'gauge', 'Longest call of the log function', 'vprintf_max_us'),
+]
+SINK_METRICS = [
+	('netlog_sink_bytes_total', 'counter', 'Bytes sent', 'bytes'),
+	('netlog_sink_packets_total', 'counter', 'Packets sent', 'packets'),
+	('netlog_sink_errors_total', 'counter', 'Failed sends', 'errors'),
+	('netlog_sink_lost_total', 'counter', 'Records overwritten before the sink read them', 'lost'),
+	('netlog_sink_backlog_high_water_bytes', 'gauge', 'Largest number of bytes waiting for the sink', 'backlog_hwm'),
+]
+
+def device_metrics(device_stats):
+	lines = []
+	for name, kind, text, field in DEVICE_METRICS:
+		lines.append('# HELP {} {}'.format(name, text))
+		lines.append('# TYPE {} {}'.format(name, kind))
+		for device, sinks in sorted(device_stats.items()):
+			value = sinks.get('', {}).get(field)
+			if value is None: continue
+			# Microseconds on the device
+			if name.endswith('seconds_total') or name.endswith('seconds'): value = int(value) / 1e6
+			lines.append('{}{{device="{}"}} {}'.format(name, device, value))
+	for name, kind, text, field in SINK_METRICS:
+		lines.append('# HELP {} {}'.format(name, text))
+		lines.append('# TYPE {} {}'.format(name, kind))
+		for device, sinks in sorted(device_stats.items()):
+			for sink, fields in sorted(sinks.items()):
+				if sink and field in fields: lines.append('{}{{device="{}",sink="{}"}} {}'.format(name, device, sink, fields[field]))
+	# Bucket n of the device counts latencies below 2^n ms, the last one everything above
+	name = 'netlog_sink_latency_seconds'
+	lines.append('# HELP {} Time from logging to sending the oldest record of a packet'.format(name))
+	lines.append('# TYPE {} histogram'.format(name))
+	for device, sinks in sorted(device_stats.items()):
+		for sink, fields in sorted(sinks.items()):
+			if not sink or 'latency_ms' not in fields: continue
+			counts = [int(count) for count in fields['latency_ms'].split(',')]
+			labels = 'device="{}",sink="{}"'.format(device, sink)
+			total = 0
+			for bucket, count in enumerate(counts):
+				total += count
+				le = '+Inf' if bucket == len(counts) - 1 else repr(((1 << bucket) - 1) / 1000)
+				lines.append('{}_bucket{{{},le="{}"}} {}'.format(name, labels, le, total))
+			lines.append('{}_count{{{}}} {}'.format(name, labels, total))
+	return '\n'.join(lines) + '\n'
+
+async def metrics_connection(output, udp_input, reader, writer):
+	"""Serve the loss and device metrics in the Prometheus text format to any request."""
+	try:
+		await reader.readuntil(b'\r\n\r\n')
+		body = loss_metrics(udp_input.trackers if udp_input else {}) + device_metrics(output.device_stats)
+		body = body.encode()
+		writer.write(('HTTP/1.1 200 OK\r\n'
+			'Content-Type: text/plain; version=0.0.4\r\n'
+			'Content-Length: {}\r\n'
+			'Connection: close\r\n\r\n').format(len(body)).encode() + body)
+		await writer.drain()
+	except (asyncio.IncompleteReadError, asyncio.LimitOverrunError, ConnectionError):
+		pass
+	finally:
+		writer.close()
+
+async def tcp_connection(output, args, reader, writer):
+	device = writer.get_extra_info('peername')[0]
+	parser = netlog.RecordParser(args.elf)
+	framing = netlog.OctetCounting()
+	try:
+		while True:
+			data = await reader.read(TCP_READ_SIZE)
+			if not data: break
+			if args.format == 'syslog':
+				for message in framing.feed(data):
+					output.write(device, netlog.format_syslog(netlog.parse_syslog(message)))
+			else:
+				# A record may continue in the next read
+				output.write(device, ''.join(parser.feed(data)))
+	except ValueError as e:
+		# The stream cannot be resynchronized
+		output.write(device, '[invalid syslog message: {}]\n'.format(e))
+	except ConnectionError:
+		pass
+	finally:
+		writer.close()
+
+async def http_connection(output, reader, writer):
+	device = writer.get_extra_info('peername')[0]
+	try:
+		while True:
+			try:
+				header = await reader.readuntil(b'\r\n\r\n')
+			except asyncio.LimitOverrunError:
+				break
+			lines = header.decode('latin-1').split('\r\n')
+			method = lines[0].split(' ')[0]
+			headers = {}
+			for line in lines[1:]:
+				if ':' in line:
+					key, value = line.split(':', 1)
+					headers[key.strip().lower()] = value.strip()
+			body = await reader.readexactly(int(headers.get('content-length', '0')))
+			if method == 'POST':
+				if headers.get('content-encoding') == netlog.COMPRESS_ENCODING:
+					body = netlog.decompress_frame(body)
+				text = body.decode('utf-8', errors='replace')
+				# A batched post is a JSON array of records
+				try:
+					records = json.loads(text)
+				except ValueError:
+					records = None
+				if type(records) is not list: records = [text]
+				output.write(device, ''.join('{}\n'.format(record) for record in records))
+			reply = 'OK'
+			writer.write(('HTTP/1.1 200 OK\r\n'
+				'Content-Type: text/html; charset=utf-8\r\n'
+				'Content-Length: {}\r\n'
+				'Accept-Encoding: {}\r\n'
+				'\r\n{}').format(len(reply), netlog.COMPRESS_ENCODING, reply).encode())
+			await writer.drain()
+			if headers.get('connection', '').lower() == 'close': break
+	except (asyncio.IncompleteReadError, ConnectionError, ValueError):
+		pass
+	finally:
+		writer.close()
+
+def start_mqtt(loop, output, args):
+	"""Subscribe with paho-mqtt, which runs its own thread."""
+	try:
+		import paho.mqtt.client as mqtt
+	except ImportError:
+		print("--mqtt needs paho-mqtt: pip install paho-mqtt")
+		sys.exit(1)
+	try:
+		client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+	except AttributeError:
+		client = mqtt.Client()
+
+	def on_connect(client, *args_):
+		client.subscribe(args.mqtt_topic)
+
+	def on_message(client, userdata, message):
+		text = message.payload.decode('utf-8', errors='replace')
+		if not text.endswith('\n'): text += '\n'
+		# Devices are told apart by their topic
+		loop.call_soon_threadsafe(output.write, 'mqtt' + message.topic, text)
+
+	client.on_connect = on_connect
+	client.on_message = on_message
+	host, _, port = args.mqtt.partition(':')
+	client.connect_async(host, int(port or 1883))
+	client.loop_start()
+	return client
+
+async def flush_task(output, interval):
+	while True:
+		await asyncio.sleep(interval)
+		output.flush()
+
+async def stats_task(output, udp_input, interval):
+	lines = output.lines
+	start = time.monotonic()
+	while True:
+		await asyncio.sleep(interval)
+		now = time.monotonic()
+		rate = (output.lines - lines) / (now - start)
+		loss = ''
+		if udp_input and udp_input.trackers:
+			trackers = udp_input.trackers.values()
+			lost = sum(tracker.lost for tracker in trackers)
+			received = sum(tracker.received - tracker.duplicates for tracker in trackers)
+			loss = " datagrams lost={} ({:.3f}%) reordered={}".format(lost, 100.0 * lost / max(lost + received, 1),
+				sum(tracker.reordered for tracker in trackers))
+		print("devices={} lines={} ({:.0f} lines/s) bytes={}{}".format(len(output.devices), output.lines, rate, output.bytes, loss))
+		lines = output.lines
+		start = now
+
+async def main(args):
+	loop = asyncio.get_running_loop()
+	output = Output(args)
+	servers = []
+	udp_input = None
+	if args.udp:
+		udp_input = UdpInput(loop, output, args)
+		print("UDP port={} format={}".format(args.udp, args.format))
+	if args.tcp:
+		servers.append(await asyncio.start_server(lambda r, w: tcp_connection(output, args, r, w), '0.0.0.0', args.tcp, backlog=1024))
+		print("TCP port={} format={}".format(args.tcp, args.format))
+	if args.http:
+		servers.append(await asyncio.start_server(lambda r, w: http_connection(output, r, w), '0.0.0.0', args.http, backlog=1024, limit=HTTP_HEADER_MAX))
+		print("HTTP port={}".format(args.http))
+	if args.mqtt:
+		start_mqtt(loop, output, args)
+		print("MQTT broker={} topic={}".format(args.mqtt, args.mqtt_topic))
+	if args.metrics:
+		servers.append(await asyncio.start_server(lambda r, w: metrics_connection(output, udp_input, r, w), '0.0.0.0', args.metrics, limit=HTTP_HEADER_MAX))
+		print("Metrics port={}".format(args.metrics))
+	asyncio.ensure_future(flush_task(output, args.flush_interval))
+	if args.stats: asyncio.ensure_future(stats_task(output, udp_input, args.stats))
+	print("Writing to {}".format(args.outdir))
+	try:
+		await asyncio.Event().wait()
+	finally:
+		output.close_all()
+
+if __name__ == '__main__':
+	parser = argparse.ArgumentParser()
+	parser.add_argument('--udp', type=int, help='udp port, e.g. 6789')
+	parser.add_argument('--tcp', type=int, help='tcp port, e.g. 8080')
+	parser.add_argument('--http', type=int, help='http port, e.g. 8000')
+	parser.add_argument('--mqtt', help='broker host[:port] to subscribe to')
+	parser.add_argument('--mqtt-topic', help='topic filter', default='#')
+	parser.add_argument('--format', choices=['raw', 'syslog', 'gelf'], default='raw', help='UDP and TCP record format selected in menuconfig')
+	parser.add_argument('--elf', help='application ELF to format deferred records')
+	parser.add_argument('--control', help='filter settings sent to each UDP device, e.g. "*=W wifi=D"')
+	parser.add_argument('--outdir', help='directory of the device files', default='logs')
+	parser.add_argument('--max-bytes', type=int, help='rotate a device file at this size', default=10*1024*1024)
+	parser.add_argument('--backup-count', type=int, help='rotated files kept per device', default=5)
+	parser.add_argument('--buffer-size', type=int, help='bytes buffered per device before writing', default=64*1024)
+	parser.add_argument('--flush-interval', type=float, help='seconds between writes of all buffers', default=0.5)
+	parser.add_argument('--max-open', type=int, help='device files kept open', default=256)
+	parser.add_argument('--stats', type=float, help='seconds between statistics, 0 to disable', default=10)
+	parser.add_argument('--metrics', type=int, help='http port of the UDP loss and device metrics in Prometheus format')
+	parser.add_argument('--echo', action='store_true', help='also print the records')
+	args = parser.parse_args()
+	if not (args.udp or args.tcp or args.http or args.mqtt):
+		parser.error('select at least one of --udp, --tcp, --http and --mqtt')
+	if args.format == 'gelf' and args.tcp:
+		parser.error('GELF is sent over UDP only')
+	args.elf = netlog.open_elf(args.elf)
+
+	print("+=============================+")
+	print("| ESP32 Net Logging Collector |")
+	print("+=============================+")
+	print("")
+	try:
+		asyncio.run(main(args))
+	except KeyboardInterrupt:
+		pass
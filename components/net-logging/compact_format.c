@@ -0,0 +1,229 @@
+/*
+	Compact binary format
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "compact_format.h"
+
+#define RECORD_TIMESTAMP FRAME_HEADER_SIZE
+#define RECORD_FLAGS (FRAME_HEADER_SIZE + 4)
+#define RECORD_TAG (FRAME_HEADER_SIZE + 5)
+
+#define FLAG_LEVEL_MASK 0x07
+#define FLAG_CORE_SHIFT 3
+#define FLAG_CORE_MASK 0x38
+#define FLAG_COLORED 0x80
+
+static const char level_letter[] = "NEWIDV";
+// Same colors as esp_log.h
+static const char *level_color[] = { "", "\033[0;31m", "\033[0;33m", "\033[0;32m", "", "" };
+#define RESET_COLOR "\033[0m"
+
+static void put_header(char *frame, char type, size_t length)
+{
+	frame[0] = FRAME_MARKER;
+	frame[1] = type;
+	frame[2] = length & 0xff;
+	frame[3] = (length >> 8) & 0xff;
+}
+
+static size_t put_varint(char *p, uint32_t value)
+{
+	size_t len = 0;
+	while (value >= 0x80) {
+		p[len++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	p[len++] = value;
+	return len;
+}
+
+static size_t varint_size(uint32_t value)
+{
+	size_t len = 1;
+	while (value >= 0x80) {
+		value >>= 7;
+		len++;
+	}
+	return len;
+}
+
+// Convert "I (6123) MAIN: message\n" in place, returns -1 for other text
+int compact_format_pack(char *buffer, size_t size, size_t length, int core)
+{
+	size_t pos = 0;
+	bool colored = false;
+	// Skip the color escape sequence
+	if (length && buffer[0] == '\033') {
+		while (pos < length && buffer[pos] != 'm') pos++;
+		pos++;
+		colored = true;
+	}
+	if (pos + 4 > length) return -1;
+	const char *letter = strchr(level_letter + 1, buffer[pos]);
+	if (buffer[pos] == 0 || letter == NULL) return -1;
+	uint8_t level = letter - level_letter;
+	pos++;
+	if (buffer[pos++] != ' ' || buffer[pos++] != '(') return -1;
+
+	uint32_t timestamp = 0;
+	size_t digits = 0;
+	while (pos < length && isdigit((unsigned char)buffer[pos])) {
+		timestamp = timestamp * 10 + (buffer[pos] - '0');
+		pos++;
+		digits++;
+	}
+	if (digits == 0 || pos + 2 > length || buffer[pos] != ')' || buffer[pos+1] != ' ') return -1;
+	pos += 2;
+
+	size_t tag_start = pos;
+	while (pos + 1 < length && !(buffer[pos] == ':' && buffer[pos+1] == ' ')) pos++;
+	if (pos + 1 >= length) return -1;
+	size_t tag_len = pos - tag_start;
+	if (tag_len >= COMPACT_TAG_LENGTH || memchr(&buffer[tag_start], 0, tag_len)) return -1;
+	char tag[COMPACT_TAG_LENGTH];
+	memcpy(tag, &buffer[tag_start], tag_len);
+	tag[tag_len] = 0;
+	pos += 2;
+
+	// Remove trailing LF and the reset of the color
+	size_t message_end = length;
+	if (buffer[message_end-1] != '\n') return -1;
+	message_end--;
+	if (colored) {
+		size_t reset_len = strlen(RESET_COLOR);
+		if (message_end < pos + reset_len || memcmp(&buffer[message_end-reset_len], RESET_COLOR, reset_len) != 0) return -1;
+		message_end -= reset_len;
+	}
+	if (message_end < pos) return -1;
+	size_t message_len = message_end - pos;
+
+	size_t prefix_len = RECORD_TAG + tag_len + 1;
+	size_t record_len = prefix_len + message_len;
+	if (record_len > size || record_len > UINT16_MAX) return -1;
+	memmove(&buffer[prefix_len], &buffer[pos], message_len);
+	put_header(buffer, FRAME_TYPE_RECORD, record_len);
+	memcpy(&buffer[RECORD_TIMESTAMP], &timestamp, sizeof(timestamp));
+	buffer[RECORD_FLAGS] = level | ((core << FLAG_CORE_SHIFT) & FLAG_CORE_MASK) | (colored ? FLAG_COLORED : 0);
+	memcpy(&buffer[RECORD_TAG], tag, tag_len + 1);
+	return record_len;
+}
+
+bool compact_format_is_record(const char *record, size_t length)
+{
+	return (length > RECORD_TAG && record[0] == FRAME_MARKER && record[1] == FRAME_TYPE_RECORD
+		&& memchr(&record[RECORD_TAG], 0, length - RECORD_TAG) != NULL);
+}
+
+esp_log_level_t compact_format_level(const char *record)
+{
+	return record[RECORD_FLAGS] & FLAG_LEVEL_MASK;
+}
+
+int compact_format_unpack(char *text, size_t size, const char *record, size_t length)
+{
+	if (!compact_format_is_record(record, length) || size == 0) return -1;
+	uint32_t timestamp;
+	memcpy(&timestamp, &record[RECORD_TIMESTAMP], sizeof(timestamp));
+	uint8_t flags = record[RECORD_FLAGS];
+	uint8_t level = flags & FLAG_LEVEL_MASK;
+	if (level > ESP_LOG_VERBOSE) return -1;
+	bool colored = (flags & FLAG_COLORED) && level_color[level][0];
+	const char *tag = &record[RECORD_TAG];
+	const char *message = tag + strlen(tag) + 1;
+	int message_len = &record[length] - message;
+
+	int len = snprintf(text, size, "%s%c (%"PRIu32") %s: %.*s%s\n",
+		colored ? level_color[level] : "", level_letter[level], timestamp, tag, message_len, message, colored ? RESET_COLOR : "");
+	if (len < 0) return -1;
+	return ((size_t)len < size) ? (size_t)len : size - 1;
+}
+
+void compact_format_reset(COMPACT_STATE_t *state)
+{
+	state->timestamp = 0;
+	state->tag_count = 0;
+}
+
+// Convert a parsed record to a compact record, preceded by a tag entry when the tag is new
+int compact_format_encode(COMPACT_STATE_t *state, char *frame, size_t size, const char *record, size_t length)
+{
+	if (!compact_format_is_record(record, length)) return -1;
+	uint32_t timestamp;
+	memcpy(&timestamp, &record[RECORD_TIMESTAMP], sizeof(timestamp));
+	const char *tag = &record[RECORD_TAG];
+	size_t tag_len = strlen(tag);
+	const char *message = tag + tag_len + 1;
+	size_t message_len = &record[length] - message;
+
+	int id = 0;
+	for (int i=0;i<state->tag_count;i++) {
+		if (strcmp(state->tags[i], tag) == 0) {
+			id = i + 1;
+			break;
+		}
+	}
+	bool new_tag = (id == 0 && state->tag_count < COMPACT_TAG_MAX && tag_len < COMPACT_TAG_LENGTH);
+	if (new_tag) id = state->tag_count + 1;
+
+	// Zigzag encoding keeps small negative deltas short
+	int32_t delta = (int32_t)(timestamp - state->timestamp);
+	uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+
+	size_t entry_len = new_tag ? FRAME_HEADER_SIZE + 1 + tag_len : 0;
+	size_t compact_len = FRAME_HEADER_SIZE + varint_size(zigzag) + 1 + varint_size(id) + (id ? 0 : tag_len + 1) + message_len;
+	if (entry_len + compact_len > size || compact_len > UINT16_MAX) return -1;
+
+	size_t len = 0;
+	if (new_tag) {
+		memcpy(state->tags[state->tag_count++], tag, tag_len + 1);
+		put_header(frame, FRAME_TYPE_TAG, entry_len);
+		frame[FRAME_HEADER_SIZE] = id;
+		memcpy(&frame[FRAME_HEADER_SIZE+1], tag, tag_len);
+		len = entry_len;
+	}
+	char *compact = &frame[len];
+	size_t pos = FRAME_HEADER_SIZE;
+	pos += put_varint(&compact[pos], zigzag);
+	compact[pos++] = record[RECORD_FLAGS];
+	pos += put_varint(&compact[pos], id);
+	if (id == 0) {
+		// The dictionary is full, send the tag inline
+		memcpy(&compact[pos], tag, tag_len + 1);
+		pos += tag_len + 1;
+	}
+	memcpy(&compact[pos], message, message_len);
+	put_header(compact, FRAME_TYPE_COMPACT, compact_len);
+	state->timestamp = timestamp;
+	return len + compact_len;
+}
+
+// Send the dictionary and the timestamp base again at the start of a connection
+int compact_format_sync(const COMPACT_STATE_t *state, char *frame, size_t size, uint32_t timestamp)
+{
+	size_t len = 0;
+	for (int i=0;i<state->tag_count;i++) {
+		size_t tag_len = strlen(state->tags[i]);
+		size_t entry_len = FRAME_HEADER_SIZE + 1 + tag_len;
+		if (len + entry_len > size) return -1;
+		put_header(&frame[len], FRAME_TYPE_TAG, entry_len);
+		frame[len+FRAME_HEADER_SIZE] = i + 1;
+		memcpy(&frame[len+FRAME_HEADER_SIZE+1], state->tags[i], tag_len);
+		len += entry_len;
+	}
+	size_t base_len = FRAME_HEADER_SIZE + sizeof(timestamp);
+	if (len + base_len > size) return -1;
+	put_header(&frame[len], FRAME_TYPE_BASE, base_len);
+	memcpy(&frame[len+FRAME_HEADER_SIZE], &timestamp, sizeof(timestamp));
+	return len + base_len;
+}
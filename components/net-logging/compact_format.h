@@ -0,0 +1,46 @@
+#ifndef COMPACT_FORMAT_H_
+#define COMPACT_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "frame.h"
+
+// Parsed record: frame header, timestamp (4 bytes), flags (1 byte), tag with NUL, message without LF.
+// Compact record: frame header, zigzag varint timestamp delta, flags (1 byte), varint tag id, message.
+// Tag id 0 is followed by the tag with NUL.
+// Tag entry: frame header, tag id (1 byte), tag.
+// Timestamp base: frame header, timestamp (4 bytes).
+// Flags: bit0-2 level, bit3-5 core id, bit7 colored.
+#define COMPACT_TAG_MAX 32
+#define COMPACT_TAG_LENGTH 24
+// Maximum growth of a record by compact_format_encode
+#define COMPACT_FORMAT_OVERHEAD (FRAME_HEADER_SIZE + 1 + COMPACT_TAG_LENGTH)
+// Maximum size written by compact_format_sync
+#define COMPACT_SYNC_SIZE (COMPACT_TAG_MAX * (FRAME_HEADER_SIZE + 1 + COMPACT_TAG_LENGTH) + FRAME_HEADER_SIZE + 4)
+
+// Tag dictionary and timestamp base of one connection
+typedef struct {
+	uint32_t timestamp;
+	int tag_count;
+	char tags[COMPACT_TAG_MAX][COMPACT_TAG_LENGTH];
+} COMPACT_STATE_t;
+
+int compact_format_pack(char *buffer, size_t size, size_t length, int core);
+bool compact_format_is_record(const char *record, size_t length);
+esp_log_level_t compact_format_level(const char *record);
+int compact_format_unpack(char *text, size_t size, const char *record, size_t length);
+void compact_format_reset(COMPACT_STATE_t *state);
+int compact_format_encode(COMPACT_STATE_t *state, char *frame, size_t size, const char *record, size_t length);
+int compact_format_sync(const COMPACT_STATE_t *state, char *frame, size_t size, uint32_t timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMPACT_FORMAT_H_ */
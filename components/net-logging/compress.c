@@ -0,0 +1,139 @@
+/*
+	LZ4 block compression
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "compress.h"
+
+#define MINMATCH 4
+#define LASTLITERALS 5 // The last 5 bytes are always literals
+#define MFLIMIT 12 // A match must start at least 12 bytes before the end
+#define MAX_OFFSET 65535
+
+// Preset dictionary, must be the same as COMPRESS_DICTIONARY in netlog.py
+static const char dictionary[] =
+	"\033[0;31mE (\033[0;33mW (\033[0;32mI (\033[0m\nD (V ("
+	" wifi:wifi_init: esp_netif_handlers: sta ip: , mask: , gw: "
+	" phy_init: cpu_start: heap_init: spi_flash: system_api: app_start: "
+	"connected disconnected failed error timeout ready start stop "
+	" MAIN: ";
+#define DICTIONARY_LENGTH (sizeof(dictionary) - 1)
+
+static uint32_t read32(const uint8_t *p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t hash32(uint32_t sequence)
+{
+	return (sequence * 2654435761U) >> (32 - COMPRESS_HASH_BITS);
+}
+
+// Length field continuation bytes
+static size_t put_length(uint8_t *p, size_t length)
+{
+	size_t len = 0;
+	while (length >= 255) {
+		p[len++] = 255;
+		length -= 255;
+	}
+	p[len++] = length;
+	return len;
+}
+
+// Write one sequence, returns false if it does not fit
+static bool put_sequence(uint8_t *dst, size_t size, size_t *pos, const uint8_t *literal, size_t literal_len, uint16_t offset, size_t match_len)
+{
+	// Worst case of the length fields
+	size_t required = 1 + literal_len / 255 + 1 + literal_len + 2 + match_len / 255 + 1;
+	if (*pos + required > size) return false;
+	uint8_t *token = &dst[(*pos)++];
+	*token = (literal_len >= 15 ? 15 : literal_len) << 4;
+	if (literal_len >= 15) *pos += put_length(&dst[*pos], literal_len - 15);
+	memcpy(&dst[*pos], literal, literal_len);
+	*pos += literal_len;
+	if (match_len == 0) return true;
+	dst[(*pos)++] = offset & 0xff;
+	dst[(*pos)++] = offset >> 8;
+	match_len -= MINMATCH;
+	*token |= (match_len >= 15 ? 15 : match_len);
+	if (match_len >= 15) *pos += put_length(&dst[*pos], match_len - 15);
+	return true;
+}
+
+static int compress_block(COMPRESS_STATE_t *state, uint8_t *dst, size_t size, const uint8_t *src, size_t length)
+{
+	// Positions are counted from the start of the dictionary, 0 is an empty slot
+	memset(state->table, 0, sizeof(state->table));
+	const uint8_t *dict = (const uint8_t *)dictionary;
+	for (size_t i=0; i+MINMATCH<=DICTIONARY_LENGTH; i++) {
+		state->table[hash32(read32(&dict[i]))] = i + 1;
+	}
+
+	size_t pos = 0;
+	size_t ip = 0;
+	size_t anchor = 0;
+	if (length >= MFLIMIT + 1) {
+		size_t match_limit = length - LASTLITERALS;
+		while (ip < length - MFLIMIT) {
+			uint32_t sequence = read32(&src[ip]);
+			uint32_t h = hash32(sequence);
+			size_t candidate = state->table[h];
+			state->table[h] = DICTIONARY_LENGTH + ip + 1;
+			if (candidate) {
+				candidate--;
+				size_t offset = DICTIONARY_LENGTH + ip - candidate;
+				const uint8_t *match;
+				size_t max_len = match_limit - ip;
+				if (candidate < DICTIONARY_LENGTH) {
+					match = &dict[candidate];
+					if (max_len > DICTIONARY_LENGTH - candidate) max_len = DICTIONARY_LENGTH - candidate;
+				} else {
+					match = &src[candidate - DICTIONARY_LENGTH];
+				}
+				if (offset <= MAX_OFFSET && max_len >= MINMATCH && read32(match) == sequence) {
+					size_t match_len = MINMATCH;
+					while (match_len < max_len && match[match_len] == src[ip + match_len]) match_len++;
+					if (!put_sequence(dst, size, &pos, &src[anchor], ip - anchor, offset, match_len)) return -1;
+					ip += match_len;
+					anchor = ip;
+					continue;
+				}
+			}
+			ip++;
+		}
+	}
+	if (!put_sequence(dst, size, &pos, &src[anchor], length - anchor, 0, 0)) return -1;
+	return pos;
+}
+
+// Returns -1 if the compressed frame is not smaller than the data
+int compress_frame(COMPRESS_STATE_t *state, char *frame, size_t size, const char *data, size_t length)
+{
+	// Positions must fit in the 16-bit hash table
+	if (length + DICTIONARY_LENGTH >= UINT16_MAX || size <= COMPRESS_HEADER_SIZE) return -1;
+	size_t limit = (length < size) ? length : size;
+	if (limit <= COMPRESS_HEADER_SIZE) return -1;
+	int block_len = compress_block(state, (uint8_t *)&frame[COMPRESS_HEADER_SIZE], limit - COMPRESS_HEADER_SIZE, (const uint8_t *)data, length);
+	if (block_len < 0) return -1;
+	size_t frame_len = COMPRESS_HEADER_SIZE + block_len;
+	frame[0] = FRAME_MARKER;
+	frame[1] = FRAME_TYPE_COMPRESSED;
+	frame[2] = frame_len & 0xff;
+	frame[3] = (frame_len >> 8) & 0xff;
+	frame[4] = length & 0xff;
+	frame[5] = (length >> 8) & 0xff;
+	return frame_len;
+}
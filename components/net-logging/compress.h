@@ -0,0 +1,30 @@
+#ifndef COMPRESS_H_
+#define COMPRESS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame.h"
+
+// Compressed frame: frame header, uncompressed length (2 bytes), LZ4 block.
+// The block is compressed with a preset dictionary of common log text, netlog.py has the same dictionary.
+// The uncompressed data is a sequence of records, which may be text or frames.
+#define COMPRESS_HASH_BITS 10
+#define COMPRESS_HEADER_SIZE (FRAME_HEADER_SIZE + 2)
+#define COMPRESS_ENCODING "x-netlog-lz4"
+
+// Work memory of one compressor
+typedef struct {
+	uint16_t table[1 << COMPRESS_HASH_BITS];
+} COMPRESS_STATE_t;
+
+int compress_frame(COMPRESS_STATE_t *state, char *frame, size_t size, const char *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMPRESS_H_ */
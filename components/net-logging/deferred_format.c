@@ -0,0 +1,261 @@
+/*
+	Deferred formatting
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "esp_memory_utils.h" // esp_ptr_in_drom
+#else
+#include "soc/soc_memory_layout.h" // esp_ptr_in_drom
+#endif
+
+#include "deferred_format.h"
+
+typedef enum {
+	ARG_NONE,
+	ARG_INT,
+	ARG_LONGLONG,
+	ARG_DOUBLE,
+	ARG_STRING,
+	ARG_POINTER,
+	ARG_INVALID,
+} ARG_TYPE_t;
+
+#define PRECISION_NONE -1
+#define PRECISION_ARGUMENT -2 // '*', the last of the '*' arguments
+
+typedef struct {
+	size_t length; // Length of the specification including '%' and the conversion
+	int stars; // Number of '*' width/precision arguments
+	int precision;
+	ARG_TYPE_t type;
+} FORMAT_SPEC_t;
+
+// Parse one conversion specification starting at '%'
+static void parse_spec(const char *p, FORMAT_SPEC_t *spec)
+{
+	const char *s = p + 1;
+	int longs = 0;
+	char modifier = 0;
+	spec->stars = 0;
+	spec->precision = PRECISION_NONE;
+	while (*s && strchr("-+ #0", *s)) s++;
+	if (*s == '*') {
+		spec->stars++;
+		s++;
+	} else {
+		while (isdigit((unsigned char)*s)) s++;
+	}
+	if (*s == '.') {
+		s++;
+		if (*s == '*') {
+			spec->stars++;
+			spec->precision = PRECISION_ARGUMENT;
+			s++;
+		} else {
+			spec->precision = 0;
+			while (isdigit((unsigned char)*s)) {
+				spec->precision = spec->precision * 10 + (*s - '0');
+				s++;
+			}
+		}
+	}
+	while (*s && strchr("hlzjt", *s)) {
+		if (*s == 'l') {
+			longs++;
+		} else {
+			modifier = *s;
+		}
+		s++;
+	}
+	// intmax_t is 8 bytes like long long, size_t and ptrdiff_t are 4 bytes on the targets
+	size_t size = sizeof(int);
+	if (longs >= 2) size = sizeof(long long);
+	else if (longs == 1) size = sizeof(long);
+	else if (modifier == 'j') size = sizeof(intmax_t);
+	else if (modifier == 'z') size = sizeof(size_t);
+	else if (modifier == 't') size = sizeof(ptrdiff_t);
+
+	switch (*s) {
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+			spec->type = (size > sizeof(int)) ? ARG_LONGLONG : ARG_INT;
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			spec->type = ARG_DOUBLE;
+			break;
+		case 's':
+			spec->type = ARG_STRING;
+			break;
+		case 'p':
+			spec->type = ARG_POINTER;
+			break;
+		case '%':
+			spec->type = ARG_NONE;
+			break;
+		default:
+			// %n, long double and truncated specifications are formatted on the caller
+			spec->type = ARG_INVALID;
+			break;
+	}
+	spec->length = (*s ? s + 1 : s) - p;
+}
+
+#define PUT(data, n) do { \
+	if (len + (n) > size) return -1; \
+	memcpy(&record[len], (data), (n)); \
+	len += (n); \
+} while(0)
+
+int deferred_format_pack(char *record, size_t size, const char *fmt, va_list l)
+{
+	// The format string must stay valid and must be found in the ELF
+	if (!esp_ptr_in_drom(fmt)) return -1;
+
+	size_t len = FRAME_HEADER_SIZE;
+	uint32_t address = (uint32_t)(uintptr_t)fmt;
+	PUT(&address, sizeof(address));
+
+	for (const char *p = fmt; *p; p++) {
+		if (*p != '%') continue;
+		FORMAT_SPEC_t spec;
+		parse_spec(p, &spec);
+		p += spec.length - 1;
+		int precision = spec.precision;
+		for (int i=0;i<spec.stars;i++) {
+			int value = va_arg(l, int);
+			PUT(&value, sizeof(value));
+			if (i == spec.stars - 1 && spec.precision == PRECISION_ARGUMENT) precision = value;
+		}
+		if (spec.type == ARG_INT) {
+			int value = va_arg(l, int);
+			PUT(&value, sizeof(value));
+		} else if (spec.type == ARG_LONGLONG) {
+			long long value = va_arg(l, long long);
+			PUT(&value, sizeof(value));
+		} else if (spec.type == ARG_DOUBLE) {
+			double value = va_arg(l, double);
+			PUT(&value, sizeof(value));
+		} else if (spec.type == ARG_POINTER) {
+			uint32_t value = (uint32_t)(uintptr_t)va_arg(l, void *);
+			PUT(&value, sizeof(value));
+		} else if (spec.type == ARG_STRING) {
+			// Strings are copied by value, the pointer may not be valid later.
+			// With a precision the string may not be terminated, so only that much is copied.
+			const char *value = va_arg(l, const char *);
+			if (value == NULL) value = "(null)";
+			size_t value_len = (precision >= 0) ? strnlen(value, precision) : strlen(value);
+			PUT(value, value_len);
+			PUT("", 1);
+		} else if (spec.type == ARG_INVALID) {
+			return -1;
+		}
+	}
+
+	record[0] = FRAME_MARKER;
+	record[1] = FRAME_TYPE_DEFERRED;
+	record[2] = len & 0xff;
+	record[3] = (len >> 8) & 0xff;
+	return len;
+}
+
+bool deferred_format_is_record(const char *record, size_t length)
+{
+	return (length >= FRAME_HEADER_SIZE + sizeof(uint32_t) && record[0] == FRAME_MARKER && record[1] == FRAME_TYPE_DEFERRED);
+}
+
+const char *deferred_format_fmt(const char *record)
+{
+	uint32_t address;
+	memcpy(&address, &record[FRAME_HEADER_SIZE], sizeof(address));
+	return (const char *)(uintptr_t)address;
+}
+
+#define GET(data, n) do { \
+	if (pos + (n) > length) return -1; \
+	memcpy((data), &record[pos], (n)); \
+	pos += (n); \
+} while(0)
+
+int deferred_format_unpack(char *text, size_t size, const char *record, size_t length)
+{
+	if (!deferred_format_is_record(record, length) || size == 0) return -1;
+	size_t pos = FRAME_HEADER_SIZE;
+	uint32_t address;
+	GET(&address, sizeof(address));
+	const char *fmt = (const char *)(uintptr_t)address;
+
+	size_t len = 0;
+	for (const char *p = fmt; *p && len + 1 < size; p++) {
+		if (*p != '%') {
+			text[len++] = *p;
+			continue;
+		}
+		FORMAT_SPEC_t spec;
+		parse_spec(p, &spec);
+		if (spec.type == ARG_INVALID) return -1;
+
+		// Copy the specification and replace '*' with the recorded values
+		char spec_text[32];
+		size_t spec_len = 0;
+		for (int i=0;i<spec.length;i++) {
+			if (spec_len + 12 > sizeof(spec_text)) return -1;
+			if (p[i] == '*') {
+				int value;
+				GET(&value, sizeof(value));
+				// A negative precision is taken as if it were omitted, drop the '.' too
+				if (i > 0 && p[i-1] == '.' && value < 0) {
+					spec_len--;
+					continue;
+				}
+				spec_len += sprintf(&spec_text[spec_len], "%d", value);
+			} else {
+				spec_text[spec_len++] = p[i];
+			}
+		}
+		spec_text[spec_len] = 0;
+		p += spec.length - 1;
+
+		size_t room = size - len;
+		int written = 0;
+		if (spec.type == ARG_INT) {
+			int value;
+			GET(&value, sizeof(value));
+			written = snprintf(&text[len], room, spec_text, value);
+		} else if (spec.type == ARG_LONGLONG) {
+			long long value;
+			GET(&value, sizeof(value));
+			written = snprintf(&text[len], room, spec_text, value);
+		} else if (spec.type == ARG_DOUBLE) {
+			double value;
+			GET(&value, sizeof(value));
+			written = snprintf(&text[len], room, spec_text, value);
+		} else if (spec.type == ARG_POINTER) {
+			uint32_t value;
+			GET(&value, sizeof(value));
+			written = snprintf(&text[len], room, spec_text, (void *)(uintptr_t)value);
+		} else if (spec.type == ARG_STRING) {
+			const char *value = &record[pos];
+			const char *end = memchr(value, 0, length - pos);
+			if (end == NULL) return -1;
+			pos += end - value + 1;
+			written = snprintf(&text[len], room, spec_text, value);
+		} else {
+			written = snprintf(&text[len], room, "%%");
+		}
+		if (written < 0) return -1;
+		len += ((size_t)written < room) ? (size_t)written : room - 1;
+	}
+	text[len] = 0;
+	return len;
+}
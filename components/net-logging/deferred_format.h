@@ -0,0 +1,25 @@
+#ifndef DEFERRED_FORMAT_H_
+#define DEFERRED_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "frame.h"
+
+// Deferred record: frame header, format pointer (4 bytes), raw arguments.
+// Integers and pointers are 4 bytes, long long, intmax_t and double are 8 bytes.
+// Strings are copied up to their NUL or their precision, and terminated with a NUL.
+int deferred_format_pack(char *record, size_t size, const char *fmt, va_list l);
+bool deferred_format_is_record(const char *record, size_t length);
+const char *deferred_format_fmt(const char *record);
+int deferred_format_unpack(char *text, size_t size, const char *record, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFERRED_FORMAT_H_ */
@@ -0,0 +1,141 @@
+/*
+	Early boot capture
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+
+#include "net_logging.h"
+#include "early_capture.h"
+
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE
+#define CAPTURE_MAGIC 0x4e4c4543 // "CELN"
+
+typedef struct {
+	uint32_t magic;
+	uint32_t length; // Bytes reserved, may be larger than the data when records were dropped
+	uint32_t sent; // Bytes already handed to the transport
+	uint32_t dropped;
+	uint8_t data[CONFIG_NET_LOGGING_EARLY_CAPTURE_SIZE];
+} EARLY_CAPTURE_t;
+
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE_RTC
+static RTC_NOINIT_ATTR EARLY_CAPTURE_t capture;
+#else
+static EARLY_CAPTURE_t capture;
+#endif
+
+static bool capture_stdout;
+
+// Append one record, space is reserved without a lock so any task or interrupt can log
+static void capture_append(const char *text, size_t length)
+{
+	uint32_t offset = __atomic_fetch_add(&capture.length, 2 + length, __ATOMIC_RELAXED);
+	if (offset + 2 + length > sizeof(capture.data)) {
+		__atomic_fetch_add(&capture.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	uint16_t record_len = length;
+	memcpy(&capture.data[offset + 2], text, length);
+	// The length is written last, a record with length 0 is not complete yet
+	__atomic_store_n((uint8_t *)&capture.data[offset], record_len & 0xff, __ATOMIC_RELAXED);
+	__atomic_store_n((uint8_t *)&capture.data[offset + 1], record_len >> 8, __ATOMIC_RELEASE);
+}
+
+static int early_capture_vprintf(const char *fmt, va_list l)
+{
+	char buffer[xItemSize];
+	va_list args;
+	va_copy(args, l);
+	int buffer_len = vsnprintf(buffer, sizeof(buffer), fmt, args);
+	va_end(args);
+	// Long records are truncated
+	if (buffer_len >= (int)sizeof(buffer)) buffer_len = sizeof(buffer) - 1;
+	if (buffer_len > 0) capture_append(buffer, buffer_len);
+
+	// There is no transport yet, so STDOUT is written directly
+	if (capture_stdout) {
+		return vprintf(fmt, l);
+	} else {
+		return 0;
+	}
+}
+
+esp_err_t net_logging_early_init(int16_t enableStdout)
+{
+	bool kept = (capture.magic == CAPTURE_MAGIC && capture.sent <= capture.length);
+	if (kept && capture.sent < capture.length && capture.sent < sizeof(capture.data)) {
+		// Records from before a software reset were not sent yet
+		printf("early capture: %"PRIu32" bytes kept from before the reset\n", capture.length - capture.sent);
+	} else {
+		capture.length = 0;
+		capture.sent = 0;
+		capture.dropped = 0;
+	}
+	// Clear the rest so every new record starts with length 0
+	if (capture.length < sizeof(capture.data)) {
+		memset(&capture.data[capture.length], 0, sizeof(capture.data) - capture.length);
+	}
+	capture.magic = CAPTURE_MAGIC;
+
+	char marker[80];
+	int marker_len = snprintf(marker, sizeof(marker), LOG_COLOR_I "I (%"PRIu32") net_logging: boot, reset reason %d" LOG_RESET_COLOR "\n",
+		esp_log_timestamp(), (int)esp_reset_reason());
+	capture_append(marker, marker_len);
+
+	capture_stdout = enableStdout;
+	esp_log_set_vprintf(early_capture_vprintf);
+	return ESP_OK;
+}
+
+// Hand the captured records to the transport in the order they were logged
+void early_capture_flush(EARLY_CAPTURE_SEND_t send)
+{
+	if (capture.magic != CAPTURE_MAGIC) return;
+	uint32_t length = __atomic_load_n(&capture.length, __ATOMIC_ACQUIRE);
+	if (length > sizeof(capture.data)) length = sizeof(capture.data);
+	while (capture.sent + 2 <= length) {
+		uint16_t record_len = capture.data[capture.sent] | (__atomic_load_n(&capture.data[capture.sent + 1], __ATOMIC_ACQUIRE) << 8);
+		// Not complete yet, or the end of the records
+		if (record_len == 0 || capture.sent + 2 + record_len > length) break;
+		if (send((const char *)&capture.data[capture.sent + 2], record_len) == false) break;
+		capture.sent += 2 + record_len;
+	}
+	uint32_t dropped = __atomic_exchange_n(&capture.dropped, 0, __ATOMIC_RELAXED);
+	if (dropped) {
+		char marker[96];
+		int marker_len = snprintf(marker, sizeof(marker), LOG_COLOR_W "W (%"PRIu32") net_logging: %"PRIu32" early records dropped" LOG_RESET_COLOR "\n",
+			esp_log_timestamp(), dropped);
+		send(marker, marker_len);
+	}
+}
+
+// The transport has taken over, nothing is left for the next reset
+void early_capture_stop(void)
+{
+	capture.magic = 0;
+}
+#else
+esp_err_t net_logging_early_init(int16_t enableStdout)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+void early_capture_flush(EARLY_CAPTURE_SEND_t send)
+{
+}
+
+void early_capture_stop(void)
+{
+}
+#endif
@@ -0,0 +1,25 @@
+#ifndef EARLY_CAPTURE_H_
+#define EARLY_CAPTURE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Records logged before the first transport is up are kept in a static buffer.
+// Record: length (2 bytes), text.
+// In RTC memory, records that were not sent yet survive a software reset.
+
+typedef bool (*EARLY_CAPTURE_SEND_t)(const char *record, size_t length);
+
+void early_capture_flush(EARLY_CAPTURE_SEND_t send);
+void early_capture_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EARLY_CAPTURE_H_ */
@@ -0,0 +1,27 @@
+#ifndef FRAME_H_
+#define FRAME_H_
+
+// Binary records start with a NUL byte, which never appears in a text record.
+// [0]=0x00 [1]=type [2-3]=total length (little endian)
+#define FRAME_MARKER 0x00
+#define FRAME_HEADER_SIZE 4
+
+#define FRAME_TYPE_DEFERRED 'D' // Format pointer and raw arguments
+#define FRAME_TYPE_RECORD 'R' // Parsed record, only inside the device
+#define FRAME_TYPE_COMPACT 'C' // Compact record on the wire
+#define FRAME_TYPE_TAG 'T' // Tag dictionary entry on the wire
+#define FRAME_TYPE_BASE 'B' // Timestamp base on the wire
+#define FRAME_TYPE_COMPRESSED 'Z' // LZ4 block of records on the wire
+#define FRAME_TYPE_FRAGMENT 'F' // Part of a record longer than one item
+#define FRAME_TYPE_SEQUENCE 'S' // Datagram sequence number on the wire
+
+// Fragment: frame header, record id (2 bytes), fragment index (2 bytes), text.
+// The last fragment of a record has FRAGMENT_LAST set in the index.
+#define FRAGMENT_HEADER_SIZE (FRAME_HEADER_SIZE + 4)
+#define FRAGMENT_LAST 0x8000
+
+// Sequence: frame header, boot id (4 bytes), sequence number (4 bytes), record count (2 bytes).
+// It starts a datagram, the sequence number counts the datagrams since boot.
+#define SEQUENCE_FRAME_SIZE (FRAME_HEADER_SIZE + 10)
+
+#endif /* FRAME_H_ */
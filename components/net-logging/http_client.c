@@ -9,27 +9,31 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
-#if CONFIG_USE_RINGBUFFER
-#include "freertos/ringbuf.h"
-#else
-#include "freertos/message_buffer.h"
-#endif
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_tls.h"
 #include "esp_http_client.h"
 
 #include "net_logging.h"
+#include "sink.h"
+#if CONFIG_COMPRESSION
+#include <strings.h> // strcasecmp
+#include "compress.h"
 
-#if CONFIG_USE_RINGBUFFER
-extern RingbufHandle_t xRingBufferTrans;
-#else
-extern MessageBufferHandle_t xMessageBufferTrans;
+// The server accepts compressed posts on the current connection
+static bool compress_accepted;
 #endif
 
+// Reports the result of each post
+static SINK_t *http_sink;
+
+// Size of the response buffer passed as user_data
+#define MAX_HTTP_OUTPUT_BUFFER 128
+
 esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
 	static char *output_buffer;  // Buffer to store response of http request from event handler
@@ -48,6 +52,12 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 			break;
 		case HTTP_EVENT_ON_HEADER:
 			//ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+#if CONFIG_COMPRESSION
+			// The server advertises the encodings it accepts in the response (RFC 7694)
+			if (strcasecmp(evt->header_key, "Accept-Encoding") == 0) {
+				compress_accepted = (strstr(evt->header_value, COMPRESS_ENCODING) != NULL);
+			}
+#endif
 			break;
 		case HTTP_EVENT_ON_DATA:
 			//ESP_LOGI(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
@@ -57,20 +67,30 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 			 */
 			if (!esp_http_client_is_chunked_response(evt->client)) {
 				// If user_data buffer is configured, copy the response into the buffer
+				// The rest of a long response is dropped, the buffer keeps a terminating NUL
+				int copy_len = 0;
 				if (evt->user_data) {
-					memcpy(evt->user_data + output_len, evt->data, evt->data_len);
+					copy_len = MAX_HTTP_OUTPUT_BUFFER - 1 - output_len;
+					if (copy_len > evt->data_len) copy_len = evt->data_len;
+					if (copy_len > 0) {
+						memcpy(evt->user_data + output_len, evt->data, copy_len);
+						((char *)evt->user_data)[output_len + copy_len] = 0;
+					}
 				} else {
-					if (output_buffer == NULL) {
-						output_buffer = (char *) malloc(esp_http_client_get_content_length(evt->client));
+					int content_len = esp_http_client_get_content_length(evt->client);
+					if (output_buffer == NULL && content_len > 0) {
+						output_buffer = (char *) malloc(content_len);
 						output_len = 0;
 						if (output_buffer == NULL) {
 							//ESP_LOGE(TAG, "Failed to allocate memory for output buffer");
 							return ESP_FAIL;
 						}
 					}
-					memcpy(output_buffer + output_len, evt->data, evt->data_len);
+					copy_len = content_len - output_len;
+					if (copy_len > evt->data_len) copy_len = evt->data_len;
+					if (output_buffer != NULL && copy_len > 0) memcpy(output_buffer + output_len, evt->data, copy_len);
 				}
-				output_len += evt->data_len;
+				if (copy_len > 0) output_len += copy_len;
 			}
 
 			break;
@@ -86,6 +106,10 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 			break;
 		case HTTP_EVENT_DISCONNECTED:
 			//ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
+#if CONFIG_COMPRESSION
+			// Negotiate again on the next connection
+			compress_accepted = false;
+#endif
 			//int mbedtls_err = 0;
 			//esp_err_t err = esp_tls_get_and_clear_last_error(evt->data, &mbedtls_err, NULL);
 			err = esp_tls_get_and_clear_last_error(evt->data, &mbedtls_err, NULL);
@@ -108,12 +132,14 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 	return ESP_OK;
 }
 
-#define MAX_HTTP_OUTPUT_BUFFER 128
+#if CONFIG_HTTP_BATCH
+#define HTTP_PACKED_SIZE CONFIG_HTTP_BATCH_SIZE
+#else
+#define HTTP_PACKED_SIZE xItemSize
+#endif
 
-static void http_post_with_url(char *url, char * post_data, size_t post_len)
+static esp_http_client_handle_t http_client_init_with_url(char *url, char *response_buffer)
 {
-	//ESP_LOGI(TAG, "http_post_with_url url=[%s]", url);
-	char local_response_buffer[MAX_HTTP_OUTPUT_BUFFER] = {0};
 	/**
 	 * NOTE: All the configuration parameters for http_client must be spefied either in URL or as host and path parameters.
 	 * If host and path parameters are not set, query parameter will be ignored. In such cases,
@@ -127,8 +153,9 @@ static void http_post_with_url(char *url, char * post_data, size_t post_len)
 		.url = url,
 		.path = "/post",
 		.event_handler = _http_event_handler,
-		.user_data = local_response_buffer,			 // Pass address of local buffer to get response
+		.user_data = response_buffer,			 // Pass address of local buffer to get response
 		.disable_auto_redirect = true,
+		.keep_alive_enable = true,				 // Reuse the connection across requests
 	};
 #endif
 
@@ -137,64 +164,161 @@ static void http_post_with_url(char *url, char * post_data, size_t post_len)
 		.url = "http://192.168.10.46:8000",
 		.path = "/post",
 		.event_handler = _http_event_handler,
-		.user_data = local_response_buffer,			 // Pass address of local buffer to get response
+		.user_data = response_buffer,			 // Pass address of local buffer to get response
 		.disable_auto_redirect = true,
+		.keep_alive_enable = true,
 	};
 #endif
 
-
+	// The client is created once and reused, so the TCP connection (and TLS session) survives between posts
 	esp_http_client_handle_t client = esp_http_client_init(&config);
-
-	// POST
 	esp_http_client_set_method(client, HTTP_METHOD_POST);
 	esp_http_client_set_header(client, "Content-Type", "application/json");
+	return client;
+}
+
+static void http_post_with_client(esp_http_client_handle_t client, char *response_buffer, char * post_data, size_t post_len)
+{
+	//ESP_LOGI(TAG, "http_post_with_client post_len=%d", post_len);
+	memset(response_buffer, 0, MAX_HTTP_OUTPUT_BUFFER);
+
+#if CONFIG_COMPRESSION
+	// Posts are sent uncompressed until the server accepts compression
+	static COMPRESS_STATE_t compress_state;
+	static char packed[HTTP_PACKED_SIZE];
+	int packed_len = -1;
+	if (compress_accepted) packed_len = compress_frame(&compress_state, packed, sizeof(packed), post_data, post_len);
+	if (packed_len > 0) {
+		esp_http_client_set_header(client, "Content-Encoding", COMPRESS_ENCODING);
+		post_data = packed;
+		post_len = packed_len;
+	} else {
+		esp_http_client_delete_header(client, "Content-Encoding");
+	}
+#endif
+
+	// POST
 	//esp_http_client_set_post_field(client, post_data, strlen(post_data));
 	esp_http_client_set_post_field(client, post_data, post_len);
 	esp_err_t err = esp_http_client_perform(client);
+	sink_set_connected(http_sink, err == ESP_OK);
+	sink_sent(http_sink, post_len, err == ESP_OK);
 	if (err == ESP_OK) {
 #if 0
 		ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %d",
 			esp_http_client_get_status_code(client),
 			esp_http_client_get_content_length(client));
-		ESP_LOGI(TAG, "local_response_buffer=[%s]", local_response_buffer);
+		ESP_LOGI(TAG, "local_response_buffer=[%s]", response_buffer);
 #endif
 	} else {
-		printf("HTTP POST request failed: %s", esp_err_to_name(err));
+		// The next perform reconnects
+		printf("HTTP POST request failed: %s\n", esp_err_to_name(err));
+		esp_http_client_close(client);
 	}
-
-	esp_http_client_cleanup(client);
 }
 
+#if CONFIG_HTTP_BATCH
+// Append one record to the JSON array as an escaped string.
+// Returns false if the record does not fit.
+static bool http_batch_append(char *body, size_t *body_len, size_t body_size, char *record, size_t record_len)
+{
+	size_t len = *body_len;
+	// Keep room for the closing bracket
+	size_t limit = body_size - 1;
+	if (len > 1) {
+		if (len + 1 > limit) return false;
+		body[len++] = ',';
+	}
+	if (len + 1 > limit) return false;
+	body[len++] = '"';
+	for (int i=0;i<record_len;i++) {
+		unsigned char c = record[i];
+		if (c == '"' || c == '\\') {
+			if (len + 2 > limit) return false;
+			body[len++] = '\\';
+			body[len++] = c;
+		} else if (c < 0x20) {
+			// Control characters including the ESC of ANSI color codes
+			if (len + 6 > limit) return false;
+			len += sprintf(&body[len], "\\u%04x", c);
+		} else {
+			if (len + 1 > limit) return false;
+			body[len++] = c;
+		}
+	}
+	if (len + 1 > limit) return false;
+	body[len++] = '"';
+	*body_len = len;
+	return true;
+}
+#endif
 
 void http_client(void *pvParameters)
 {
 	PARAMETER_t *task_parameter = pvParameters;
 	PARAMETER_t param;
 	memcpy((char *)&param, task_parameter, sizeof(PARAMETER_t));
+	free(task_parameter);
+	http_sink = param.sink;
 	//printf("Start:param.url=[%s]\n", param.url);
 
-	// Send ready to receive notify
-	xTaskNotifyGive(param.taskHandle);
+	static char local_response_buffer[MAX_HTTP_OUTPUT_BUFFER] = {0};
+	esp_http_client_handle_t client = http_client_init_with_url(param.url, local_response_buffer);
+
+#if CONFIG_HTTP_BATCH
+	// Records are accumulated into one JSON array until it is full or the oldest record is too old
+	static char body[CONFIG_HTTP_BATCH_SIZE];
+	size_t body_len = 0;
+	TickType_t age_ticks = pdMS_TO_TICKS(CONFIG_HTTP_BATCH_AGE_MS);
+	if (age_ticks == 0) age_ticks = 1;
+	TickType_t batch_start = 0;
+#endif
 
 	while (1) {
-#if CONFIG_USE_RINGBUFFER
-        size_t received;
-        char *buffer = (char *)xRingbufferReceive(xRingBufferTrans, &received, portMAX_DELAY);
-        //printf("xRingBufferReceive received=%d\n", received);
-#else
-		char buffer[xItemSize];
-		size_t received = xMessageBufferReceive(xMessageBufferTrans, buffer, sizeof(buffer), portMAX_DELAY);
-		//printf("xMessageBufferReceive received=%d\n", received);
+		TickType_t xTicksToWait = portMAX_DELAY;
+#if CONFIG_HTTP_BATCH
+		if (body_len) {
+			TickType_t elapsed = xTaskGetTickCount() - batch_start;
+			xTicksToWait = (elapsed < age_ticks) ? age_ticks - elapsed : 0;
+		}
 #endif
+		char buffer[xItemSize];
+		size_t received = sink_receive(param.sink, buffer, sizeof(buffer), xTicksToWait);
 		if (received > 0) {
 			//printf("xMessageBufferReceive buffer=[%.*s]\n",received, buffer);
 			// Remove trailing LF
 			if (buffer[received-1] == 0x0a) received = received - 1;
 			if (received) {
-				http_post_with_url(param.url, buffer, received);
+#if CONFIG_HTTP_BATCH
+				if (body_len == 0) {
+					body[0] = '[';
+					body_len = 1;
+					batch_start = xTaskGetTickCount();
+				}
+				if (http_batch_append(body, &body_len, sizeof(body), buffer, received) == false) {
+					// Flush and start a new array
+					if (body_len > 1) {
+						body[body_len++] = ']';
+						http_post_with_client(client, local_response_buffer, body, body_len);
+						body_len = 1;
+						batch_start = xTaskGetTickCount();
+					}
+					if (http_batch_append(body, &body_len, sizeof(body), buffer, received) == false) {
+						printf("Record too large for CONFIG_HTTP_BATCH_SIZE. Skip to send\n");
+					}
+				}
+#else
+				http_post_with_client(client, local_response_buffer, buffer, received);
+#endif
+			}
+		} else if (xTicksToWait != portMAX_DELAY) {
+#if CONFIG_HTTP_BATCH
+			// Batch age expired
+			if (body_len > 1) {
+				body[body_len++] = ']';
+				http_post_with_client(client, local_response_buffer, body, body_len);
 			}
-#if CONFIG_USE_RINGBUFFER
-            vRingbufferReturnItem(xRingBufferTrans, (void *)buffer);
+			body_len = 0;
 #endif
 		} else {
 			printf("xMessageBufferReceive fail\n");
@@ -203,5 +327,6 @@ void http_client(void *pvParameters)
 	} // end while
 
 	// Stop connection
+	esp_http_client_cleanup(client);
 	vTaskDelete(NULL);
 }
@@ -0,0 +1,227 @@
+/*
+	Tag and level filter
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "net_logging.h"
+#include "log_filter.h"
+
+#if CONFIG_NET_LOGGING_FILTER
+#define SLOT_LEVEL_MASK 0x07
+#define SLOT_EMPTY 0
+#define SLOT_REMOVED SLOT_LEVEL_MASK // Keeps the probe chain of other tags
+#define TABLE_SIZE CONFIG_NET_LOGGING_FILTER_TAGS
+
+static uint32_t table[TABLE_SIZE];
+static uint8_t default_level = ESP_LOG_VERBOSE;
+
+static const char level_letter[] = "NEWIDV";
+
+// FNV-1a, the low bits are replaced by the level in the slot
+uint32_t log_filter_tag_hash(const char *tag)
+{
+	uint32_t hash = 2166136261u;
+	while (*tag) {
+		hash ^= (uint8_t)*tag++;
+		hash *= 16777619u;
+	}
+	hash &= ~SLOT_LEVEL_MASK;
+	if (hash == 0) hash = SLOT_LEVEL_MASK + 1;
+	return hash;
+}
+
+// Returns the slot of the tag, or of the first free slot on its probe chain
+static uint32_t *table_find(uint32_t hash, bool insert)
+{
+	uint32_t *free_slot = NULL;
+	for (int i=0;i<TABLE_SIZE;i++) {
+		uint32_t *slot = &table[(hash / (SLOT_LEVEL_MASK + 1) + i) % TABLE_SIZE];
+		uint32_t value = __atomic_load_n(slot, __ATOMIC_RELAXED);
+		if ((value & ~SLOT_LEVEL_MASK) == hash) return slot;
+		if (value == SLOT_EMPTY) {
+			if (insert == false) return NULL;
+			return free_slot ? free_slot : slot;
+		}
+		if (insert && free_slot == NULL && (value & SLOT_LEVEL_MASK) == SLOT_REMOVED) free_slot = slot;
+	}
+	return free_slot;
+}
+
+static esp_log_level_t tag_level(const char *tag)
+{
+	uint32_t *slot = table_find(log_filter_tag_hash(tag), false);
+	if (slot) {
+		uint32_t level = __atomic_load_n(slot, __ATOMIC_RELAXED) & SLOT_LEVEL_MASK;
+		if (level != SLOT_REMOVED) return level - 1;
+	}
+	return __atomic_load_n(&default_level, __ATOMIC_RELAXED);
+}
+
+// Find the level and the tag of an ESP_LOGx format string:
+// "<color>L (%lu) %s: ..." or "<color>L (%s) %s: ..." with the system time
+bool log_filter_parse(const char *fmt, va_list l, esp_log_level_t *level, const char **tag)
+{
+	const char *p = fmt;
+	if (*p == '\033') {
+		while (*p && *p != 'm') p++;
+		if (*p) p++;
+	}
+	const char *letter = strchr(level_letter, *p);
+	if (*p == 0 || letter == NULL || strncmp(&p[1], " (%", 3) != 0) return false;
+	*level = letter - level_letter;
+	p += 4;
+	bool time_string = (*p == 's');
+	while (*p && *p != ')') p++;
+	if (strncmp(p, ") %s: ", 6) != 0) return false;
+
+	va_list args;
+	va_copy(args, l);
+	if (time_string) {
+		(void)va_arg(args, const char *);
+	} else {
+		(void)va_arg(args, uint32_t);
+	}
+	*tag = va_arg(args, const char *);
+	va_end(args);
+	return true;
+}
+
+bool log_filter_pass(const char *fmt, va_list l)
+{
+	esp_log_level_t level;
+	const char *tag;
+	// Records without a level are always sent
+	if (log_filter_parse(fmt, l, &level, &tag) == false) return true;
+	if (tag == NULL) return (level <= __atomic_load_n(&default_level, __ATOMIC_RELAXED));
+	return (level <= tag_level(tag));
+}
+
+esp_err_t net_logging_set_level(const char *tag, esp_log_level_t level)
+{
+	if (tag == NULL || level > ESP_LOG_VERBOSE) return ESP_ERR_INVALID_ARG;
+	if (strcmp(tag, "*") == 0) {
+		__atomic_store_n(&default_level, level, __ATOMIC_RELAXED);
+		return ESP_OK;
+	}
+	uint32_t hash = log_filter_tag_hash(tag);
+	uint32_t value = hash | (level + 1);
+	while (1) {
+		uint32_t *slot = table_find(hash, true);
+		if (slot == NULL) return ESP_ERR_NO_MEM;
+		uint32_t expected = __atomic_load_n(slot, __ATOMIC_RELAXED);
+		// Another writer may have taken the free slot in the meantime
+		if (expected != SLOT_EMPTY && (expected & ~SLOT_LEVEL_MASK) != hash && (expected & SLOT_LEVEL_MASK) != SLOT_REMOVED) continue;
+		if (__atomic_compare_exchange_n(slot, &expected, value, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return ESP_OK;
+	}
+}
+
+esp_err_t net_logging_reset_level(const char *tag)
+{
+	if (tag == NULL) return ESP_ERR_INVALID_ARG;
+	uint32_t hash = log_filter_tag_hash(tag);
+	uint32_t *slot = table_find(hash, false);
+	if (slot) __atomic_store_n(slot, hash | SLOT_REMOVED, __ATOMIC_RELAXED);
+	return ESP_OK;
+}
+
+// Apply one "tag@L=rate/burst" setting, the level and the burst are optional
+static esp_err_t control_rate(char *setting, char *equal)
+{
+	char *end;
+	unsigned long rate = strtoul(&equal[1], &end, 10);
+	unsigned long burst = rate;
+	if (*end == '/') burst = strtoul(&end[1], &end, 10);
+	if (*end != 0 || rate > UINT16_MAX || burst > UINT16_MAX) return ESP_ERR_INVALID_ARG;
+	*equal = 0;
+	esp_log_level_t level = ESP_LOG_NONE;
+	char *at = strrchr(setting, '@');
+	if (at) {
+		const char *letter = (at[1] && at[2] == 0) ? strchr(level_letter, toupper((unsigned char)at[1])) : NULL;
+		if (letter == NULL || letter == level_letter) return ESP_ERR_INVALID_ARG;
+		level = letter - level_letter;
+		*at = 0;
+	}
+	if (*setting == 0) return ESP_ERR_INVALID_ARG;
+	return net_logging_set_rate(setting, level, rate, burst);
+}
+
+// Apply one "tag=level" setting
+static esp_err_t control_setting(char *setting)
+{
+	char *equal = strrchr(setting, '=');
+	if (equal == NULL || equal == setting) return ESP_ERR_INVALID_ARG;
+	if (isdigit((unsigned char)equal[1])) return control_rate(setting, equal);
+	if (strlen(equal) != 2) return ESP_ERR_INVALID_ARG;
+	char value = toupper((unsigned char)equal[1]);
+	const char *letter = strchr(level_letter, value);
+	if (value != '-' && letter == NULL) return ESP_ERR_INVALID_ARG;
+	*equal = 0;
+	// "tag=-" removes the tag, it uses the default level again
+	if (value == '-') return net_logging_reset_level(setting);
+	return net_logging_set_level(setting, letter - level_letter);
+}
+
+esp_err_t net_logging_control(const char *command, size_t length)
+{
+	char setting[32];
+	size_t setting_len = 0;
+	bool too_long = false;
+	esp_err_t ret = ESP_OK;
+	// Settings are separated by white space, commas or semicolons
+	for (size_t i=0;i<=length;i++) {
+		char c = (i < length) ? command[i] : ' ';
+		if (c == ' ' || c == ',' || c == ';' || c == '\n' || c == '\r' || c == '\t') {
+			if (setting_len == 0) continue;
+			setting[setting_len] = 0;
+			esp_err_t err = too_long ? ESP_ERR_INVALID_SIZE : control_setting(setting);
+			if (err != ESP_OK) {
+				printf("net_logging: invalid control setting [%s]\n", setting);
+				ret = err;
+			}
+			setting_len = 0;
+			too_long = false;
+		} else if (setting_len + 1 < sizeof(setting)) {
+			setting[setting_len++] = c;
+		} else {
+			too_long = true;
+		}
+	}
+	return ret;
+}
+#else
+bool log_filter_parse(const char *fmt, va_list l, esp_log_level_t *level, const char **tag)
+{
+	return false;
+}
+
+bool log_filter_pass(const char *fmt, va_list l)
+{
+	return true;
+}
+
+esp_err_t net_logging_set_level(const char *tag, esp_log_level_t level)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t net_logging_reset_level(const char *tag)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t net_logging_control(const char *command, size_t length)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
@@ -0,0 +1,26 @@
+#ifndef LOG_FILTER_H_
+#define LOG_FILTER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include "esp_log.h"
+
+// Network side level per tag, looked up before the record is formatted.
+// Each slot holds the upper bits of the tag hash and the level in one word,
+// so the logging tasks read the table without a lock.
+// Tags that are not in the table use the default level.
+
+bool log_filter_pass(const char *fmt, va_list l);
+// Level and tag of an ESP_LOGx format string, false for other records
+bool log_filter_parse(const char *fmt, va_list l, esp_log_level_t *level, const char **tag);
+uint32_t log_filter_tag_hash(const char *tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOG_FILTER_H_ */
@@ -9,30 +9,42 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <stdint.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
-#if CONFIG_USE_RINGBUFFER
-#include "freertos/ringbuf.h"
-#else
-#include "freertos/message_buffer.h"
-#endif
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_mac.h" // esp_base_mac_addr_get
 #include "mqtt_client.h"
 
 #include "net_logging.h"
+#include "sink.h"
+#if CONFIG_NET_LOGGING_SPOOL_MQTT
+#include "spool.h"
+
+// Check the connection this often while spooling
+#define MQTT_SPOOL_POLL_MS 100
+#endif
 
 EventGroupHandle_t mqtt_status_event_group;
+// Reports the connection to the broker
+static SINK_t *mqtt_sink;
 #define MQTT_CONNECTED_BIT BIT2
+// Failed publishes of one payload before it is dropped
+#define MQTT_PUBLISH_RETRIES 5
 
-#if CONFIG_USE_RINGBUFFER
-extern RingbufHandle_t xRingBufferTrans;
+#if CONFIG_MQTT_BATCH
+#define MQTT_PAYLOAD_SIZE CONFIG_MQTT_BATCH_SIZE
 #else
-extern MessageBufferHandle_t xMessageBufferTrans;
+#define MQTT_PAYLOAD_SIZE xItemSize
+#endif
+
+#if CONFIG_NET_LOGGING_FILTER
+// Filter settings are received on <topic>/control
+static char control_topic[sizeof(((PARAMETER_t *)0)->topic) + 8];
 #endif
 
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
@@ -47,11 +59,16 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 	switch (event->event_id) {
 		case MQTT_EVENT_CONNECTED:
 			//ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+#if CONFIG_NET_LOGGING_FILTER
+			esp_mqtt_client_subscribe(event->client, control_topic, 0);
+#endif
 			xEventGroupSetBits(mqtt_status_event_group, MQTT_CONNECTED_BIT);
+			sink_set_connected(mqtt_sink, true);
 			break;
 		case MQTT_EVENT_DISCONNECTED:
 			//ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
 			xEventGroupClearBits(mqtt_status_event_group, MQTT_CONNECTED_BIT);
+			sink_set_connected(mqtt_sink, false);
 			break;
 		case MQTT_EVENT_SUBSCRIBED:
 			//ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
@@ -64,6 +81,13 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
 			break;
 		case MQTT_EVENT_DATA:
 			//ESP_LOGI(TAG, "MQTT_EVENT_DATA");
+#if CONFIG_NET_LOGGING_FILTER
+			// Settings split over several events are ignored
+			if (event->topic_len == strlen(control_topic) && strncmp(event->topic, control_topic, event->topic_len) == 0
+				&& event->data_len == event->total_data_len) {
+				net_logging_control(event->data, event->data_len);
+			}
+#endif
 			break;
 		case MQTT_EVENT_ERROR:
 			//ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
@@ -82,8 +106,14 @@ void mqtt_pub(void *pvParameters)
 	PARAMETER_t *task_parameter = pvParameters;
 	PARAMETER_t param;
 	memcpy((char *)&param, task_parameter, sizeof(PARAMETER_t));
+	free(task_parameter);
+	mqtt_sink = param.sink;
 	//printf("Start:param.url=[%s] param.topic=[%s]\n", param.url, param.topic);
 
+#if CONFIG_NET_LOGGING_FILTER
+	snprintf(control_topic, sizeof(control_topic), "%s/control", param.topic);
+#endif
+
 	// Create Event Group
 	mqtt_status_event_group = xEventGroupCreate();
 	configASSERT( mqtt_status_event_group );
@@ -115,47 +145,75 @@ void mqtt_pub(void *pvParameters)
 	esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
 #endif
 
+	// The event group is created with the bit cleared, the main loop waits for the connection
 	esp_mqtt_client_start(mqtt_client);
-	xEventGroupClearBits(mqtt_status_event_group, MQTT_CONNECTED_BIT);
 
-	// Wait for connection
-	xEventGroupWaitBits(mqtt_status_event_group, MQTT_CONNECTED_BIT, false, true, portMAX_DELAY);
-	//printf("Connected to MQTT Broker\n");
+	// Records are packed into one payload, separated by LF
+	static char payload[MQTT_PAYLOAD_SIZE];
+	size_t payload_len = 0;
+	uint32_t payload_records = 0;
+	int publish_failures = 0;
 
-	// Send ready to receive notify
-	xTaskNotifyGive(param.taskHandle);
+#if CONFIG_NET_LOGGING_SPOOL_MQTT
+	spool_open(CONFIG_NET_LOGGING_SPOOL_PARTITION);
+#endif
 
 	while (1) {
-#if CONFIG_USE_RINGBUFFER
-		size_t received;
-		char *buffer = (char *)xRingbufferReceive(xRingBufferTrans, &received, portMAX_DELAY);
-		//printf("xRingBufferReceive received=%d\n", received);
+#if CONFIG_NET_LOGGING_SPOOL_MQTT
+		// Records go to the spool while the broker is not connected
+		while ((xEventGroupGetBits(mqtt_status_event_group) & MQTT_CONNECTED_BIT) == 0) {
+			spool_store(param.sink, pdMS_TO_TICKS(MQTT_SPOOL_POLL_MS));
+		}
 #else
-		char buffer[xItemSize];
-		size_t received = xMessageBufferReceive(xMessageBufferTrans, buffer, sizeof(buffer), portMAX_DELAY);
-		//printf("xMessageBufferReceive received=%d\n", received);
+		// Records stay in the buffer while the broker is not connected
+		xEventGroupWaitBits(mqtt_status_event_group, MQTT_CONNECTED_BIT, false, true, portMAX_DELAY);
 #endif
-		if (received > 0) {
-			//printf("xMessageBufferReceive buffer=[%.*s]\n",received, buffer);
-			EventBits_t EventBits = xEventGroupGetBits(mqtt_status_event_group);
-			//printf("EventBits=%x\n", EventBits);
-			if (EventBits & MQTT_CONNECTED_BIT) {
-				// Remove trailing LF
-				if (buffer[received-1] == 0x0a) received = received - 1;
-				if (received) {
-					esp_mqtt_client_publish(mqtt_client, param.topic, buffer, received, 1, 0);
-					//printf("sent publish successful\n");
-				}
-			} else {
-				printf("Connection to MQTT broker is broken. Skip to send\n");
-			}
-#if CONFIG_USE_RINGBUFFER
-			vRingbufferReturnItem(xRingBufferTrans, (void *)buffer);
+
+		if (payload_len == 0) {
+			// Wait for the first record, then take every record that is already available
+			TickType_t xTicksToWait = portMAX_DELAY;
+			while (payload_len + xItemSize <= sizeof(payload)) {
+#if CONFIG_NET_LOGGING_SPOOL_MQTT
+				// Records spooled while offline are published first
+				size_t received = spool_sink_receive(param.sink, &payload[payload_len], xItemSize, xTicksToWait);
+#else
+				size_t received = sink_receive(param.sink, &payload[payload_len], xItemSize, xTicksToWait);
 #endif
-		} else {
-			printf("xMessageBufferReceive fail\n");
-			break;
+				if (received == 0) break;
+				//printf("sink_receive buffer=[%.*s]\n",received, &payload[payload_len]);
+				payload_len += received;
+				payload_records++;
+				xTicksToWait = 0;
+			}
+		}
+		// Nothing yet, the spool is waiting for the replay rate
+		if (payload_len == 0) continue;
+
+		// Remove trailing LF
+		size_t publish_len = payload_len;
+		if (payload[publish_len-1] == 0x0a) publish_len = publish_len - 1;
+		if (publish_len == 0) {
+			payload_len = 0;
+			payload_records = 0;
+			continue;
+		}
+		int msg_id = esp_mqtt_client_publish(mqtt_client, param.topic, payload, publish_len, CONFIG_MQTT_QOS, 0);
+		sink_sent(param.sink, publish_len, msg_id >= 0);
+		if (msg_id < 0 && ++publish_failures < MQTT_PUBLISH_RETRIES) {
+			// Keep the payload and publish it again after reconnecting
+			printf("Connection to MQTT broker is broken. Retry after reconnect\n");
+			vTaskDelay(pdMS_TO_TICKS(100));
+			continue;
+		}
+		if (msg_id < 0) {
+			// A payload the client keeps refusing would block every later record
+			printf("MQTT publish failed %d times, %"PRIu32" records dropped\n", publish_failures, payload_records);
+			sink_discard(param.sink, payload_records);
 		}
+		//printf("sent publish successful\n");
+		payload_len = 0;
+		payload_records = 0;
+		publish_failures = 0;
 	} // end while
 
 	// Stop connection
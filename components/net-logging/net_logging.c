@@ -1,183 +1,806 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include <string.h>
-#include <assert.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #if CONFIG_USE_RINGBUFFER
 #include "freertos/ringbuf.h"
+#elif CONFIG_USE_PERCORE_RING
+#include "percore_ring.h"
+#elif CONFIG_USE_SLAB_POOL
+#include "slab_pool.h"
 #else
 #include "freertos/message_buffer.h"
 #endif
 
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
 
 #include "net_logging.h"
+#include "sink.h"
+#include "frame.h"
+#include "log_filter.h"
+#include "rate_limit.h"
+#include "early_capture.h"
+#if CONFIG_DEFERRED_FORMAT
+#include "deferred_format.h"
+#endif
+#if CONFIG_COMPACT_FORMAT
+#include "compact_format.h"
+#endif
 
 #if CONFIG_USE_RINGBUFFER
+#define IPC_NAME "xRingBuffer"
 RingbufHandle_t xRingBufferTrans;
+static StaticRingbuffer_t xRingBufferStruct;
+#elif CONFIG_USE_PERCORE_RING
+#define IPC_NAME "per-core ring"
+#elif CONFIG_USE_SLAB_POOL
+#define IPC_NAME "slab pool"
 #else
+#define IPC_NAME "xMessageBuffer"
 MessageBufferHandle_t xMessageBufferTrans;
+static StaticMessageBuffer_t xMessageBufferStruct;
 #endif
 bool writeToStdout;
 
+// The dispatcher reads records in place unless they are formatted on the way
+#if (CONFIG_USE_RINGBUFFER || CONFIG_USE_PERCORE_RING || CONFIG_USE_SLAB_POOL) && !CONFIG_DEFERRED_FORMAT_IN_SENDER
+#define DISPATCH_IN_PLACE 1
+#endif
+
+static NET_LOGGING_CONFIG_t logging_config = NET_LOGGING_CONFIG_DEFAULT();
+
+// Records and bytes dropped on overflow, per level
+static NET_LOGGING_DROPPED_t dropped;
+// Records dropped since the last "records dropped" marker
+static uint32_t dropped_since_marker;
+
+// Counters of net_logging_get_stats, the dispatcher counters have a single writer
+static struct {
+	uint32_t enqueued;
+	uint32_t dispatched;
+	uint32_t buffer_size;
+	uint32_t buffer_high_water;
+	uint32_t vprintf_calls;
+	uint32_t vprintf_time_us;
+	uint32_t vprintf_max_us;
+} stats;
+
+static uint32_t logging_time_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#else
+	return esp_timer_get_time();
+#endif
+}
+
+// Level of a formatted record or of a format string
+static esp_log_level_t logging_level(const char *text, size_t length)
+{
+	size_t pos = 0;
+	// Skip the color escape sequence
+	if (length && text[0] == '\033') {
+		while (pos < length && text[pos] != 'm') pos++;
+		pos++;
+	}
+	if (pos >= length) return ESP_LOG_NONE;
+	switch (text[pos]) {
+		case 'E': return ESP_LOG_ERROR;
+		case 'W': return ESP_LOG_WARN;
+		case 'I': return ESP_LOG_INFO;
+		case 'D': return ESP_LOG_DEBUG;
+		case 'V': return ESP_LOG_VERBOSE;
+		default: return ESP_LOG_NONE;
+	}
+}
+
+static void logging_count_drop(esp_log_level_t level, size_t length)
+{
+	__atomic_fetch_add(&dropped.records[level], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&dropped.bytes[level], length, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&dropped_since_marker, 1, __ATOMIC_RELAXED);
+}
+
+static bool logging_send(const char *buffer, size_t buffer_len)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+#if CONFIG_USE_RINGBUFFER
+	// Send RingBuffer
+	BaseType_t sended = xRingbufferSendFromISR(xRingBufferTrans, buffer, buffer_len, &xHigherPriorityTaskWoken);
+	//printf("logging_send sended=%d\n",sended);
+	bool ret = (sended == pdTRUE);
+#elif CONFIG_USE_PERCORE_RING
+	// Send per-core ring
+	(void)xHigherPriorityTaskWoken;
+	bool ret = percore_ring_send(buffer, buffer_len);
+#elif CONFIG_USE_SLAB_POOL
+	// Send slab pool
+	(void)xHigherPriorityTaskWoken;
+	bool ret = slab_pool_send(buffer, buffer_len);
+#else
+	// Send MessageBuffer
+	size_t sended = xMessageBufferSendFromISR(xMessageBufferTrans, buffer, buffer_len, &xHigherPriorityTaskWoken);
+	//printf("logging_send sended=%d\n",sended);
+	bool ret = (sended == buffer_len);
+#endif
+	if (ret) __atomic_fetch_add(&stats.enqueued, 1, __ATOMIC_RELAXED);
+	return ret;
+}
+
+static bool logging_in_isr(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+	// There are no interrupts on the host
+	return false;
+#else
+	return xPortInIsrContext();
+#endif
+}
+
+#if CONFIG_OVERFLOW_BLOCK
+// Wait for the sender task, but never in an interrupt or a critical section
+static bool logging_can_block(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+	return (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+#else
+	return (!logging_in_isr() && xPortCanYield() && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+#endif
+}
+#endif
+
+// Apply the overflow policy when the buffer is full
+static bool logging_enqueue(const char *buffer, size_t buffer_len)
+{
+	if (logging_send(buffer, buffer_len)) return true;
+
+#if CONFIG_OVERFLOW_DROP_OLDEST
+	// Discard the oldest records until the new one fits
+	while (1) {
+		size_t item_len;
+		char *item = (char *)xRingbufferReceiveFromISR(xRingBufferTrans, &item_len);
+		if (item == NULL) break;
+#if CONFIG_DEFERRED_FORMAT
+		if (deferred_format_is_record(item, item_len)) {
+			const char *fmt = deferred_format_fmt(item);
+			logging_count_drop(logging_level(fmt, strlen(fmt)), item_len);
+		} else
+#endif
+#if CONFIG_COMPACT_FORMAT
+		if (compact_format_is_record(item, item_len)) {
+			logging_count_drop(compact_format_level(item), item_len);
+		} else
+#endif
+		logging_count_drop(logging_level(item, item_len), item_len);
+		BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+		vRingbufferReturnItemFromISR(xRingBufferTrans, item, &xHigherPriorityTaskWoken);
+		if (logging_send(buffer, buffer_len)) return true;
+	}
+#elif CONFIG_OVERFLOW_BLOCK
+	if (logging_can_block()) {
+		TickType_t start = xTaskGetTickCount();
+		while (xTaskGetTickCount() - start < pdMS_TO_TICKS(CONFIG_OVERFLOW_BLOCK_TIMEOUT_MS)) {
+			vTaskDelay(1);
+			if (logging_send(buffer, buffer_len)) return true;
+		}
+	}
+#endif
+	return false;
+}
+
+#if CONFIG_USE_PERCORE_RING
+// Reserve space for the longest record, applying the overflow policy when the ring is full
+static char *logging_reserve(PERCORE_RING_RESERVATION_t *reservation)
+{
+	char *buffer = percore_ring_reserve(xItemSize, reservation);
+#if CONFIG_OVERFLOW_BLOCK
+	if (buffer == NULL && logging_can_block()) {
+		TickType_t start = xTaskGetTickCount();
+		while (buffer == NULL && xTaskGetTickCount() - start < pdMS_TO_TICKS(CONFIG_OVERFLOW_BLOCK_TIMEOUT_MS)) {
+			vTaskDelay(1);
+			buffer = percore_ring_reserve(xItemSize, reservation);
+		}
+	}
+#endif
+	return buffer;
+}
+#endif
+
+void net_logging_get_dropped(NET_LOGGING_DROPPED_t *result) {
+	for (int level=0; level<=ESP_LOG_VERBOSE; level++) {
+		result->records[level] = __atomic_load_n(&dropped.records[level], __ATOMIC_RELAXED);
+		result->bytes[level] = __atomic_load_n(&dropped.bytes[level], __ATOMIC_RELAXED);
+	}
+}
+
+#if CONFIG_NET_LOGGING_LONG_RECORD_SIZE
+// Identifies the fragments of one record
+static uint16_t fragment_id;
+
+// Format a record that is longer than one item into the heap.
+// Returns NULL if the record has to be truncated instead.
+static char *logging_format_long(const char *fmt, va_list l, size_t length)
+{
+	// No heap allocation in an interrupt
+	if (logging_in_isr()) return NULL;
+	char *text = malloc(FRAGMENT_HEADER_SIZE + length + 1);
+	if (text == NULL) return NULL;
+	vsnprintf(&text[FRAGMENT_HEADER_SIZE], length + 1, fmt, l);
+	return text;
+}
+
+// Send a record formatted by logging_format_long in fragments
+static void logging_send_fragments(char *text, size_t length, esp_log_level_t level)
+{
+	uint16_t id = __atomic_fetch_add(&fragment_id, 1, __ATOMIC_RELAXED);
+	size_t chunk = xItemSize - FRAGMENT_HEADER_SIZE;
+	for (uint16_t index=0; index*chunk<length; index++) {
+		// The header of each fragment overwrites the end of the previous one, which is already sent
+		char *fragment = &text[index*chunk];
+		size_t fragment_len = length - index*chunk;
+		uint16_t header_index = index;
+		if (fragment_len <= chunk) {
+			header_index |= FRAGMENT_LAST;
+		} else {
+			fragment_len = chunk;
+		}
+		fragment_len += FRAGMENT_HEADER_SIZE;
+		fragment[0] = FRAME_MARKER;
+		fragment[1] = FRAME_TYPE_FRAGMENT;
+		fragment[2] = fragment_len & 0xff;
+		fragment[3] = (fragment_len >> 8) & 0xff;
+		memcpy(&fragment[FRAME_HEADER_SIZE], &id, sizeof(id));
+		memcpy(&fragment[FRAME_HEADER_SIZE+2], &header_index, sizeof(header_index));
+		if (logging_enqueue(fragment, fragment_len) == false) {
+			logging_count_drop(level, fragment_len);
+		}
+	}
+	free(text);
+}
+#endif
+
+// Report dropped records as soon as there is space again
+static void logging_report_dropped(void) {
+	uint32_t dropped_records = __atomic_load_n(&dropped_since_marker, __ATOMIC_RELAXED);
+	if (dropped_records) {
+		char marker[80];
+		int marker_len = snprintf(marker, sizeof(marker), LOG_COLOR_W "W (%"PRIu32") net_logging: %"PRIu32" records dropped" LOG_RESET_COLOR "\n",
+			esp_log_timestamp(), dropped_records);
+		if (logging_send(marker, marker_len)) {
+			__atomic_fetch_sub(&dropped_since_marker, dropped_records, __ATOMIC_RELAXED);
+		}
+	}
+}
+
 int logging_vprintf( const char *fmt, va_list l ) {
-	// Convert according to format
+	uint32_t start_us = logging_time_us();
+	uint32_t elapsed_us;
+	int ret = 0;
+	logging_report_dropped();
+#if CONFIG_NET_LOGGING_FILTER
+	// Rejected records are neither formatted nor sent
+	if (log_filter_pass(fmt, l) == false) goto write_stdout;
+#endif
+#if CONFIG_NET_LOGGING_RATE_LIMIT
+	// Records over the budget of their tag are neither formatted nor sent
+	if (rate_limit_pass(fmt, l) == false) goto write_stdout;
+#endif
+#if CONFIG_USE_PERCORE_RING
+	// Format straight into the ring: no copy and no record buffer on the stack of the caller
+	PERCORE_RING_RESERVATION_t reservation;
+	char *buffer = logging_reserve(&reservation);
+	size_t buffer_size = xItemSize;
+	if (buffer == NULL) {
+		// The length is not known without formatting, the length of the format string is counted
+		logging_count_drop(logging_level(fmt, strlen(fmt)), strlen(fmt));
+		goto write_stdout;
+	}
+#else
 	char buffer[xItemSize];
-	int buffer_len = vsprintf(buffer, fmt, l);
+	size_t buffer_size = sizeof(buffer);
+#endif
+#if CONFIG_DEFERRED_FORMAT
+	// Copy the format pointer and the raw arguments instead of formatting
+	va_list args;
+	va_copy(args, l);
+	int buffer_len = deferred_format_pack(buffer, buffer_size, fmt, args);
+	va_end(args);
+	// Format strings outside of flash and unsupported conversions are formatted here
+	if (buffer_len < 0) {
+		va_copy(args, l);
+		buffer_len = vsnprintf(buffer, buffer_size, fmt, args);
+		va_end(args);
+	}
+#else
+	// Convert according to format
+	va_list args;
+	va_copy(args, l);
+	int buffer_len = vsnprintf(buffer, buffer_size, fmt, args);
+	va_end(args);
+#endif
+	if (buffer_len >= (int)buffer_size) {
+#if CONFIG_NET_LOGGING_LONG_RECORD_SIZE
+		// Long records are split into fragments
+		size_t long_len = buffer_len;
+		if (long_len > CONFIG_NET_LOGGING_LONG_RECORD_SIZE) long_len = CONFIG_NET_LOGGING_LONG_RECORD_SIZE;
+		va_copy(args, l);
+		char *text = logging_format_long(fmt, args, long_len);
+		va_end(args);
+		if (text) {
+#if CONFIG_USE_PERCORE_RING
+			// An open reservation would hold back the fragments
+			percore_ring_commit(&reservation, 0);
+#endif
+			logging_send_fragments(text, long_len, logging_level(fmt, strlen(fmt)));
+			goto write_stdout;
+		}
+#endif
+		// Otherwise they are truncated
+		buffer_len = buffer_size - 1;
+	}
+#if CONFIG_COMPACT_FORMAT
+	// Parse the prefix once here, the senders send it in compact form
+	if (buffer_len > 0 && buffer[0] != FRAME_MARKER) {
+		int record_len = compact_format_pack(buffer, buffer_size, buffer_len, xPortGetCoreID());
+		if (record_len > 0) buffer_len = record_len;
+	}
+#endif
 	//printf("logging_vprintf buffer_len=%d\n",buffer_len);
 	//printf("logging_vprintf buffer=[%.*s]\n", buffer_len, buffer);
-	if (buffer_len > 0) {
-		BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-#if CONFIG_USE_RINGBUFFER
-		// Send RingBuffer
-		BaseType_t sended = xRingbufferSendFromISR(xRingBufferTrans, &buffer, strlen(buffer), &xHigherPriorityTaskWoken);
-		//printf("logging_vprintf sended=%d\n",sended);
-		assert(sended == pdTRUE);
+#if CONFIG_USE_PERCORE_RING
+	percore_ring_commit(&reservation, (buffer_len > 0) ? buffer_len : 0);
+	if (buffer_len > 0) __atomic_fetch_add(&stats.enqueued, 1, __ATOMIC_RELAXED);
 #else
-		// Send MessageBuffer
-		size_t sended = xMessageBufferSendFromISR(xMessageBufferTrans, &buffer, buffer_len, &xHigherPriorityTaskWoken);
-		//printf("logging_vprintf sended=%d\n",sended);
-		assert(sended == buffer_len);
-#endif
+	if (buffer_len > 0) {
+		if (logging_enqueue(buffer, buffer_len) == false) {
+			logging_count_drop(logging_level(fmt, strlen(fmt)), buffer_len);
+		}
 	}
+#endif
 
-	// Write to stdout
+#if CONFIG_USE_PERCORE_RING || CONFIG_NET_LOGGING_LONG_RECORD_SIZE || CONFIG_NET_LOGGING_FILTER
+write_stdout:
+#endif
+#if !CONFIG_NET_LOGGING_STDOUT_ASYNC
+	// Write to stdout, otherwise the STDOUT sink writes the record from the ring
 	if (writeToStdout) {
-		return vprintf( fmt, l );
-	} else {
-		return 0;
+		ret = vprintf( fmt, l );
 	}
+#endif
+
+	elapsed_us = logging_time_us() - start_us;
+	__atomic_fetch_add(&stats.vprintf_calls, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.vprintf_time_us, elapsed_us, __ATOMIC_RELAXED);
+	// A racing caller may lose its maximum, this is only a statistic
+	if (elapsed_us > stats.vprintf_max_us) stats.vprintf_max_us = elapsed_us;
+	return ret;
 }
 
-void udp_client(void *pvParameters);
+#if !DISPATCH_IN_PLACE
+static size_t logging_receive(char *buffer, size_t size, TickType_t xTicksToWait) {
+#if CONFIG_USE_RINGBUFFER
+	size_t received = 0;
+	char *item = (char *)xRingbufferReceive(xRingBufferTrans, &received, xTicksToWait);
+	//printf("xRingBufferReceive received=%d\n", received);
+	if (item == NULL) return 0;
+	if (received > size) received = size;
+	memcpy(buffer, item, received);
+	vRingbufferReturnItem(xRingBufferTrans, (void *)item);
+#elif CONFIG_USE_PERCORE_RING
+	size_t received = percore_ring_receive(buffer, size, xTicksToWait);
+	//printf("percore_ring_receive received=%d\n", received);
+#elif CONFIG_USE_SLAB_POOL
+	size_t received = slab_pool_receive(buffer, size, xTicksToWait);
+	//printf("slab_pool_receive received=%d\n", received);
+#else
+	size_t received = xMessageBufferReceive(xMessageBufferTrans, buffer, size, xTicksToWait);
+	//printf("xMessageBufferReceive received=%d\n", received);
+#endif
 
-esp_err_t udp_logging_init(char *ipaddr, unsigned long port, int16_t enableStdout) {
+#if CONFIG_DEFERRED_FORMAT_IN_SENDER
+	// Format deferred records once for all sinks
+	if (deferred_format_is_record(buffer, received)) {
+		char record[xItemSize];
+		memcpy(record, buffer, received);
+		int text_len = deferred_format_unpack(buffer, size, record, received);
+		if (text_len <= 0) text_len = snprintf(buffer, size, "deferred record decode failed\n");
+		received = text_len;
+	}
+#endif
+	return received;
+}
+#endif
 
+esp_err_t net_logging_configure(const NET_LOGGING_CONFIG_t *config) {
+	if (config->buffer_size < xItemSize) return ESP_ERR_INVALID_SIZE;
+	logging_config = *config;
+	return ESP_OK;
+}
+
+// Create the buffer with the size and memory capabilities given to net_logging_configure
+static esp_err_t logging_buffer_create(void) {
+	// Ring buffer items are 4-byte aligned
+	size_t buffer_size = (logging_config.buffer_size + 3) & ~3;
+	printf("logging buffer size=%d caps=0x%"PRIx32"\n", (int)buffer_size, logging_config.buffer_caps);
 #if CONFIG_USE_RINGBUFFER
-	printf("start udp logging(xRingBuffer): ipaddr=[%s] port=%ld\n", ipaddr, port);
 	// Create RineBuffer
-	xRingBufferTrans = xRingbufferCreate(xBufferSizeBytes, RINGBUF_TYPE_NOSPLIT);
+	uint8_t *storage = heap_caps_malloc(buffer_size, logging_config.buffer_caps);
+	if (storage == NULL) return ESP_ERR_NO_MEM;
+	xRingBufferTrans = xRingbufferCreateStatic(buffer_size, RINGBUF_TYPE_NOSPLIT, storage, &xRingBufferStruct);
 	configASSERT( xRingBufferTrans );
+#elif CONFIG_USE_PERCORE_RING
+	// Create per-core rings
+	if (percore_ring_create(buffer_size, logging_config.buffer_caps) == false) return ESP_ERR_NO_MEM;
+	buffer_size = buffer_size * portNUM_PROCESSORS;
+#elif CONFIG_USE_SLAB_POOL
+	// Create slot classes
+	if (slab_pool_create(buffer_size, xItemSize, logging_config.buffer_caps) == false) return ESP_ERR_NO_MEM;
 #else
-	printf("start udp logging(xMessageBuffer): ipaddr=[%s] port=%ld\n", ipaddr, port);
 	// Create MessageBuffer
-	xMessageBufferTrans = xMessageBufferCreate(xBufferSizeBytes);
+	// The storage area of a static stream buffer needs one extra byte
+	uint8_t *storage = heap_caps_malloc(buffer_size + 1, logging_config.buffer_caps);
+	if (storage == NULL) return ESP_ERR_NO_MEM;
+	xMessageBufferTrans = xMessageBufferCreateStatic(buffer_size, storage, &xMessageBufferStruct);
 	configASSERT( xMessageBufferTrans );
 #endif
+	stats.buffer_size = buffer_size;
+	return ESP_OK;
+}
 
-	// Start UDP task
-	PARAMETER_t param;
-	param.port = port;
-	strcpy(param.ipv4, ipaddr);
-	param.taskHandle = xTaskGetCurrentTaskHandle();
-	xTaskCreate(udp_client, "UDP", 1024*6, (void *)&param, 2, NULL);
+// Bytes in the buffer, for the high-water mark
+static size_t logging_buffer_used(void) {
+#if CONFIG_USE_RINGBUFFER
+	// The largest free item, so this is an upper bound
+	return stats.buffer_size - xRingbufferGetCurFreeSize(xRingBufferTrans);
+#elif CONFIG_USE_PERCORE_RING
+	return percore_ring_used();
+#elif CONFIG_USE_SLAB_POOL
+	return slab_pool_used();
+#else
+	return stats.buffer_size - xMessageBufferSpacesAvailable(xMessageBufferTrans);
+#endif
+}
 
-	// Wait for ready to receive notify
-	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-	//printf("ulTaskNotifyTake\n");
+// Called by the dispatcher for each record, used includes the record
+static void logging_count_dispatch(size_t used) {
+	stats.dispatched++;
+	if (used > stats.buffer_high_water) stats.buffer_high_water = used;
+}
 
-	// Set function used to output log entries.
+void net_logging_get_stats(NET_LOGGING_STATS_t *result) {
+	memset(result, 0, sizeof(NET_LOGGING_STATS_t));
+	result->enqueued = __atomic_load_n(&stats.enqueued, __ATOMIC_RELAXED);
+	result->dispatched = stats.dispatched;
+	NET_LOGGING_DROPPED_t dropped_now;
+	net_logging_get_dropped(&dropped_now);
+	for (int level=0; level<=ESP_LOG_VERBOSE; level++) {
+		result->dropped += dropped_now.records[level];
+	}
+	result->suppressed = rate_limit_suppressed();
+	result->buffer_size = stats.buffer_size;
+	result->buffer_high_water = stats.buffer_high_water;
+	result->vprintf_calls = __atomic_load_n(&stats.vprintf_calls, __ATOMIC_RELAXED);
+	result->vprintf_time_us = __atomic_load_n(&stats.vprintf_time_us, __ATOMIC_RELAXED);
+	result->vprintf_max_us = stats.vprintf_max_us;
+	result->sink_count = sink_get_stats(result->sinks, NET_LOGGING_SINK_MAX);
+}
+
+#if CONFIG_NET_LOGGING_STATS_INTERVAL
+#define STATS_TAG "netlog_stats"
+
+// Publish the statistics as records, so that collectors can graph them
+static void logging_publish_stats(void) {
+	static NET_LOGGING_STATS_t current;
+	net_logging_get_stats(&current);
+	char record[256];
+	int record_len = snprintf(record, sizeof(record), LOG_COLOR_I "I (%"PRIu32") " STATS_TAG ": enqueued=%"PRIu32" dispatched=%"PRIu32
+		" dropped=%"PRIu32" suppressed=%"PRIu32" buffer_size=%"PRIu32" buffer_hwm=%"PRIu32" vprintf_calls=%"PRIu32" vprintf_us=%"PRIu32" vprintf_max_us=%"PRIu32 LOG_RESET_COLOR "\n",
+		esp_log_timestamp(), current.enqueued, current.dispatched, current.dropped, current.suppressed, current.buffer_size, current.buffer_high_water,
+		current.vprintf_calls, current.vprintf_time_us, current.vprintf_max_us);
+	if (record_len > 0 && record_len < sizeof(record)) sink_publish(record, record_len);
+
+	// One record per sink
+	for (int i=0;i<current.sink_count;i++) {
+		NET_LOGGING_SINK_STATS_t *sink = &current.sinks[i];
+		record_len = snprintf(record, sizeof(record), LOG_COLOR_I "I (%"PRIu32") " STATS_TAG ": sink=%s bytes=%"PRIu32" packets=%"PRIu32
+			" errors=%"PRIu32" lost=%"PRIu32" backlog_hwm=%"PRIu32" latency_ms=",
+			esp_log_timestamp(), sink->name, sink->bytes, sink->packets, sink->errors, sink->lost, sink->backlog_high_water);
+		for (int bucket=0; bucket<NET_LOGGING_LATENCY_BUCKETS && record_len < sizeof(record); bucket++) {
+			record_len += snprintf(&record[record_len], sizeof(record) - record_len, "%s%"PRIu32, bucket ? "," : "", sink->latency[bucket]);
+		}
+		if (record_len < sizeof(record)) record_len += snprintf(&record[record_len], sizeof(record) - record_len, LOG_RESET_COLOR "\n");
+		if (record_len < sizeof(record)) sink_publish(record, record_len);
+	}
+}
+#endif
+
+#if CONFIG_NET_LOGGING_RATE_LIMIT
+// Summarize the records suppressed by the rate limit, off the path of the logging tasks
+static void logging_report_suppressed(void) {
+	char marker[96];
+	int marker_len;
+	while ((marker_len = rate_limit_report(marker, sizeof(marker))) > 0) {
+		if (marker_len < sizeof(marker)) sink_publish(marker, marker_len);
+	}
+}
+#endif
+
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE
+static bool early_flush; // logging_vprintf has taken over, the rest of the capture can be published
+
+static bool logging_publish_early(const char *record, size_t length) {
+	sink_publish_early(record, length);
+	return true;
+}
+#endif
+
+// Move records from the IPC into the fan-out ring shared by all sinks
+static void logging_dispatch(void *pvParameters) {
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE
+	bool early_pending = true;
+#endif
+#if CONFIG_NET_LOGGING_STATS_INTERVAL
+	TickType_t stats_ticks = pdMS_TO_TICKS(CONFIG_NET_LOGGING_STATS_INTERVAL * 1000);
+	TickType_t stats_start = xTaskGetTickCount();
+#endif
+	while(1) {
+		TickType_t xTicksToWait = portMAX_DELAY;
+#if CONFIG_NET_LOGGING_STATS_INTERVAL
+		// The dispatcher is the only writer of the fan-out ring, so it publishes the statistics too
+		TickType_t stats_elapsed = xTaskGetTickCount() - stats_start;
+		if (stats_elapsed >= stats_ticks) {
+			logging_publish_stats();
+			stats_start = xTaskGetTickCount();
+			stats_elapsed = 0;
+		}
+		xTicksToWait = stats_ticks - stats_elapsed;
+#endif
+#if CONFIG_NET_LOGGING_RATE_LIMIT
+		// Suppressed records are summarized even when nothing else is logged
+		logging_report_suppressed();
+		if (xTicksToWait > pdMS_TO_TICKS(RATE_LIMIT_POLL_MS)) xTicksToWait = pdMS_TO_TICKS(RATE_LIMIT_POLL_MS);
+#endif
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE
+		// Records captured while the transport was starting, published once like the rest of the capture
+		if (early_pending) {
+			if (__atomic_load_n(&early_flush, __ATOMIC_ACQUIRE)) {
+				early_capture_flush(logging_publish_early);
+				early_capture_stop();
+				early_pending = false;
+			} else if (xTicksToWait > pdMS_TO_TICKS(10)) {
+				xTicksToWait = pdMS_TO_TICKS(10);
+			}
+		}
+#endif
+#if DISPATCH_IN_PLACE && CONFIG_USE_RINGBUFFER
+		// Publish straight from the ring item
+		size_t received = 0;
+		char *item = (char *)xRingbufferReceive(xRingBufferTrans, &received, xTicksToWait);
+		if (item == NULL) continue;
+		logging_count_dispatch(logging_buffer_used());
+		if (received > 0) sink_publish(item, received);
+		vRingbufferReturnItem(xRingBufferTrans, (void *)item);
+#elif DISPATCH_IN_PLACE && CONFIG_USE_PERCORE_RING
+		// Publish straight from the ring record
+		size_t received = 0;
+		const char *record = percore_ring_acquire(&received, xTicksToWait);
+		if (record == NULL) continue;
+		logging_count_dispatch(logging_buffer_used());
+		if (received > 0) sink_publish(record, received);
+		percore_ring_release(record);
+#elif DISPATCH_IN_PLACE && CONFIG_USE_SLAB_POOL
+		// Publish straight from the slot
+		size_t received = 0;
+		const char *record = slab_pool_acquire(&received, xTicksToWait);
+		if (record == NULL) continue;
+		logging_count_dispatch(logging_buffer_used());
+		if (received > 0) sink_publish(record, received);
+		slab_pool_release(record);
+#else
+		char buffer[xItemSize];
+		size_t received = logging_receive(buffer, sizeof(buffer), xTicksToWait);
+		if (received > 0) {
+			logging_count_dispatch(logging_buffer_used() + received);
+			sink_publish(buffer, received);
+		}
+#endif
+	}
+}
+
+
+// Create the buffer and the dispatcher once, however many sinks are started
+static esp_err_t logging_start(void) {
+	static bool started = false;
+	if (started) return ESP_OK;
+	esp_err_t ret = logging_buffer_create();
+	if (ret != ESP_OK) return ret;
+	size_t sink_size = (logging_config.buffer_size + 3) & ~3;
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE
+	// The ring holds all captured records until the first sink reads them
+	if (sink_size < CONFIG_NET_LOGGING_EARLY_CAPTURE_SIZE + 1024) sink_size = CONFIG_NET_LOGGING_EARLY_CAPTURE_SIZE + 1024;
+#endif
+	ret = sink_create(sink_size, logging_config.buffer_caps);
+	if (ret != ESP_OK) return ret;
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE
+	// The dispatcher is not running yet, so this is the only writer of the ring
+	early_capture_flush(logging_publish_early);
+#endif
+	xTaskCreate(logging_dispatch, "NETLOG", 1024*4, NULL, 3, NULL);
+	started = true;
+	return ESP_OK;
+}
+
+// Parameter of a sender task, the task frees it
+static PARAMETER_t *logging_parameter(const char *name, bool binary) {
+	PARAMETER_t *param = calloc(1, sizeof(PARAMETER_t));
+	if (param == NULL) return NULL;
+	param->sink = sink_register(name, binary);
+	if (param->sink == NULL) {
+		free(param);
+		return NULL;
+	}
+	return param;
+}
+
+// Start a sender task without waiting for it, records are buffered until it connects
+static esp_err_t logging_task(TaskFunction_t task, const char *name, uint32_t stack, UBaseType_t priority, PARAMETER_t *param) {
+	if (xTaskCreate(task, name, stack, (void *)param, priority, NULL) != pdPASS) {
+		free(param);
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+#if CONFIG_NET_LOGGING_STDOUT_ASYNC
+void stdout_sink(void *pvParameters);
+#endif
+
+// Mirror records to STDOUT, the first call that enables it starts the STDOUT sink
+static esp_err_t logging_stdout(int16_t enableStdout) {
+#if CONFIG_NET_LOGGING_STDOUT_ASYNC
+	static bool started = false;
+	if (enableStdout && started == false) {
+		PARAMETER_t *param = logging_parameter("STDOUT", false);
+		if (param == NULL) return ESP_ERR_NO_MEM;
+		// Records in the ring now are already on STDOUT, and so are the records captured early
+		sink_skip(param->sink);
+		sink_skip_early(param->sink);
+		// Below the senders, the UART is the slowest sink
+		esp_err_t ret = logging_task(stdout_sink, "STDOUT", 1024*3, 1, param);
+		if (ret != ESP_OK) return ret;
+		started = true;
+	}
+#endif
 	writeToStdout = enableStdout;
-	esp_log_set_vprintf(logging_vprintf);
 	return ESP_OK;
 }
 
-void tcp_client(void *pvParameters);
+// Take over from the early capture
+static void logging_set_vprintf(void) {
+	esp_log_set_vprintf(logging_vprintf);
+#if CONFIG_NET_LOGGING_EARLY_CAPTURE
+	// The dispatcher publishes the records captured while the transport was starting
+	__atomic_store_n(&early_flush, true, __ATOMIC_RELEASE);
+#endif
+}
 
-esp_err_t tcp_logging_init(char *ipaddr, unsigned long port, int16_t enableStdout) {
+void udp_client(void *pvParameters);
 
-#if CONFIG_USE_RINGBUFFER
-	printf("start tcp logging(xRingBuffer): ipaddr=[%s] port=%ld\n", ipaddr, port);
-	// Create RineBuffer
-	xRingBufferTrans = xRingbufferCreate(xBufferSizeBytes, RINGBUF_TYPE_NOSPLIT);
-	configASSERT( xRingBufferTrans );
+// Syslog and GELF are made from the text of the records
+#if CONFIG_UDP_FORMAT_SYSLOG || CONFIG_UDP_FORMAT_GELF
+#define UDP_BINARY false
 #else
-	printf("start tcp logging(xMessageBuffer): ipaddr=[%s] port=%ld\n", ipaddr, port);
-	// Create MessageBuffer
-	xMessageBufferTrans = xMessageBufferCreate(xBufferSizeBytes);
-	configASSERT( xMessageBufferTrans );
+#define UDP_BINARY true
 #endif
+#if CONFIG_TCP_FORMAT_SYSLOG
+#define TCP_BINARY false
+#else
+#define TCP_BINARY true
+#endif
+
+esp_err_t udp_logging_init(char *ipaddr, unsigned long port, int16_t enableStdout) {
 
-	// Start TCP task
-	PARAMETER_t param;
-	param.port = port;
-	strcpy(param.ipv4, ipaddr);
-	param.taskHandle = xTaskGetCurrentTaskHandle();
-	xTaskCreate(tcp_client, "TCP", 1024*6, (void *)&param, 2, NULL);
+	printf("start udp logging(" IPC_NAME "): ipaddr=[%s] port=%ld\n", ipaddr, port);
+	esp_err_t ret = logging_start();
+	if (ret != ESP_OK) return ret;
 
-	// Wait for ready to receive notify
-	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-	//printf("ulTaskNotifyTake\n");
+	// Start UDP task, it connects in the background
+	PARAMETER_t *param = logging_parameter("UDP", UDP_BINARY);
+	if (param == NULL) return ESP_ERR_NO_MEM;
+	param->port = port;
+	strcpy(param->ipv4, ipaddr);
+	ret = logging_task(udp_client, "UDP", 1024*6, 2, param);
+	if (ret != ESP_OK) return ret;
 
 	// Set function used to output log entries.
-	writeToStdout = enableStdout;
-	esp_log_set_vprintf(logging_vprintf);
+	ret = logging_stdout(enableStdout);
+	if (ret != ESP_OK) return ret;
+	logging_set_vprintf();
 	return ESP_OK;
 }
 
+void tcp_client(void *pvParameters);
+
+esp_err_t tcp_logging_init(char *ipaddr, unsigned long port, int16_t enableStdout) {
+
+	printf("start tcp logging(" IPC_NAME "): ipaddr=[%s] port=%ld\n", ipaddr, port);
+	esp_err_t ret = logging_start();
+	if (ret != ESP_OK) return ret;
+
+	// Start TCP task, it connects in the background
+	PARAMETER_t *param = logging_parameter("TCP", TCP_BINARY);
+	if (param == NULL) return ESP_ERR_NO_MEM;
+	param->port = port;
+	strcpy(param->ipv4, ipaddr);
+	ret = logging_task(tcp_client, "TCP", 1024*6, 2, param);
+	if (ret != ESP_OK) return ret;
+
+	// Set function used to output log entries.
+	ret = logging_stdout(enableStdout);
+	if (ret != ESP_OK) return ret;
+	logging_set_vprintf();
+	return ESP_OK;
+}
+
+// The host build has a stand-in for the MQTT client
+#if !CONFIG_IDF_TARGET_LINUX || CONFIG_ENABLE_MQTT_LOG
 void mqtt_pub(void *pvParameters);
 
 esp_err_t mqtt_logging_init(char *url, char *topic, int16_t enableStdout) {
 
-#if CONFIG_USE_RINGBUFFER
-	printf("start mqtt logging(xRingBuffer): url=[%s] topic=[%s]\n", url, topic);
-	// Create RineBuffer
-	xRingBufferTrans = xRingbufferCreate(xBufferSizeBytes, RINGBUF_TYPE_NOSPLIT);
-	configASSERT( xRingBufferTrans );
-#else
-	printf("start mqtt logging(xMessageBuffer): url=[%s] topic=[%s]\n", url, topic);
-	// Create MessageBuffer
-	xMessageBufferTrans = xMessageBufferCreate(xBufferSizeBytes);
-	configASSERT( xMessageBufferTrans );
-#endif
-
-	// Start MQTT task
-	PARAMETER_t param;
-	strcpy(param.url, url);
-	strcpy(param.topic, topic);
-	param.taskHandle = xTaskGetCurrentTaskHandle();
-	xTaskCreate(mqtt_pub, "MQTT", 1024*6, (void *)&param, 2, NULL);
+	printf("start mqtt logging(" IPC_NAME "): url=[%s] topic=[%s]\n", url, topic);
+	esp_err_t ret = logging_start();
+	if (ret != ESP_OK) return ret;
 
-	// Wait for ready to receive notify
-	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-	//printf("ulTaskNotifyTake\n");
+	// Start MQTT task, it connects in the background
+	PARAMETER_t *param = logging_parameter("MQTT", false);
+	if (param == NULL) return ESP_ERR_NO_MEM;
+	strcpy(param->url, url);
+	strcpy(param->topic, topic);
+	ret = logging_task(mqtt_pub, "MQTT", 1024*6, 2, param);
+	if (ret != ESP_OK) return ret;
 
 	// Set function used to output log entries.
-	writeToStdout = enableStdout;
-	esp_log_set_vprintf(logging_vprintf);
+	ret = logging_stdout(enableStdout);
+	if (ret != ESP_OK) return ret;
+	logging_set_vprintf();
 	return ESP_OK;
 }
+#endif
 
+#if !CONFIG_IDF_TARGET_LINUX
 void http_client(void *pvParameters);
 
 esp_err_t http_logging_init(char *url, int16_t enableStdout) {
 
-#if CONFIG_USE_RINGBUFFER
-	printf("start http logging(xRingBuffer): url=[%s]\n", url);
-	// Create RineBuffer
-	xRingBufferTrans = xRingbufferCreate(xBufferSizeBytes, RINGBUF_TYPE_NOSPLIT);
-	configASSERT( xRingBufferTrans );
-#else
-	printf("start http logging(xMessageBuffer): url=[%s]\n", url);
-	// Create MessageBuffer
-	xMessageBufferTrans = xMessageBufferCreate(xBufferSizeBytes);
-	configASSERT( xMessageBufferTrans );
-#endif
-
-	// Start HTTP task
-	PARAMETER_t param;
-	strcpy(param.url, url);
-	param.taskHandle = xTaskGetCurrentTaskHandle();
-	xTaskCreate(http_client, "HTTP", 1024*4, (void *)&param, 2, NULL);
+	printf("start http logging(" IPC_NAME "): url=[%s]\n", url);
+	esp_err_t ret = logging_start();
+	if (ret != ESP_OK) return ret;
 
-	// Wait for ready to receive notify
-	ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-	//printf("ulTaskNotifyTake\n");
+	// Start HTTP task, it connects in the background
+	PARAMETER_t *param = logging_parameter("HTTP", false);
+	if (param == NULL) return ESP_ERR_NO_MEM;
+	strcpy(param->url, url);
+	ret = logging_task(http_client, "HTTP", 1024*4, 2, param);
+	if (ret != ESP_OK) return ret;
 
 	// Set function used to output log entries.
-	writeToStdout = enableStdout;
-	esp_log_set_vprintf(logging_vprintf);
+	ret = logging_stdout(enableStdout);
+	if (ret != ESP_OK) return ret;
+	logging_set_vprintf();
 	return ESP_OK;
 }
+#endif // !CONFIG_IDF_TARGET_LINUX
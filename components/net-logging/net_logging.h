@@ -5,28 +5,108 @@
 extern "C" {
 #endif
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_event.h"
 
 typedef struct {
 	uint16_t port;
 	char ipv4[20]; // xxx.xxx.xxx.xxx
 	char url[64]; // mqtt://iot.eclipse.org
 	char topic[64];
-	TaskHandle_t taskHandle;
+	struct SINK *sink;
 } PARAMETER_t;
 
-// The total number of bytes (not messages) the message buffer will be able to hold at any one time.
-#define xBufferSizeBytes 1024
+// Connection status of the senders, posted to the default event loop
+ESP_EVENT_DECLARE_BASE(NET_LOGGING_EVENT);
+
+typedef enum {
+	NET_LOGGING_EVENT_CONNECTED, // The sender delivers records
+	NET_LOGGING_EVENT_DISCONNECTED, // The sender lost the connection, records are kept in the buffer
+} NET_LOGGING_EVENT_t;
+
+typedef struct {
+	char sink[8]; // "UDP", "TCP", "MQTT" or "HTTP"
+} NET_LOGGING_EVENT_DATA_t;
+
+// The default number of bytes (not messages) the message buffer will be able to hold at any one time.
+#define xBufferSizeBytes CONFIG_NET_LOGGING_BUFFER_SIZE
 // The size, in bytes, required to hold each item in the message,
-#define xItemSize 256
+#define xItemSize CONFIG_NET_LOGGING_ITEM_SIZE
 
+typedef struct {
+	size_t buffer_size; // The total number of bytes the buffer will be able to hold
+	uint32_t buffer_caps; // Memory capabilities of the buffer storage (MALLOC_CAP_xxx)
+} NET_LOGGING_CONFIG_t;
+
+#if CONFIG_NET_LOGGING_BUFFER_IN_PSRAM
+#define NET_LOGGING_BUFFER_CAPS (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#else
+#define NET_LOGGING_BUFFER_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+
+#define NET_LOGGING_CONFIG_DEFAULT() { \
+	.buffer_size = xBufferSizeBytes, \
+	.buffer_caps = NET_LOGGING_BUFFER_CAPS, \
+}
+
+
+// Records and bytes dropped because the buffer was full, indexed by esp_log_level_t.
+// ESP_LOG_NONE counts records without a level prefix.
+typedef struct {
+	uint32_t records[ESP_LOG_VERBOSE+1];
+	uint32_t bytes[ESP_LOG_VERBOSE+1];
+} NET_LOGGING_DROPPED_t;
+
+// Statistics of the component, counters wrap around.
+#define NET_LOGGING_SINK_MAX 8
+#define NET_LOGGING_LATENCY_BUCKETS 16
+
+typedef struct {
+	char name[8]; // "STDOUT", "UDP", "TCP", "MQTT" or "HTTP"
+	uint32_t bytes; // Bytes sent, after batching and compression
+	uint32_t packets; // Datagrams, sends, publishes or posts
+	uint32_t errors; // Failed sends
+	uint32_t lost; // Records overwritten in the fan-out ring before the sender read them, or dropped by the sender
+	uint32_t backlog_high_water; // Most bytes waiting in the fan-out ring for this sender
+	// Time from the fan-out ring to the network, of the oldest record in each packet.
+	// Bucket 0 counts less than 1 ms, bucket n counts 2^(n-1) to 2^n-1 ms (1 ms, 2-3 ms, 4-7 ms and so on),
+	// the last bucket also counts longer times.
+	uint32_t latency[NET_LOGGING_LATENCY_BUCKETS];
+} NET_LOGGING_SINK_STATS_t;
+
+typedef struct {
+	uint32_t enqueued; // Records written into the buffer
+	uint32_t dispatched; // Records moved from the buffer to the fan-out ring
+	uint32_t dropped; // Records dropped because the buffer was full
+	uint32_t suppressed; // Records over the rate limit of their tag
+	uint32_t buffer_size;
+	uint32_t buffer_high_water; // Most bytes in the buffer seen by the dispatcher
+	uint32_t vprintf_calls;
+	uint32_t vprintf_time_us; // Time callers spent in logging_vprintf
+	uint32_t vprintf_max_us;
+	int sink_count;
+	NET_LOGGING_SINK_STATS_t sinks[NET_LOGGING_SINK_MAX];
+} NET_LOGGING_STATS_t;
 
+esp_err_t net_logging_configure(const NET_LOGGING_CONFIG_t *config);
+esp_err_t net_logging_early_init(int16_t enableStdout);
 int logging_vprintf( const char *fmt, va_list l );
 esp_err_t udp_logging_init(char *ipaddr, unsigned long port, int16_t enableStdout);
 esp_err_t tcp_logging_init(char *ipaddr, unsigned long port, int16_t enableStdout);
 esp_err_t mqtt_logging_init(char *url, char *topic, int16_t enableStdout);
 esp_err_t http_logging_init(char *url, int16_t enableStdout);
+void net_logging_get_dropped(NET_LOGGING_DROPPED_t *result);
+void net_logging_get_stats(NET_LOGGING_STATS_t *result);
+// Network side filter, tag "*" is the default level
+esp_err_t net_logging_set_level(const char *tag, esp_log_level_t level);
+esp_err_t net_logging_reset_level(const char *tag);
+esp_err_t net_logging_control(const char *command, size_t length);
+// Records per second and burst per tag and level, tag "*" for all tags, ESP_LOG_NONE for all levels but errors, rate 0 for no limit
+esp_err_t net_logging_set_rate(const char *tag, esp_log_level_t level, uint16_t rate, uint16_t burst);
 
 #ifdef __cplusplus
 }
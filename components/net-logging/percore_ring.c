@@ -0,0 +1,225 @@
+/*
+	Per-core SPSC log rings
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "percore_ring.h"
+
+#define RECORD_RESERVED 0
+#define RECORD_COMMITTED 1
+#define RECORD_PADDING 2 // Skip to the start of the storage
+
+// Records are contiguous and 4-byte aligned, so they are read and written in place
+typedef struct {
+	uint16_t length; // Length of the data
+	uint16_t state;
+	uint32_t timestamp; // lower 32 bits of esp_timer_get_time()
+	uint32_t span; // Bytes from this header to the next header
+} RING_HEADER_t;
+
+typedef struct {
+	uint8_t *storage;
+	size_t size;
+	// Offsets run from 0 to 2*size-1, so a full ring and an empty ring differ and any size works
+	uint32_t head; // Next free byte, advanced by reserve and moved back by commit
+	uint32_t tail; // Only written by the sender task
+	portMUX_TYPE lock;
+} PERCORE_RING_t;
+
+static PERCORE_RING_t rings[portNUM_PROCESSORS];
+
+#define ALIGN4(x) (((x) + 3) & ~3)
+
+static uint32_t ring_index(PERCORE_RING_t *ring, uint32_t offset)
+{
+	return (offset < ring->size) ? offset : offset - ring->size;
+}
+
+// Offset plus a length of at most the size of the ring
+static uint32_t ring_advance(PERCORE_RING_t *ring, uint32_t offset, uint32_t length)
+{
+	offset += length;
+	if (offset >= 2 * ring->size) offset -= 2 * ring->size;
+	return offset;
+}
+
+// Bytes from one offset to a later one
+static uint32_t ring_distance(PERCORE_RING_t *ring, uint32_t from, uint32_t to)
+{
+	return (to >= from) ? to - from : to + 2 * ring->size - from;
+}
+
+static RING_HEADER_t *ring_header(PERCORE_RING_t *ring, uint32_t offset)
+{
+	return (RING_HEADER_t *)(ring->storage + ring_index(ring, offset));
+}
+
+bool percore_ring_create(size_t xBufferSizeBytesPerCore, uint32_t caps)
+{
+	for (int core=0; core<portNUM_PROCESSORS; core++) {
+		size_t size = xBufferSizeBytesPerCore & ~3;
+		rings[core].storage = heap_caps_malloc(size, caps);
+		if (rings[core].storage == NULL) {
+			printf("percore_ring_create fail core=%d\n", core);
+			return false;
+		}
+		rings[core].size = size;
+		rings[core].head = 0;
+		rings[core].tail = 0;
+		portMUX_INITIALIZE(&rings[core].lock);
+	}
+	return true;
+}
+
+void *percore_ring_reserve(size_t length, PERCORE_RING_RESERVATION_t *reservation)
+{
+	void *data = NULL;
+	if (length > UINT16_MAX) return NULL;
+	uint32_t required = ALIGN4(sizeof(RING_HEADER_t) + length);
+
+	// The lock only covers moving head, the caller fills the record without holding it.
+	// A spinlock instead of masking interrupts keeps the ring consistent if the caller moves to another core before committing.
+	int core = xPortGetCoreID();
+	PERCORE_RING_t *ring = &rings[core];
+	if (ring->storage == NULL) return NULL;
+	portENTER_CRITICAL_SAFE(&ring->lock);
+	uint32_t head = ring->head;
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	uint32_t padding = 0;
+	uint32_t index = ring_index(ring, head);
+	// A record never wraps, the rest of the storage is skipped instead
+	if (ring->size - index < required) padding = ring->size - index;
+	if (ring->size - ring_distance(ring, tail, head) >= padding + required) {
+		if (padding) {
+			RING_HEADER_t *pad = ring_header(ring, head);
+			pad->length = 0;
+			pad->span = padding;
+			__atomic_store_n(&pad->state, RECORD_PADDING, __ATOMIC_RELEASE);
+			head = ring_advance(ring, head, padding);
+		}
+		RING_HEADER_t *header = ring_header(ring, head);
+		header->length = 0;
+		header->timestamp = (uint32_t)esp_timer_get_time();
+		header->span = required;
+		__atomic_store_n(&header->state, RECORD_RESERVED, __ATOMIC_RELEASE);
+		__atomic_store_n(&ring->head, ring_advance(ring, head, required), __ATOMIC_RELEASE);
+		reservation->core = core;
+		reservation->offset = head;
+		data = header + 1;
+	}
+	portEXIT_CRITICAL_SAFE(&ring->lock);
+	return data;
+}
+
+void percore_ring_commit(PERCORE_RING_RESERVATION_t *reservation, size_t length)
+{
+	PERCORE_RING_t *ring = &rings[reservation->core];
+	portENTER_CRITICAL_SAFE(&ring->lock);
+	RING_HEADER_t *header = ring_header(ring, reservation->offset);
+	if (length > header->span - sizeof(RING_HEADER_t)) length = header->span - sizeof(RING_HEADER_t);
+	header->length = length;
+	// Give back the unused part if nobody reserved after this record
+	uint32_t used = ALIGN4(sizeof(RING_HEADER_t) + length);
+	if (ring->head == ring_advance(ring, reservation->offset, header->span)) {
+		header->span = used;
+		__atomic_store_n(&ring->head, ring_advance(ring, reservation->offset, used), __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&header->state, RECORD_COMMITTED, __ATOMIC_RELEASE);
+	portEXIT_CRITICAL_SAFE(&ring->lock);
+}
+
+bool percore_ring_send(const void *data, size_t length)
+{
+	PERCORE_RING_RESERVATION_t reservation;
+	void *record = percore_ring_reserve(length, &reservation);
+	if (record == NULL) return false;
+	memcpy(record, data, length);
+	percore_ring_commit(&reservation, length);
+	return true;
+}
+
+const void *percore_ring_acquire(size_t *length, TickType_t xTicksToWait)
+{
+	TickType_t start = xTaskGetTickCount();
+	while(1) {
+		// k-way merge: pick the oldest committed head record across all cores
+		int oldest = -1;
+		RING_HEADER_t *oldest_header = NULL;
+		for (int core=0; core<portNUM_PROCESSORS; core++) {
+			PERCORE_RING_t *ring = &rings[core];
+			if (ring->storage == NULL) continue;
+			while (ring->tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+				RING_HEADER_t *header = ring_header(ring, ring->tail);
+				uint16_t state = __atomic_load_n(&header->state, __ATOMIC_ACQUIRE);
+				if (state == RECORD_PADDING) {
+					__atomic_store_n(&ring->tail, ring_advance(ring, ring->tail, header->span), __ATOMIC_RELEASE);
+					continue;
+				}
+				// A record that is still being written blocks only its own core
+				if (state == RECORD_COMMITTED) {
+					if (oldest < 0 || (int32_t)(header->timestamp - oldest_header->timestamp) < 0) {
+						oldest = core;
+						oldest_header = header;
+					}
+				}
+				break;
+			}
+		}
+
+		if (oldest >= 0) {
+			*length = oldest_header->length;
+			return oldest_header + 1;
+		}
+
+		// The producers never block or notify, so the sender polls once per tick while idle.
+		if (xTaskGetTickCount() - start >= xTicksToWait) return NULL;
+		vTaskDelay(1);
+	}
+}
+
+void percore_ring_release(const void *data)
+{
+	const RING_HEADER_t *header = (const RING_HEADER_t *)data - 1;
+	for (int core=0; core<portNUM_PROCESSORS; core++) {
+		PERCORE_RING_t *ring = &rings[core];
+		if ((const uint8_t *)header == ring->storage + ring_index(ring, ring->tail)) {
+			__atomic_store_n(&ring->tail, ring_advance(ring, ring->tail, header->span), __ATOMIC_RELEASE);
+			return;
+		}
+	}
+}
+
+size_t percore_ring_receive(void *buffer, size_t size, TickType_t xTicksToWait)
+{
+	size_t received = 0;
+	const void *data = percore_ring_acquire(&received, xTicksToWait);
+	if (data == NULL) return 0;
+	if (received > size) received = size;
+	memcpy(buffer, data, received);
+	percore_ring_release(data);
+	return received;
+}
+
+// Bytes in all rings including headers and padding, only exact for the consumer
+size_t percore_ring_used(void)
+{
+	size_t used = 0;
+	for (int core=0; core<portNUM_PROCESSORS; core++) {
+		PERCORE_RING_t *ring = &rings[core];
+		used += ring_distance(ring, ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE));
+	}
+	return used;
+}
@@ -0,0 +1,35 @@
+#ifndef PERCORE_RING_H_
+#define PERCORE_RING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// One ring per core.
+// Producers reserve space in the ring of their own core, fill it in place and commit it.
+// Reservations only take a per-ring spinlock, so callers on different cores never contend.
+// The consumer side merges all rings in timestamp order and reads records in place.
+typedef struct {
+	int core;
+	uint32_t offset;
+} PERCORE_RING_RESERVATION_t;
+
+bool percore_ring_create(size_t xBufferSizeBytesPerCore, uint32_t caps);
+void *percore_ring_reserve(size_t length, PERCORE_RING_RESERVATION_t *reservation);
+void percore_ring_commit(PERCORE_RING_RESERVATION_t *reservation, size_t length);
+bool percore_ring_send(const void *data, size_t length);
+const void *percore_ring_acquire(size_t *length, TickType_t xTicksToWait);
+void percore_ring_release(const void *data);
+size_t percore_ring_receive(void *buffer, size_t size, TickType_t xTicksToWait);
+size_t percore_ring_used(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERCORE_RING_H_ */
@@ -0,0 +1,194 @@
+/*
+	Rate limit per tag and level
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#include "net_logging.h"
+#include "log_filter.h"
+#include "rate_limit.h"
+
+#if CONFIG_NET_LOGGING_RATE_LIMIT
+#define TABLE_SIZE CONFIG_NET_LOGGING_RATE_LIMIT_TAGS
+// The tag hash leaves the low bits free for the level
+#define KEY_LEVEL_MASK 0x07
+// Rate in the high half of a limit, burst in the low half, so both are read at once
+#define LIMIT(rate, burst) (((uint32_t)(rate) << 16) | (burst))
+#define LIMIT_RATE(limit) ((limit) >> 16)
+#define LIMIT_BURST(limit) ((limit) & 0xffff)
+// Longest burst in microseconds, so that the time differences stay in an int32_t
+#define TOLERANCE_MAX_US (1U << 30)
+// A summary is sent once per second while a tag is suppressed
+#define REPORT_MS 1000
+
+// Each bucket is updated with atomics only, so logging tasks on both cores never wait for each other.
+// The bucket is kept as the time at which it is full again (GCRA): each record moves it
+// 1/rate seconds later, and a record is suppressed when it is more than burst records ahead.
+typedef struct {
+	uint32_t key; // Tag hash with the level in the low bits, 0 is empty
+	bool ready; // The tag has been copied
+	bool configured; // Set with net_logging_set_rate, otherwise the default of the level applies
+	uint32_t limit;
+	uint32_t full_us; // Time at which the bucket is full again, in microseconds of esp_log_timestamp()
+	uint32_t suppressed; // Records suppressed since the last summary
+	uint32_t suppressed_since;
+	char tag[16];
+} BUCKET_t;
+
+static BUCKET_t table[TABLE_SIZE];
+// Errors are not limited unless a rate is set for them
+static uint32_t default_limit[ESP_LOG_VERBOSE+1] = {
+	[ESP_LOG_WARN] = LIMIT(CONFIG_NET_LOGGING_RATE_LIMIT_RATE, CONFIG_NET_LOGGING_RATE_LIMIT_BURST),
+	[ESP_LOG_INFO] = LIMIT(CONFIG_NET_LOGGING_RATE_LIMIT_RATE, CONFIG_NET_LOGGING_RATE_LIMIT_BURST),
+	[ESP_LOG_DEBUG] = LIMIT(CONFIG_NET_LOGGING_RATE_LIMIT_RATE, CONFIG_NET_LOGGING_RATE_LIMIT_BURST),
+	[ESP_LOG_VERBOSE] = LIMIT(CONFIG_NET_LOGGING_RATE_LIMIT_RATE, CONFIG_NET_LOGGING_RATE_LIMIT_BURST),
+};
+static uint32_t suppressed_total;
+
+static const char level_letter[] = "NEWIDV";
+
+// Returns the bucket of the key, inserted if it is new, or NULL if the table is full
+static BUCKET_t *bucket_find(uint32_t key, const char *tag, uint32_t now_us)
+{
+	for (int i=0;i<TABLE_SIZE;i++) {
+		BUCKET_t *bucket = &table[(key / (KEY_LEVEL_MASK + 1) + i) % TABLE_SIZE];
+		uint32_t found = __atomic_load_n(&bucket->key, __ATOMIC_ACQUIRE);
+		if (found == key) return bucket;
+		if (found != 0) continue;
+		// Another task may take the slot first, for the same tag or another one
+		if (__atomic_compare_exchange_n(&bucket->key, &found, key, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) == false) {
+			if (found == key) return bucket;
+			continue;
+		}
+		strncpy(bucket->tag, tag, sizeof(bucket->tag) - 1);
+		bucket->tag[sizeof(bucket->tag) - 1] = 0;
+		__atomic_store_n(&bucket->full_us, now_us, __ATOMIC_RELAXED);
+		__atomic_store_n(&bucket->ready, true, __ATOMIC_RELEASE);
+		return bucket;
+	}
+	return NULL;
+}
+
+// Take one record from the bucket, false when it is empty
+static bool bucket_take(BUCKET_t *bucket, uint32_t limit, uint32_t now_us)
+{
+	uint32_t interval = 1000000 / LIMIT_RATE(limit);
+	uint32_t tolerance = LIMIT_BURST(limit) * (uint64_t)interval;
+	if (tolerance > TOLERANCE_MAX_US) tolerance = TOLERANCE_MAX_US;
+	uint32_t full_us = __atomic_load_n(&bucket->full_us, __ATOMIC_RELAXED);
+	while (1) {
+		int32_t ahead = full_us - now_us;
+		// A full bucket, or one that was idle so long that its time wrapped
+		if (ahead < 0 || ahead > (int32_t)(tolerance + interval)) ahead = 0;
+		if (ahead + interval > tolerance) return false;
+		if (__atomic_compare_exchange_n(&bucket->full_us, &full_us, now_us + ahead + interval, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return true;
+	}
+}
+
+bool rate_limit_pass(const char *fmt, va_list l)
+{
+	esp_log_level_t level;
+	const char *tag;
+	// Records without a tag are never limited
+	if (log_filter_parse(fmt, l, &level, &tag) == false || tag == NULL) return true;
+	uint32_t key = log_filter_tag_hash(tag) | level;
+	uint32_t now = esp_log_timestamp();
+	BUCKET_t *bucket = bucket_find(key, tag, now * 1000);
+	// Tags that do not fit into the table are not limited
+	if (bucket == NULL) return true;
+	uint32_t limit = __atomic_load_n(&bucket->configured, __ATOMIC_ACQUIRE) ?
+		__atomic_load_n(&bucket->limit, __ATOMIC_RELAXED) : __atomic_load_n(&default_limit[level], __ATOMIC_RELAXED);
+	if (LIMIT_RATE(limit) == 0) return true;
+	if (bucket_take(bucket, limit, now * 1000)) return true;
+	if (__atomic_fetch_add(&bucket->suppressed, 1, __ATOMIC_RELAXED) == 0) {
+		__atomic_store_n(&bucket->suppressed_since, now, __ATOMIC_RELAXED);
+	}
+	__atomic_fetch_add(&suppressed_total, 1, __ATOMIC_RELAXED);
+	return false;
+}
+
+// Summary of one suppressed tag, 0 if there is nothing to report yet.
+// Called by the dispatcher only.
+int rate_limit_report(char *out, size_t size)
+{
+	static uint32_t next_report;
+	uint32_t now = esp_log_timestamp();
+	// The table is scanned once per poll interval, not for every record
+	if ((int32_t)(now - next_report) < 0) return 0;
+	for (int i=0;i<TABLE_SIZE;i++) {
+		BUCKET_t *bucket = &table[i];
+		if (__atomic_load_n(&bucket->ready, __ATOMIC_ACQUIRE) == false) continue;
+		if (__atomic_load_n(&bucket->suppressed, __ATOMIC_RELAXED) == 0) continue;
+		uint32_t elapsed = now - __atomic_load_n(&bucket->suppressed_since, __ATOMIC_RELAXED);
+		if (elapsed < REPORT_MS) continue;
+		uint32_t suppressed = __atomic_exchange_n(&bucket->suppressed, 0, __ATOMIC_RELAXED);
+		esp_log_level_t level = bucket->key & KEY_LEVEL_MASK;
+		return snprintf(out, size, LOG_COLOR_W "W (%"PRIu32") net_logging: tag %s level %c suppressed %"PRIu32" lines in %"PRIu32" ms" LOG_RESET_COLOR "\n",
+			now, bucket->tag, level_letter[level], suppressed, elapsed);
+	}
+	next_report = now + RATE_LIMIT_POLL_MS;
+	return 0;
+}
+
+uint32_t rate_limit_suppressed(void)
+{
+	return __atomic_load_n(&suppressed_total, __ATOMIC_RELAXED);
+}
+
+esp_err_t net_logging_set_rate(const char *tag, esp_log_level_t level, uint16_t rate, uint16_t burst)
+{
+	if (tag == NULL || level > ESP_LOG_VERBOSE) return ESP_ERR_INVALID_ARG;
+	// A bucket smaller than one record would never pass
+	if (rate && burst == 0) burst = 1;
+	esp_err_t ret = ESP_OK;
+	uint32_t now_us = esp_log_timestamp() * 1000;
+	uint32_t hash = (strcmp(tag, "*") == 0) ? 0 : log_filter_tag_hash(tag);
+	// ESP_LOG_NONE sets all levels but errors, which are only limited when set on their own
+	for (int i=ESP_LOG_ERROR; i<=ESP_LOG_VERBOSE; i++) {
+		if (level != i && (level != ESP_LOG_NONE || i == ESP_LOG_ERROR)) continue;
+		if (hash == 0) {
+			// Tags without their own setting follow the default on their next record
+			__atomic_store_n(&default_limit[i], LIMIT(rate, burst), __ATOMIC_RELAXED);
+			continue;
+		}
+		BUCKET_t *bucket = bucket_find(hash | i, tag, now_us);
+		if (bucket == NULL) {
+			ret = ESP_ERR_NO_MEM;
+			continue;
+		}
+		__atomic_store_n(&bucket->limit, LIMIT(rate, burst), __ATOMIC_RELAXED);
+		__atomic_store_n(&bucket->configured, true, __ATOMIC_RELEASE);
+	}
+	return ret;
+}
+#else
+bool rate_limit_pass(const char *fmt, va_list l)
+{
+	return true;
+}
+
+int rate_limit_report(char *out, size_t size)
+{
+	return 0;
+}
+
+uint32_t rate_limit_suppressed(void)
+{
+	return 0;
+}
+
+esp_err_t net_logging_set_rate(const char *tag, esp_log_level_t level, uint16_t rate, uint16_t burst)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
@@ -0,0 +1,29 @@
+#ifndef RATE_LIMIT_H_
+#define RATE_LIMIT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Token bucket per tag and level, checked before the record is formatted.
+// A bucket holds up to burst records and is refilled with rate records per second.
+// Records of an empty bucket are counted and summarized by rate_limit_report,
+// which the dispatcher calls at least every RATE_LIMIT_POLL_MS.
+// Errors are only limited when a rate is set for them.
+
+#define RATE_LIMIT_POLL_MS 250
+
+bool rate_limit_pass(const char *fmt, va_list l);
+int rate_limit_report(char *out, size_t size);
+uint32_t rate_limit_suppressed(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RATE_LIMIT_H_ */
@@ -0,0 +1,339 @@
+/*
+	Sink registry and fan-out ring
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "net_logging.h"
+#include "sink.h"
+#include "frame.h"
+#if CONFIG_DEFERRED_FORMAT_ON_HOST
+#include "deferred_format.h"
+#endif
+#if CONFIG_COMPACT_FORMAT
+#include "compact_format.h"
+#endif
+
+#define SINK_MAX NET_LOGGING_SINK_MAX
+#define SINK_FLAG_EARLY 1 // Captured before the first transport was up
+
+typedef struct {
+	uint16_t length;
+	uint16_t flags;
+	uint32_t published; // esp_log_timestamp() when the record entered the ring
+} SINK_HEADER_t;
+
+struct SINK {
+	const char *name;
+	bool binary; // The sink accepts binary records
+	bool skip_early; // The records of the early capture are left out
+	uint32_t cursor; // Offset of the next record to read
+	uint32_t cursor_seq; // Sequence number of the next record to read
+	uint32_t lost; // Records overwritten before this sink read them, not reported yet
+	TaskHandle_t task;
+	bool waiting;
+	bool connected;
+	// Only written by the sender task
+	bool pending; // Records were received since the last send
+	uint32_t pending_since; // Publish time of the oldest of them
+	NET_LOGGING_SINK_STATS_t stats;
+};
+
+static struct {
+	uint8_t *storage;
+	size_t size;
+	// Offsets run from 0 to 2*size-1, so a full ring and an empty ring differ and any size works
+	uint32_t head; // Offset of the next record to write
+	uint32_t tail; // Offset of the oldest record
+	uint32_t head_seq;
+	uint32_t tail_seq;
+	int count;
+	struct SINK sinks[SINK_MAX];
+} fanout;
+
+ESP_EVENT_DEFINE_BASE(NET_LOGGING_EVENT);
+
+static portMUX_TYPE fanout_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Offset plus a length of at most the size of the ring
+static uint32_t fanout_advance(uint32_t offset, size_t length)
+{
+	offset += length;
+	if (offset >= 2 * fanout.size) offset -= 2 * fanout.size;
+	return offset;
+}
+
+// Bytes from one offset to a later one
+static uint32_t fanout_distance(uint32_t from, uint32_t to)
+{
+	return (to >= from) ? to - from : to + 2 * fanout.size - from;
+}
+
+static void fanout_copy_in(uint32_t offset, const void *data, size_t length)
+{
+	size_t index = (offset < fanout.size) ? offset : offset - fanout.size;
+	size_t first = fanout.size - index;
+	if (first > length) first = length;
+	memcpy(fanout.storage + index, data, first);
+	memcpy(fanout.storage, (const uint8_t *)data + first, length - first);
+}
+
+static void fanout_copy_out(uint32_t offset, void *data, size_t length)
+{
+	size_t index = (offset < fanout.size) ? offset : offset - fanout.size;
+	size_t first = fanout.size - index;
+	if (first > length) first = length;
+	memcpy(data, fanout.storage + index, first);
+	memcpy((uint8_t *)data + first, fanout.storage, length - first);
+}
+
+esp_err_t sink_create(size_t buffer_size, uint32_t caps)
+{
+	fanout.storage = heap_caps_malloc(buffer_size, caps);
+	if (fanout.storage == NULL) return ESP_ERR_NO_MEM;
+	fanout.size = buffer_size;
+	fanout.head = fanout.tail = 0;
+	fanout.head_seq = fanout.tail_seq = 0;
+	fanout.count = 0;
+	return ESP_OK;
+}
+
+SINK_t *sink_register(const char *name, bool binary)
+{
+	SINK_t *sink = NULL;
+	portENTER_CRITICAL(&fanout_lock);
+	if (fanout.count < SINK_MAX) {
+		sink = &fanout.sinks[fanout.count++];
+		sink->name = name;
+		sink->binary = binary;
+		sink->skip_early = false;
+		// A new sink starts with the records that are still in the ring
+		sink->cursor = fanout.tail;
+		sink->cursor_seq = fanout.tail_seq;
+		sink->lost = 0;
+		sink->task = NULL;
+		sink->waiting = false;
+		sink->connected = false;
+		sink->pending = false;
+		memset(&sink->stats, 0, sizeof(sink->stats));
+	}
+	portEXIT_CRITICAL(&fanout_lock);
+	return sink;
+}
+
+// Called only from the dispatcher task
+static void fanout_publish(const char *data, size_t length, uint16_t flags)
+{
+	size_t required = sizeof(SINK_HEADER_t) + length;
+	if (length == 0 || length > UINT16_MAX || required > fanout.size) return;
+
+	TaskHandle_t waiting[SINK_MAX];
+	int waiting_count = 0;
+	portENTER_CRITICAL(&fanout_lock);
+	// Overwrite the oldest records, sinks that have not read them yet lose them
+	while (fanout.size - fanout_distance(fanout.tail, fanout.head) < required) {
+		SINK_HEADER_t header;
+		fanout_copy_out(fanout.tail, &header, sizeof(header));
+		fanout.tail = fanout_advance(fanout.tail, sizeof(header) + header.length);
+		fanout.tail_seq++;
+	}
+	SINK_HEADER_t header;
+	header.length = length;
+	header.flags = flags;
+	header.published = esp_log_timestamp();
+	fanout_copy_in(fanout.head, &header, sizeof(header));
+	fanout_copy_in(fanout_advance(fanout.head, sizeof(header)), data, length);
+	fanout.head = fanout_advance(fanout.head, required);
+	fanout.head_seq++;
+	for (int i=0;i<fanout.count;i++) {
+		if (fanout.sinks[i].waiting) {
+			fanout.sinks[i].waiting = false;
+			waiting[waiting_count++] = fanout.sinks[i].task;
+		}
+	}
+	portEXIT_CRITICAL(&fanout_lock);
+
+	for (int i=0;i<waiting_count;i++) {
+		xTaskNotifyGive(waiting[i]);
+	}
+}
+
+void sink_publish(const char *data, size_t length)
+{
+	fanout_publish(data, length, 0);
+}
+
+void sink_publish_early(const char *data, size_t length)
+{
+	fanout_publish(data, length, SINK_FLAG_EARLY);
+}
+
+// Post a status event when the connection of the sender changes
+void sink_set_connected(SINK_t *sink, bool connected)
+{
+	if (sink->connected == connected) return;
+	sink->connected = connected;
+	NET_LOGGING_EVENT_DATA_t data;
+	memset(&data, 0, sizeof(data));
+	strncpy(data.sink, sink->name, sizeof(data.sink) - 1);
+	// Fails without a default event loop, the status is only informative
+	esp_event_post(NET_LOGGING_EVENT, connected ? NET_LOGGING_EVENT_CONNECTED : NET_LOGGING_EVENT_DISCONNECTED, &data, sizeof(data), 0);
+}
+
+// Start reading with the next record that is published
+void sink_skip(SINK_t *sink)
+{
+	portENTER_CRITICAL(&fanout_lock);
+	sink->cursor = fanout.head;
+	sink->cursor_seq = fanout.head_seq;
+	portEXIT_CRITICAL(&fanout_lock);
+}
+
+// Leave out the records of the early capture, for a sink that has shown them already
+void sink_skip_early(SINK_t *sink)
+{
+	portENTER_CRITICAL(&fanout_lock);
+	sink->skip_early = true;
+	portEXIT_CRITICAL(&fanout_lock);
+}
+
+void sink_discard(SINK_t *sink, uint32_t records)
+{
+	portENTER_CRITICAL(&fanout_lock);
+	sink->lost += records;
+	portEXIT_CRITICAL(&fanout_lock);
+}
+
+size_t sink_receive(SINK_t *sink, char *buffer, size_t size, TickType_t xTicksToWait)
+{
+	TickType_t start = xTaskGetTickCount();
+	sink->task = xTaskGetCurrentTaskHandle();
+	while(1) {
+		size_t received = 0;
+		uint32_t lost = 0;
+		portENTER_CRITICAL(&fanout_lock);
+		if ((int32_t)(sink->cursor_seq - fanout.tail_seq) < 0) {
+			// This sink was overtaken by the writer
+			sink->lost += fanout.tail_seq - sink->cursor_seq;
+			sink->cursor = fanout.tail;
+			sink->cursor_seq = fanout.tail_seq;
+		}
+		SINK_HEADER_t header;
+		while (sink->skip_early && sink->cursor != fanout.head) {
+			fanout_copy_out(sink->cursor, &header, sizeof(header));
+			if ((header.flags & SINK_FLAG_EARLY) == 0) break;
+			sink->cursor = fanout_advance(sink->cursor, sizeof(header) + header.length);
+			sink->cursor_seq++;
+		}
+		if (sink->lost) {
+			lost = sink->lost;
+			sink->lost = 0;
+		} else if (sink->cursor != fanout.head) {
+			uint32_t backlog = fanout_distance(sink->cursor, fanout.head);
+			if (backlog > sink->stats.backlog_high_water) sink->stats.backlog_high_water = backlog;
+			fanout_copy_out(sink->cursor, &header, sizeof(header));
+			if (sink->pending == false) {
+				sink->pending = true;
+				sink->pending_since = header.published;
+			}
+			received = (header.length < size) ? header.length : size;
+			fanout_copy_out(fanout_advance(sink->cursor, sizeof(header)), buffer, received);
+			sink->cursor = fanout_advance(sink->cursor, sizeof(header) + header.length);
+			sink->cursor_seq++;
+		} else {
+			sink->waiting = true;
+		}
+		portEXIT_CRITICAL(&fanout_lock);
+
+		if (lost) {
+			sink->stats.lost += lost;
+			return snprintf(buffer, size, LOG_COLOR_W "W (%"PRIu32") net_logging: %s sink lost %"PRIu32" records" LOG_RESET_COLOR "\n",
+				esp_log_timestamp(), sink->name, lost);
+		}
+		if (received) {
+#if CONFIG_DEFERRED_FORMAT_ON_HOST
+			// Sinks that cannot carry binary records format them here
+			if (!sink->binary && deferred_format_is_record(buffer, received)) {
+				char record[xItemSize];
+				memcpy(record, buffer, received);
+				int text_len = deferred_format_unpack(buffer, size, record, received);
+				if (text_len <= 0) text_len = snprintf(buffer, size, "deferred record decode failed\n");
+				received = text_len;
+			}
+#endif
+			// Fragments of long records are sent as separate text records
+			if (!sink->binary && received > FRAGMENT_HEADER_SIZE && buffer[0] == FRAME_MARKER && buffer[1] == FRAME_TYPE_FRAGMENT) {
+				received -= FRAGMENT_HEADER_SIZE;
+				memmove(buffer, &buffer[FRAGMENT_HEADER_SIZE], received);
+			}
+#if CONFIG_COMPACT_FORMAT
+			// Parsed records are restored to text for sinks that send text
+			if (!sink->binary && compact_format_is_record(buffer, received)) {
+				char record[xItemSize];
+				memcpy(record, buffer, received);
+				int text_len = compact_format_unpack(buffer, size, record, received);
+				if (text_len <= 0) text_len = snprintf(buffer, size, "compact record decode failed\n");
+				received = text_len;
+			}
+#endif
+			return received;
+		}
+
+		TickType_t elapsed = xTaskGetTickCount() - start;
+		if (elapsed >= xTicksToWait) {
+			portENTER_CRITICAL(&fanout_lock);
+			sink->waiting = false;
+			portEXIT_CRITICAL(&fanout_lock);
+			return 0;
+		}
+		ulTaskNotifyTake(pdTRUE, (xTicksToWait == portMAX_DELAY) ? portMAX_DELAY : xTicksToWait - elapsed);
+	}
+}
+
+// Count one packet of the sender, the latency is measured from the oldest record in it
+void sink_sent(SINK_t *sink, size_t bytes, bool ok)
+{
+	if (ok == false) {
+		// Records that are sent again keep their publish time
+		sink->stats.errors++;
+		return;
+	}
+	sink->stats.bytes += bytes;
+	sink->stats.packets++;
+	if (sink->pending) {
+		uint32_t latency = esp_log_timestamp() - sink->pending_since;
+		int bucket = 0;
+		while (latency && bucket < NET_LOGGING_LATENCY_BUCKETS - 1) {
+			latency >>= 1;
+			bucket++;
+		}
+		sink->stats.latency[bucket]++;
+		sink->pending = false;
+	}
+}
+
+// Copy the counters of all sinks, returns the number of sinks
+int sink_get_stats(NET_LOGGING_SINK_STATS_t *stats, int max)
+{
+	int count = fanout.count;
+	if (count > max) count = max;
+	for (int i=0;i<count;i++) {
+		// Counters are read without the lock, each one is a single word
+		stats[i] = fanout.sinks[i].stats;
+		strncpy(stats[i].name, fanout.sinks[i].name, sizeof(stats[i].name) - 1);
+		stats[i].name[sizeof(stats[i].name) - 1] = 0;
+	}
+	return count;
+}
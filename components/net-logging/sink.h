@@ -0,0 +1,38 @@
+#ifndef SINK_H_
+#define SINK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "net_logging.h"
+
+// Every record is stored once in a shared fan-out ring.
+// Each sink reads it through its own cursor.
+// The ring never waits for a sink: a sink that falls behind loses its oldest records.
+typedef struct SINK SINK_t;
+
+esp_err_t sink_create(size_t buffer_size, uint32_t caps);
+SINK_t *sink_register(const char *name, bool binary);
+void sink_publish(const char *data, size_t length);
+// Records of the early capture, left out by sinks that called sink_skip_early
+void sink_publish_early(const char *data, size_t length);
+void sink_skip(SINK_t *sink);
+void sink_skip_early(SINK_t *sink);
+// Records the sender gave up on, reported like records lost in the ring
+void sink_discard(SINK_t *sink, uint32_t records);
+void sink_set_connected(SINK_t *sink, bool connected);
+size_t sink_receive(SINK_t *sink, char *buffer, size_t size, TickType_t xTicksToWait);
+void sink_sent(SINK_t *sink, size_t bytes, bool ok);
+int sink_get_stats(NET_LOGGING_SINK_STATS_t *stats, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SINK_H_ */
@@ -0,0 +1,274 @@
+/*
+	Slab pool of fixed-size record slots
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+
+#include "slab_pool.h"
+
+// Size of the smallest class and alignment of all slots
+#define SLAB_LINE 64
+#define SLAB_CLASS_MAX 8
+// Lines and pages are numbered with 16 bits, 0 marks the end of a free list
+#define SLAB_INDEX_MAX 0xfffe
+
+// Free list head: index + 1 in the low half, a counter against ABA in the high half
+typedef uint32_t SLAB_LIST_t;
+
+typedef struct {
+	size_t slot_size;
+	SLAB_LIST_t free; // Free slots, by the index of their first line
+} SLAB_CLASS_t;
+
+// Queue cell, the sequence tells whether the cell is free or filled for a position
+typedef struct {
+	uint32_t sequence;
+	uint16_t line;
+	uint16_t length;
+} SLAB_CELL_t;
+
+static SLAB_CLASS_t classes[SLAB_CLASS_MAX];
+static int class_count;
+static uint8_t *storage;
+static size_t page_size;
+static uint16_t page_count;
+static uint16_t lines_per_page;
+static SLAB_LIST_t free_pages;
+static uint16_t *next_page;
+static uint8_t *page_class; // Pages are given to a class on demand and go back when all their slots are free
+static uint16_t *page_used; // Slots of the page taken by a producer and not yet released
+static uint16_t *page_free; // Free slots of the page, counted by the consumer while it reclaims
+static uint16_t *next_line;
+static SLAB_CELL_t *cells;
+static uint32_t cell_mask;
+static uint32_t enqueue_pos;
+static uint32_t dequeue_pos; // Only written by the consumer
+static size_t used_bytes;
+
+static uint16_t list_pop(SLAB_LIST_t *list, uint16_t *next)
+{
+	SLAB_LIST_t head = __atomic_load_n(list, __ATOMIC_ACQUIRE);
+	while (1) {
+		uint16_t index = head & 0xffff;
+		if (index == 0) return 0;
+		// The counter changes on every update, so a head that was popped and pushed again does not match
+		SLAB_LIST_t new_head = (head & 0xffff0000) + 0x10000 + __atomic_load_n(&next[index - 1], __ATOMIC_RELAXED);
+		if (__atomic_compare_exchange_n(list, &head, new_head, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return index;
+	}
+}
+
+// Push a chain of entries that is already linked from first to last
+static void list_push(SLAB_LIST_t *list, uint16_t *next, uint16_t first, uint16_t last)
+{
+	SLAB_LIST_t head = __atomic_load_n(list, __ATOMIC_RELAXED);
+	while (1) {
+		__atomic_store_n(&next[last - 1], head & 0xffff, __ATOMIC_RELAXED);
+		SLAB_LIST_t new_head = (head & 0xffff0000) + 0x10000 + first;
+		if (__atomic_compare_exchange_n(list, &head, new_head, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return;
+	}
+}
+
+// Cut a free page into slots of the class
+static bool slab_carve(int class_index)
+{
+	uint16_t page = list_pop(&free_pages, next_page);
+	if (page == 0) return false;
+	page = page - 1;
+	SLAB_CLASS_t *class = &classes[class_index];
+	__atomic_store_n(&page_class[page], class_index, __ATOMIC_RELEASE);
+	uint16_t step = class->slot_size / SLAB_LINE;
+	uint16_t first = page * lines_per_page;
+	uint16_t last = first + lines_per_page - step;
+	for (uint16_t line=first; line<last; line+=step) next_line[line] = line + step + 1;
+	list_push(&class->free, next_line, first + 1, last + 1);
+	return true;
+}
+
+// Give the pages whose slots are all free back, so any class can carve them again.
+// The whole free list is taken while it is sorted, a slot in it can not be in use.
+static void slab_reclaim(int class_index)
+{
+	SLAB_CLASS_t *class = &classes[class_index];
+	uint16_t slots_per_page = page_size / class->slot_size;
+	SLAB_LIST_t head = __atomic_load_n(&class->free, __ATOMIC_ACQUIRE);
+	while (!__atomic_compare_exchange_n(&class->free, &head, (head & 0xffff0000) + 0x10000, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	uint16_t first = head & 0xffff;
+	if (first == 0) return;
+
+	memset(page_free, 0, page_count * sizeof(uint16_t));
+	for (uint16_t line=first; line; line=next_line[line - 1]) page_free[(line - 1) / lines_per_page]++;
+	uint16_t keep_first = 0;
+	uint16_t keep_last = 0;
+	for (uint16_t line=first; line; ) {
+		uint16_t next = next_line[line - 1];
+		uint16_t page = (line - 1) / lines_per_page;
+		if (page_free[page] == slots_per_page) {
+			// The other slots of the page are left out when they come
+			page_free[page] = 0;
+			list_push(&free_pages, next_page, page + 1, page + 1);
+		} else if (page_free[page] != 0) {
+			if (keep_last) next_line[keep_last - 1] = line;
+			else keep_first = line;
+			keep_last = line;
+		}
+		line = next;
+	}
+	if (keep_first) list_push(&class->free, next_line, keep_first, keep_last);
+}
+
+bool slab_pool_create(size_t xBufferSizeBytes, size_t max_length, uint32_t caps)
+{
+	// Classes double from one cache line until the longest record fits, a page holds one slot of the largest class
+	class_count = 0;
+	size_t slot_size = SLAB_LINE;
+	while (class_count < SLAB_CLASS_MAX) {
+		classes[class_count++].slot_size = slot_size;
+		if (slot_size >= max_length) break;
+		slot_size *= 2;
+	}
+	if (slot_size < max_length) return false;
+	page_size = slot_size;
+	lines_per_page = page_size / SLAB_LINE;
+	size_t pages = xBufferSizeBytes / page_size;
+	if (pages == 0) pages = 1;
+	if (pages > SLAB_INDEX_MAX / lines_per_page) pages = SLAB_INDEX_MAX / lines_per_page;
+	page_count = pages;
+	uint32_t lines = page_count * lines_per_page;
+	// One queue cell for every slot that can exist
+	uint32_t capacity = 1;
+	while (capacity < lines) capacity *= 2;
+
+	uint8_t *memory = heap_caps_malloc(page_count * page_size + SLAB_LINE - 1, caps);
+	next_page = heap_caps_malloc(page_count * sizeof(uint16_t), caps);
+	page_class = heap_caps_malloc(page_count, caps);
+	page_used = heap_caps_malloc(page_count * sizeof(uint16_t), caps);
+	page_free = heap_caps_malloc(page_count * sizeof(uint16_t), caps);
+	next_line = heap_caps_malloc(lines * sizeof(uint16_t), caps);
+	cells = heap_caps_malloc(capacity * sizeof(SLAB_CELL_t), caps);
+	if (memory == NULL || next_page == NULL || page_class == NULL || page_used == NULL || page_free == NULL || next_line == NULL || cells == NULL) {
+		printf("slab_pool_create fail size=%d\n", (int)(page_count * page_size));
+		return false;
+	}
+	storage = (uint8_t *)(((uintptr_t)memory + SLAB_LINE - 1) & ~(uintptr_t)(SLAB_LINE - 1));
+
+	for (uint16_t page=0; page<page_count; page++) {
+		next_page[page] = page + 2;
+		page_used[page] = 0;
+	}
+	free_pages = 0;
+	list_push(&free_pages, next_page, 1, page_count);
+	// Pages are carved as the classes need them
+	for (int i=0;i<class_count;i++) classes[i].free = 0;
+	for (uint32_t i=0;i<capacity;i++) cells[i].sequence = i;
+	cell_mask = capacity - 1;
+	enqueue_pos = 0;
+	dequeue_pos = 0;
+	used_bytes = 0;
+	printf("slab_pool pages=%d page_size=%d classes=%d\n", page_count, (int)page_size, class_count);
+	return true;
+}
+
+bool slab_pool_send(const void *data, size_t length)
+{
+	if (cells == NULL) return false;
+	// The smallest class that fits, a new page for it, or a larger class
+	int first_class = 0;
+	while (first_class < class_count && classes[first_class].slot_size < length) first_class++;
+	if (first_class == class_count) return false;
+	SLAB_CLASS_t *class = &classes[first_class];
+	uint16_t line = list_pop(&class->free, next_line);
+	while (line == 0 && slab_carve(first_class)) line = list_pop(&class->free, next_line);
+	for (int i=first_class+1; line == 0 && i<class_count; i++) {
+		class = &classes[i];
+		line = list_pop(&class->free, next_line);
+	}
+	if (line == 0) return false;
+	line = line - 1;
+	__atomic_fetch_add(&page_used[line / lines_per_page], 1, __ATOMIC_RELAXED);
+	memcpy(storage + line * SLAB_LINE, data, length);
+	__atomic_fetch_add(&used_bytes, class->slot_size, __ATOMIC_RELAXED);
+
+	// Claim the next queue position, there is always a cell for every slot
+	uint32_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+	SLAB_CELL_t *cell;
+	while (1) {
+		cell = &cells[pos & cell_mask];
+		int32_t diff = (int32_t)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+		} else {
+			pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+		}
+	}
+	cell->line = line;
+	cell->length = length;
+	__atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+const void *slab_pool_acquire(size_t *length, TickType_t xTicksToWait)
+{
+	TickType_t start = xTaskGetTickCount();
+	while(1) {
+		SLAB_CELL_t *cell = &cells[dequeue_pos & cell_mask];
+		// A record that is still being published holds back the later ones
+		if (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) == dequeue_pos + 1) {
+			uint16_t line = cell->line;
+			*length = cell->length;
+			// The cell is free again for the position one lap later
+			__atomic_store_n(&cell->sequence, dequeue_pos + cell_mask + 1, __ATOMIC_RELEASE);
+			dequeue_pos++;
+			return storage + line * SLAB_LINE;
+		}
+
+		// The producers never block or notify, so the sender polls once per tick while idle.
+		if (xTaskGetTickCount() - start >= xTicksToWait) return NULL;
+		vTaskDelay(1);
+	}
+}
+
+void slab_pool_release(const void *data)
+{
+	uint16_t line = ((const uint8_t *)data - storage) / SLAB_LINE;
+	uint16_t page = line / lines_per_page;
+	int class_index = __atomic_load_n(&page_class[page], __ATOMIC_ACQUIRE);
+	SLAB_CLASS_t *class = &classes[class_index];
+	__atomic_fetch_sub(&used_bytes, class->slot_size, __ATOMIC_RELAXED);
+	bool last = (__atomic_sub_fetch(&page_used[page], 1, __ATOMIC_RELAXED) == 0);
+	// A slot of the largest class is a whole page
+	if (class->slot_size == page_size) {
+		list_push(&free_pages, next_page, page + 1, page + 1);
+		return;
+	}
+	list_push(&class->free, next_line, line + 1, line + 1);
+	// A producer may have taken another slot of the page and not counted it yet, slab_reclaim finds it missing
+	if (last) slab_reclaim(class_index);
+}
+
+size_t slab_pool_receive(void *buffer, size_t size, TickType_t xTicksToWait)
+{
+	size_t received = 0;
+	const void *data = slab_pool_acquire(&received, xTicksToWait);
+	if (data == NULL) return 0;
+	if (received > size) received = size;
+	memcpy(buffer, data, received);
+	slab_pool_release(data);
+	return received;
+}
+
+// Bytes of the slots in use, a short record takes its whole slot
+size_t slab_pool_used(void)
+{
+	return __atomic_load_n(&used_bytes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,32 @@
+#ifndef SLAB_POOL_H_
+#define SLAB_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// Fixed-size slots in size classes of 64, 128, 256... bytes up to the longest record.
+// Pages of the buffer are cut into slots of a class when it runs out of slots,
+// and go back to the free pages when the consumer releases the last slot in use.
+// Each class has a lock-free free list, a record takes the smallest free slot that fits.
+// Filled slots are published in order through a lock-free queue of slot indices,
+// read by a single consumer in place.
+// Slots are aligned to the cache line and never wrap, so no space is lost at the end of the buffer.
+
+bool slab_pool_create(size_t xBufferSizeBytes, size_t max_length, uint32_t caps);
+bool slab_pool_send(const void *data, size_t length);
+const void *slab_pool_acquire(size_t *length, TickType_t xTicksToWait);
+void slab_pool_release(const void *data);
+size_t slab_pool_receive(void *buffer, size_t size, TickType_t xTicksToWait);
+size_t slab_pool_used(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLAB_POOL_H_ */
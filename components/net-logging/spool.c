@@ -0,0 +1,285 @@
+/*
+	Flash spool
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "net_logging.h"
+#include "spool.h"
+
+#if CONFIG_NET_LOGGING_SPOOL
+#define SPOOL_MAGIC 0x4c53 // "SL"
+#define SPOOL_SECTOR_SIZE 4096
+#define BLOCK_FREE 0xffffffff
+#define BLOCK_REPLAYED 0
+// Wait for live records no longer than this while spooled records are pending
+#define SPOOL_POLL_MS 100
+
+typedef struct {
+	uint16_t magic;
+	uint16_t length;
+	uint32_t seq;
+	uint32_t crc;
+	uint32_t state;
+} SPOOL_HEADER_t;
+
+#define SPOOL_DATA_SIZE (SPOOL_BLOCK_SIZE - sizeof(SPOOL_HEADER_t))
+
+// Only the sender task that owns the spool calls these functions
+static struct {
+	const esp_partition_t *partition;
+	uint32_t blocks;
+	uint32_t read; // Oldest block that is not replayed yet
+	uint32_t write; // Next block to write
+	uint32_t seq;
+	// Block being written, kept in RAM until it is full
+	SPOOL_HEADER_t header;
+	uint8_t data[SPOOL_DATA_SIZE];
+	// Block being replayed
+	uint8_t replay[SPOOL_DATA_SIZE];
+	size_t replay_len;
+	size_t replay_pos;
+	bool replay_from_flash;
+	uint32_t replay_block;
+	uint32_t replay_seq;
+	// Replay rate limit
+	uint32_t tokens;
+	TickType_t refill;
+} spool;
+
+#define BLOCKS_PER_SECTOR (SPOOL_SECTOR_SIZE / SPOOL_BLOCK_SIZE)
+
+static uint32_t block_crc(const SPOOL_HEADER_t *header, const uint8_t *data)
+{
+	uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&header->seq, sizeof(header->seq));
+	return esp_rom_crc32_le(crc, data, header->length);
+}
+
+// Read the header and the data of a block, returns false if it is not a valid block
+static bool block_read(uint32_t block, SPOOL_HEADER_t *header, uint8_t *data)
+{
+	size_t offset = block * SPOOL_BLOCK_SIZE;
+	if (esp_partition_read(spool.partition, offset, header, sizeof(*header)) != ESP_OK) return false;
+	if (header->magic != SPOOL_MAGIC || header->length > SPOOL_DATA_SIZE) return false;
+	if (data == NULL) return true;
+	if (esp_partition_read(spool.partition, offset + sizeof(*header), data, header->length) != ESP_OK) return false;
+	return (block_crc(header, data) == header->crc);
+}
+
+bool spool_open(const char *label)
+{
+	spool.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+	if (spool.partition == NULL) {
+		printf("spool partition [%s] not found\n", label);
+		return false;
+	}
+	// Replayed blocks are marked by writing over the state
+	if (spool.partition->encrypted) {
+		printf("spool partition [%s] must not be encrypted\n", label);
+		spool.partition = NULL;
+		return false;
+	}
+	spool.blocks = (spool.partition->size / SPOOL_SECTOR_SIZE) * BLOCKS_PER_SECTOR;
+	if (spool.blocks < 2 * BLOCKS_PER_SECTOR) {
+		printf("spool partition [%s] needs at least two sectors\n", label);
+		spool.partition = NULL;
+		return false;
+	}
+
+	// The newest block is followed by the write position
+	bool found = false;
+	uint32_t newest_seq = 0;
+	SPOOL_HEADER_t header;
+	for (uint32_t block=0; block<spool.blocks; block++) {
+		if (block_read(block, &header, NULL) == false) continue;
+		if (found == false || (int32_t)(header.seq - newest_seq) > 0) {
+			newest_seq = header.seq;
+			spool.write = (block + 1) % spool.blocks;
+			found = true;
+		}
+	}
+	if (found == false) spool.write = 0;
+	spool.seq = found ? newest_seq + 1 : 0;
+	// The oldest block that is not replayed is the read position.
+	// The rest of the sector at the write position was given up by spool_flush and is erased next.
+	bool pending = false;
+	uint32_t oldest_seq = 0;
+	for (uint32_t block=0; block<spool.blocks; block++) {
+		if (block / BLOCKS_PER_SECTOR == spool.write / BLOCKS_PER_SECTOR && block >= spool.write) continue;
+		if (block_read(block, &header, NULL) == false) continue;
+		if (header.state != BLOCK_REPLAYED && (pending == false || (int32_t)(header.seq - oldest_seq) < 0)) {
+			oldest_seq = header.seq;
+			spool.read = block;
+			pending = true;
+		}
+	}
+	if (pending == false) spool.read = spool.write;
+
+	// A block that was not written completely starts a new sector
+	if (spool.write % BLOCKS_PER_SECTOR) {
+		esp_partition_read(spool.partition, spool.write * SPOOL_BLOCK_SIZE, &header, sizeof(header));
+		if (header.magic != 0xffff) {
+			spool.write = (spool.write + BLOCKS_PER_SECTOR - spool.write % BLOCKS_PER_SECTOR) % spool.blocks;
+		}
+	}
+	spool.header.length = 0;
+	spool.replay_len = spool.replay_pos = 0;
+	spool.tokens = CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE;
+	spool.refill = xTaskGetTickCount();
+	printf("spool partition [%s] blocks=%"PRIu32" read=%"PRIu32" write=%"PRIu32"\n", label, spool.blocks, spool.read, spool.write);
+	return true;
+}
+
+// Write the block in RAM to flash
+static void spool_flush(void)
+{
+	if (spool.partition == NULL || spool.header.length == 0) return;
+	size_t offset = spool.write * SPOOL_BLOCK_SIZE;
+	if (spool.write % BLOCKS_PER_SECTOR == 0) {
+		// The oldest blocks are given up when the spool is full
+		uint32_t sector = spool.write / BLOCKS_PER_SECTOR;
+		if (spool.read != spool.write && spool.read / BLOCKS_PER_SECTOR == sector) {
+			printf("spool full, oldest records lost\n");
+			spool.read = (spool.write + BLOCKS_PER_SECTOR) % spool.blocks;
+		}
+		esp_partition_erase_range(spool.partition, offset, SPOOL_SECTOR_SIZE);
+	}
+	spool.header.magic = SPOOL_MAGIC;
+	spool.header.seq = spool.seq++;
+	spool.header.crc = block_crc(&spool.header, spool.data);
+	spool.header.state = BLOCK_FREE;
+	esp_partition_write(spool.partition, offset + sizeof(spool.header), spool.data, spool.header.length);
+	// The header is written last, a block without header is not valid
+	esp_partition_write(spool.partition, offset, &spool.header, sizeof(spool.header));
+	spool.write = (spool.write + 1) % spool.blocks;
+	spool.header.length = 0;
+	// A full spool would look empty, so the oldest sector is given up before the write position reaches it
+	if (spool.write == spool.read) {
+		printf("spool full, oldest records lost\n");
+		spool.read = (spool.read + BLOCKS_PER_SECTOR) % spool.blocks;
+	}
+}
+
+static bool spool_write(const char *record, size_t length)
+{
+	if (spool.partition == NULL || length == 0 || length + 2 > SPOOL_DATA_SIZE) return false;
+	if (spool.header.length + 2 + length > SPOOL_DATA_SIZE) spool_flush();
+	uint16_t record_len = length;
+	memcpy(&spool.data[spool.header.length], &record_len, sizeof(record_len));
+	memcpy(&spool.data[spool.header.length + 2], record, length);
+	spool.header.length += 2 + length;
+	return true;
+}
+
+bool spool_pending(void)
+{
+	if (spool.partition == NULL) return false;
+	return (spool.replay_pos < spool.replay_len || spool.read != spool.write || spool.header.length != 0);
+}
+
+// Load the next block to replay, from flash or else from RAM
+static bool spool_next_block(void)
+{
+	while (spool.read != spool.write) {
+		SPOOL_HEADER_t header;
+		uint32_t block = spool.read;
+		spool.read = (spool.read + 1) % spool.blocks;
+		// Replayed and damaged blocks are skipped
+		if (block_read(block, &header, spool.replay) == false || header.state == BLOCK_REPLAYED) continue;
+		spool.replay_len = header.length;
+		spool.replay_pos = 0;
+		// Marked as replayed once all records are taken
+		spool.replay_from_flash = true;
+		spool.replay_block = block;
+		spool.replay_seq = header.seq;
+		return true;
+	}
+	if (spool.header.length == 0) return false;
+	memcpy(spool.replay, spool.data, spool.header.length);
+	spool.replay_len = spool.header.length;
+	spool.replay_pos = 0;
+	spool.replay_from_flash = false;
+	spool.header.length = 0;
+	return true;
+}
+
+// Take the oldest spooled record, or nothing when the replay rate is used up
+static size_t spool_receive(char *buffer, size_t size)
+{
+	if (spool.partition == NULL) return 0;
+
+	// Refill the budget of the replay rate
+	TickType_t now = xTaskGetTickCount();
+	uint32_t elapsed_ms = (now - spool.refill) * portTICK_PERIOD_MS;
+	if (elapsed_ms) {
+		uint64_t tokens = spool.tokens + (uint64_t)elapsed_ms * CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE / 1000;
+		spool.tokens = (tokens > CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE) ? CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE : tokens;
+		spool.refill = now;
+	}
+
+	if (spool.replay_pos >= spool.replay_len) {
+		if (spool_next_block() == false) return 0;
+	}
+	uint16_t record_len;
+	memcpy(&record_len, &spool.replay[spool.replay_pos], sizeof(record_len));
+	if (record_len > spool.tokens) return 0;
+	spool.tokens -= record_len;
+
+	size_t received = (record_len < size) ? record_len : size;
+	memcpy(buffer, &spool.replay[spool.replay_pos + 2], received);
+	spool.replay_pos += 2 + record_len;
+	if (spool.replay_pos >= spool.replay_len && spool.replay_from_flash) {
+		spool.replay_from_flash = false;
+		// The sector may have been erased and written again in the meantime
+		SPOOL_HEADER_t header;
+		if (block_read(spool.replay_block, &header, NULL) && header.seq == spool.replay_seq) {
+			// Clear the state, flash bits can be written from 1 to 0 without erasing
+			uint32_t state = BLOCK_REPLAYED;
+			esp_partition_write(spool.partition, spool.replay_block * SPOOL_BLOCK_SIZE + offsetof(SPOOL_HEADER_t, state), &state, sizeof(state));
+		}
+	}
+	return received;
+}
+
+// Move records from the sink to the spool while the sender is offline
+void spool_store(SINK_t *sink, TickType_t xTicksToWait)
+{
+	// Without a partition the records stay in the ring as before
+	if (spool.partition == NULL) {
+		vTaskDelay(xTicksToWait);
+		return;
+	}
+	TickType_t start = xTaskGetTickCount();
+	while (1) {
+		TickType_t elapsed = xTaskGetTickCount() - start;
+		if (elapsed >= xTicksToWait) break;
+		char buffer[xItemSize];
+		size_t received = sink_receive(sink, buffer, sizeof(buffer), xTicksToWait - elapsed);
+		if (received == 0) break;
+		spool_write(buffer, received);
+	}
+}
+
+// Receive spooled records first, then the records of the sink
+size_t spool_sink_receive(SINK_t *sink, char *buffer, size_t size, TickType_t xTicksToWait)
+{
+	size_t received = spool_receive(buffer, size);
+	if (received) return received;
+	// Come back for the spool when the replay rate allows more
+	if (spool_pending() && xTicksToWait > pdMS_TO_TICKS(SPOOL_POLL_MS)) xTicksToWait = pdMS_TO_TICKS(SPOOL_POLL_MS);
+	return sink_receive(sink, buffer, size, xTicksToWait);
+}
+#endif
@@ -0,0 +1,30 @@
+#ifndef SPOOL_H_
+#define SPOOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "sink.h"
+
+// Append-only log of records in a flash partition, written while the sender is offline.
+// The partition is written round robin one block after the other, so every sector is erased equally often.
+// Block: magic (2 bytes), data length (2 bytes), sequence (4 bytes), CRC32 of sequence and data (4 bytes),
+// state (4 bytes), data. The state is cleared in place once the block is replayed.
+// Data: length (2 bytes) and record, repeated.
+#define SPOOL_BLOCK_SIZE 1024
+
+bool spool_open(const char *label);
+bool spool_pending(void);
+void spool_store(SINK_t *sink, TickType_t xTicksToWait);
+size_t spool_sink_receive(SINK_t *sink, char *buffer, size_t size, TickType_t xTicksToWait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOOL_H_ */
@@ -0,0 +1,47 @@
+/*
+	STDOUT mirror
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#include "net_logging.h"
+#include "sink.h"
+
+extern bool writeToStdout;
+
+// Write the records that are already formatted to STDOUT.
+// Only this task waits for the UART, the logging tasks never do.
+void stdout_sink(void *pvParameters)
+{
+	PARAMETER_t *task_parameter = pvParameters;
+	PARAMETER_t param;
+	memcpy((char *)&param, task_parameter, sizeof(PARAMETER_t));
+	free(task_parameter);
+
+	// The record is copied out of the fan-out ring once, as the ring may overwrite it while it is written
+	static char buffer[xItemSize];
+	while (1) {
+		size_t received = sink_receive(param.sink, buffer, sizeof(buffer), portMAX_DELAY);
+		if (received == 0) {
+			printf("sink_receive fail\n");
+			break;
+		}
+		// The last *_logging_init decides, as with direct writes
+		if (writeToStdout == false) continue;
+		fwrite(buffer, 1, received, stdout);
+		sink_sent(param.sink, received, true);
+		if (buffer[received-1] == 0x0a) fflush(stdout);
+	}
+	vTaskDelete(NULL);
+}
@@ -0,0 +1,301 @@
+/*
+	Syslog (RFC 5424) and GELF encoders
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h> // gethostname
+#include "esp_log.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_mac.h" // esp_base_mac_addr_get
+#endif
+
+#include "structured_format.h"
+
+#if CONFIG_UDP_FORMAT_SYSLOG || CONFIG_UDP_FORMAT_GELF || CONFIG_TCP_FORMAT_SYSLOG
+
+static const char level_letter[] = "NEWIDV";
+// Syslog severity of each ESP level, records without a level are notices
+static const uint8_t level_severity[] = { 5, 3, 4, 6, 7, 7 };
+#define RESET_COLOR "\033[0m"
+
+// RFC 5424 limits
+#define SYSLOG_HOSTNAME_LENGTH 32
+#define SYSLOG_APP_NAME_LENGTH 48
+// Room for "LEN " in front of an octet counted message
+#define SYSLOG_OCTET_COUNT_SIZE 6
+
+// The clock has not been set before this time (2020-01-01)
+#define STRUCTURED_TIME_VALID 1577836800
+
+// The parts of "I (6123) MAIN: message\n"
+typedef struct {
+	uint8_t level;
+	bool has_uptime;
+	uint32_t uptime;
+	const char *tag;
+	size_t tag_len;
+	const char *message;
+	size_t message_len;
+} STRUCTURED_RECORD_t;
+
+// Text that is not an ESP log record is sent as the message without a level and tag
+static void structured_parse(STRUCTURED_RECORD_t *parsed, const char *text, size_t length)
+{
+	memset(parsed, 0, sizeof(STRUCTURED_RECORD_t));
+
+	// Remove trailing LF and the reset of the color
+	size_t end = length;
+	while (end && (text[end-1] == '\n' || text[end-1] == '\r')) end--;
+	size_t reset_len = strlen(RESET_COLOR);
+	if (end >= reset_len && memcmp(&text[end-reset_len], RESET_COLOR, reset_len) == 0) end -= reset_len;
+	parsed->message = text;
+	parsed->message_len = end;
+
+	size_t pos = 0;
+	// Skip the color escape sequence
+	if (end && text[0] == '\033') {
+		while (pos < end && text[pos] != 'm') pos++;
+		pos++;
+	}
+	if (pos + 4 > end) return;
+	const char *letter = strchr(level_letter + 1, text[pos]);
+	if (text[pos] == 0 || letter == NULL || text[pos+1] != ' ' || text[pos+2] != '(') return;
+	pos += 3;
+
+	// Milliseconds since boot, or the time of day with CONFIG_LOG_TIMESTAMP_SOURCE_SYSTEM
+	uint32_t uptime = 0;
+	size_t start = pos;
+	while (pos < end && isdigit((unsigned char)text[pos])) {
+		uptime = uptime * 10 + (text[pos] - '0');
+		pos++;
+	}
+	bool has_uptime = (pos > start && pos < end && text[pos] == ')');
+	while (pos < end && text[pos] != ')') pos++;
+	if (pos + 1 >= end || text[pos+1] != ' ') return;
+	pos += 2;
+
+	size_t tag_start = pos;
+	while (pos + 1 < end && !(text[pos] == ':' && text[pos+1] == ' ')) pos++;
+	if (pos + 1 >= end) return;
+
+	parsed->level = letter - level_letter;
+	parsed->has_uptime = has_uptime;
+	parsed->uptime = uptime;
+	parsed->tag = &text[tag_start];
+	parsed->tag_len = pos - tag_start;
+	parsed->message = &text[pos+2];
+	parsed->message_len = end - (pos + 2);
+}
+
+// Host name from the MAC address, the same for every record
+static const char *structured_hostname(void)
+{
+	static char hostname[SYSLOG_HOSTNAME_LENGTH + 1];
+	if (hostname[0]) return hostname;
+	char name[SYSLOG_HOSTNAME_LENGTH + 1] = "esp32";
+#if CONFIG_IDF_TARGET_LINUX
+	if (gethostname(name, sizeof(name)) != 0 || name[0] == 0) strcpy(name, "linux");
+	name[SYSLOG_HOSTNAME_LENGTH] = 0;
+	// Only characters that need no escaping in both formats
+	for (int i=0;name[i];i++) {
+		if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '.') name[i] = '_';
+	}
+#else
+	uint8_t mac[8];
+	if (esp_base_mac_addr_get(mac) == ESP_OK) {
+		sprintf(name, "esp32-%02x%02x%02x%02x%02x%02x", mac[0],mac[1],mac[2],mac[3],mac[4],mac[5]);
+	}
+#endif
+	// Senders may race here, they write the same name
+	strcpy(hostname, name);
+	return hostname;
+}
+
+static bool structured_time(struct timeval *tv)
+{
+	gettimeofday(tv, NULL);
+	return tv->tv_sec >= STRUCTURED_TIME_VALID;
+}
+
+// Append formatted text, returns false when it does not fit
+static bool structured_append(char *out, size_t size, size_t *len, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	int ret = vsnprintf(&out[*len], size - *len, fmt, ap);
+	va_end(ap);
+	if (ret < 0 || ret >= size - *len) return false;
+	*len += ret;
+	return true;
+}
+
+#if CONFIG_UDP_FORMAT_SYSLOG || CONFIG_TCP_FORMAT_SYSLOG
+// APP-NAME is 1 to 48 printable US-ASCII characters
+static void syslog_app_name(char *app, const STRUCTURED_RECORD_t *parsed)
+{
+	size_t len = parsed->tag_len;
+	if (len > SYSLOG_APP_NAME_LENGTH) len = SYSLOG_APP_NAME_LENGTH;
+	for (int i=0;i<len;i++) {
+		unsigned char c = parsed->tag[i];
+		app[i] = (c > 32 && c < 127) ? c : '_';
+	}
+	if (len == 0) app[len++] = '-';
+	app[len] = 0;
+}
+
+// <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID [SD] MSG
+// With octet counting the message is preceded by its length and a space (RFC 6587).
+int syslog_format_encode(char *out, size_t size, const char *record, size_t length, bool octet_counting)
+{
+	STRUCTURED_RECORD_t parsed;
+	structured_parse(&parsed, record, length);
+
+	size_t prefix_len = octet_counting ? SYSLOG_OCTET_COUNT_SIZE : 0;
+	if (size <= prefix_len) return -1;
+	char *message = &out[prefix_len];
+	size_t message_size = size - prefix_len;
+
+	char timestamp[32] = "-";
+	struct timeval tv;
+	if (structured_time(&tv)) {
+		struct tm tm;
+		gmtime_r(&tv.tv_sec, &tm);
+		size_t n = strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm);
+		snprintf(&timestamp[n], sizeof(timestamp) - n, ".%03ldZ", (long)(tv.tv_usec / 1000));
+	}
+	char app[SYSLOG_APP_NAME_LENGTH + 1];
+	syslog_app_name(app, &parsed);
+	int pri = CONFIG_NET_LOGGING_SYSLOG_FACILITY * 8 + level_severity[parsed.level];
+
+	size_t len = 0;
+	if (!structured_append(message, message_size, &len, "<%d>1 %s %s %s - - ", pri, timestamp, structured_hostname(), app)) return -1;
+	// 32473 is the enterprise number for examples (RFC 5612)
+	if (parsed.has_uptime) {
+		if (!structured_append(message, message_size, &len, "[netlog@32473 uptime=\"%"PRIu32"\"]", parsed.uptime)) return -1;
+	} else {
+		if (!structured_append(message, message_size, &len, "-")) return -1;
+	}
+	if (parsed.message_len) {
+		if (len + 1 >= message_size) return -1;
+		message[len++] = ' ';
+		size_t copy = parsed.message_len;
+		if (copy > message_size - len) copy = message_size - len;
+		memcpy(&message[len], parsed.message, copy);
+		len += copy;
+	}
+
+	if (octet_counting) {
+		char count[SYSLOG_OCTET_COUNT_SIZE + 1];
+		int count_len = snprintf(count, sizeof(count), "%u ", (unsigned)len);
+		if (count_len < 0 || count_len > SYSLOG_OCTET_COUNT_SIZE) return -1;
+		memmove(&out[count_len], message, len);
+		memcpy(out, count, count_len);
+		len += count_len;
+	}
+	return len;
+}
+#endif
+
+#if CONFIG_UDP_FORMAT_GELF
+// Append text as the content of a JSON string, as much as fits into the output
+static void gelf_escape(char *out, size_t size, size_t *len, const char *text, size_t length)
+{
+	size_t pos = *len;
+	for (int i=0;i<length;i++) {
+		unsigned char c = text[i];
+		if (c == '"' || c == '\\') {
+			if (pos + 2 > size) break;
+			out[pos++] = '\\';
+			out[pos++] = c;
+		} else if (c < 0x20) {
+			if (pos + 6 > size) break;
+			char escaped[7];
+			sprintf(escaped, "\\u%04x", c);
+			memcpy(&out[pos], escaped, 6);
+			pos += 6;
+		} else {
+			if (pos + 1 > size) break;
+			out[pos++] = c;
+		}
+	}
+	*len = pos;
+}
+
+// {"version":"1.1","host":..,"level":..,"timestamp":..,"_tag":..,"_uptime_ms":..,"short_message":..}
+int gelf_format_encode(char *out, size_t size, const char *record, size_t length)
+{
+	STRUCTURED_RECORD_t parsed;
+	structured_parse(&parsed, record, length);
+
+	size_t len = 0;
+	if (!structured_append(out, size, &len, "{\"version\":\"1.1\",\"host\":\"%s\",\"level\":%d",
+		structured_hostname(), level_severity[parsed.level])) return -1;
+	struct timeval tv;
+	if (structured_time(&tv)) {
+		if (!structured_append(out, size, &len, ",\"timestamp\":%lld.%03ld", (long long)tv.tv_sec, (long)(tv.tv_usec / 1000))) return -1;
+	}
+	if (parsed.tag_len) {
+		if (!structured_append(out, size, &len, ",\"_tag\":\"")) return -1;
+		// Keep room for the closing quote
+		gelf_escape(out, size - 1, &len, parsed.tag, parsed.tag_len);
+		out[len++] = '"';
+	}
+	if (parsed.has_uptime) {
+		if (!structured_append(out, size, &len, ",\"_uptime_ms\":%"PRIu32, parsed.uptime)) return -1;
+	}
+	if (!structured_append(out, size, &len, ",\"short_message\":\"")) return -1;
+	// The message is last, so a long message is truncated and the closing quote and brace still fit
+	if (len + 2 > size) return -1;
+	gelf_escape(out, size - 2, &len, parsed.message, parsed.message_len);
+	out[len++] = '"';
+	out[len++] = '}';
+	return len;
+}
+
+// The id only has to be unique among the messages a server is putting together
+void gelf_format_message_id(uint8_t *id)
+{
+	static uint32_t message_count;
+	// Hash of the host name tells devices apart
+	uint32_t hash = 2166136261u;
+	for (const char *p = structured_hostname(); *p; p++) {
+		hash = (hash ^ (uint8_t)*p) * 16777619u;
+	}
+	uint32_t count = ++message_count;
+	memcpy(&id[0], &hash, sizeof(hash));
+	memcpy(&id[4], &count, sizeof(count));
+}
+
+// Chunk number index of a message, returns 0 after the last chunk and -1 for a message with too many chunks
+int gelf_format_chunk(char *chunk, const uint8_t *id, const char *message, size_t length, int index)
+{
+	size_t chunk_data = GELF_CHUNK_SIZE - GELF_CHUNK_HEADER_SIZE;
+	size_t count = (length + chunk_data - 1) / chunk_data;
+	if (count > GELF_CHUNK_MAX) return -1;
+	if (index >= count) return 0;
+	size_t offset = index * chunk_data;
+	size_t data_len = length - offset;
+	if (data_len > chunk_data) data_len = chunk_data;
+	chunk[0] = 0x1e;
+	chunk[1] = 0x0f;
+	memcpy(&chunk[2], id, GELF_MESSAGE_ID_SIZE);
+	chunk[10] = index;
+	chunk[11] = count;
+	memcpy(&chunk[GELF_CHUNK_HEADER_SIZE], &message[offset], data_len);
+	return GELF_CHUNK_HEADER_SIZE + data_len;
+}
+#endif
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef STRUCTURED_FORMAT_H_
+#define STRUCTURED_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Header and fields added to the text of one record.
+// A message that does not fit into the output is truncated.
+#define STRUCTURED_FORMAT_OVERHEAD 256
+
+// GELF messages larger than one datagram are split into chunks.
+// Chunk: 0x1e 0x0f, message id (8 bytes), sequence number (1 byte), sequence count (1 byte), data.
+#define GELF_CHUNK_SIZE 1420
+#define GELF_CHUNK_HEADER_SIZE 12
+#define GELF_CHUNK_MAX 128
+#define GELF_MESSAGE_ID_SIZE 8
+
+int syslog_format_encode(char *out, size_t size, const char *record, size_t length, bool octet_counting);
+int gelf_format_encode(char *out, size_t size, const char *record, size_t length);
+void gelf_format_message_id(uint8_t *id);
+int gelf_format_chunk(char *chunk, const uint8_t *id, const char *message, size_t length, int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STRUCTURED_FORMAT_H_ */
@@ -9,104 +9,295 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
-#if CONFIG_USE_RINGBUFFER
-#include "freertos/ringbuf.h"
-#else
-#include "freertos/message_buffer.h"
-#endif
 #include "esp_system.h"
 #include "esp_log.h"
 #include "lwip/sockets.h"
 #include "netdb.h" // gethostbyname
 
 #include "net_logging.h"
+#include "sink.h"
+
+// Syslog messages are text, the compact format and compression apply to ESP log records only
+#define TCP_COMPACT_FORMAT (CONFIG_COMPACT_FORMAT && !CONFIG_TCP_FORMAT_SYSLOG)
+#define TCP_COMPRESSION (CONFIG_COMPRESSION && !CONFIG_TCP_FORMAT_SYSLOG)
+
+#if CONFIG_TCP_FORMAT_SYSLOG
+#include "structured_format.h"
+#endif
+#if TCP_COMPACT_FORMAT
+#include "compact_format.h"
+#endif
+#if TCP_COMPRESSION
+#include "compress.h"
+#endif
+#if CONFIG_NET_LOGGING_SPOOL_TCP
+#include "spool.h"
+#endif
 
-#if CONFIG_USE_RINGBUFFER
-extern RingbufHandle_t xRingBufferTrans;
+
+#define TCP_CONNECT_TIMEOUT_MS 5000
+#define TCP_BACKOFF_MIN_MS 500
+#define TCP_BACKOFF_MAX_MS 30000
+// Maximum number of records in one batch
+#define TCP_BATCH_RECORDS 64
+
+#if CONFIG_TCP_FORMAT_SYSLOG
+#define TCP_RECORD_SIZE (xItemSize + STRUCTURED_FORMAT_OVERHEAD)
+#elif TCP_COMPACT_FORMAT
+#define TCP_RECORD_SIZE (xItemSize + COMPACT_FORMAT_OVERHEAD)
 #else
-extern MessageBufferHandle_t xMessageBufferTrans;
+#define TCP_RECORD_SIZE xItemSize
 #endif
 
-void tcp_client(void *pvParameters)
+static int tcp_connect(PARAMETER_t *param)
 {
-	PARAMETER_t *task_parameter = pvParameters;
-	PARAMETER_t param;
-	memcpy((char *)&param, task_parameter, sizeof(PARAMETER_t));
-	printf("Start:param.port=%d param.ipv4=[%s]\n", param.port, param.ipv4);
-
 	int addr_family = 0;
 	int ip_protocol = 0;
 
 	struct sockaddr_in dest_addr;
-	dest_addr.sin_addr.s_addr = inet_addr(param.ipv4);
+	dest_addr.sin_addr.s_addr = inet_addr(param->ipv4);
 	dest_addr.sin_family = AF_INET;
-	dest_addr.sin_port = htons(param.port);
+	dest_addr.sin_port = htons(param->port);
 	addr_family = AF_INET;
 	ip_protocol = IPPROTO_IP;
 
-	printf("dest_addr.sin_addr.s_addr=0x%"PRIx32"\n", dest_addr.sin_addr.s_addr);
+	//printf("dest_addr.sin_addr.s_addr=0x%"PRIx32"\n", dest_addr.sin_addr.s_addr);
 	if (dest_addr.sin_addr.s_addr == 0xffffffff) {
 		struct hostent *hp;
-		hp = gethostbyname(param.ipv4);
+		hp = gethostbyname(param->ipv4);
 		if (hp == NULL) {
-			printf("FTP Client Error: Connect, gethostbyname\n");
-			vTaskDelete(NULL);
+			printf("TCP Client Error: Connect, gethostbyname\n");
+			return -1;
 		}
-		struct ip4_addr *ip4_addr;
-		ip4_addr = (struct ip4_addr *)hp->h_addr;
-		dest_addr.sin_addr.s_addr = ip4_addr->addr;
+		memcpy(&dest_addr.sin_addr.s_addr, hp->h_addr, sizeof(dest_addr.sin_addr.s_addr));
 		printf("dest_addr.sin_addr.s_addr=0x%"PRIx32"\n", dest_addr.sin_addr.s_addr);
 	}
-	
 
 	int sock = socket(addr_family, SOCK_STREAM, ip_protocol);
 	if (sock < 0) {
-		//ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
-		vTaskDelete(NULL);
+		printf("Unable to create socket: errno %d\n", errno);
+		return -1;
 	}
-	printf("Socket created, connecting to %s:%d\n", param.ipv4, param.port);
+	printf("Socket created, connecting to %s:%d\n", param->ipv4, param->port);
 
-	int err = connect(sock, (struct sockaddr *)&dest_addr, sizeof(struct sockaddr_in6));
-	if (err == 0) {
-		printf("Successfully connected\n");
-	} else {
+	// Connect without blocking, an unreachable server must not hold the sender longer than the timeout
+	int flags = fcntl(sock, F_GETFL, 0);
+	fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+	int err = connect(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+	if (err != 0 && errno == EINPROGRESS) {
+		fd_set writable;
+		FD_ZERO(&writable);
+		FD_SET(sock, &writable);
+		struct timeval connect_timeout = { .tv_sec = TCP_CONNECT_TIMEOUT_MS / 1000, .tv_usec = (TCP_CONNECT_TIMEOUT_MS % 1000) * 1000 };
+		int ready = select(sock + 1, NULL, &writable, NULL, &connect_timeout);
+		if (ready > 0) {
+			int sock_error = 0;
+			socklen_t sock_error_len = sizeof(sock_error);
+			getsockopt(sock, SOL_SOCKET, SO_ERROR, &sock_error, &sock_error_len);
+			err = sock_error ? -1 : 0;
+			errno = sock_error;
+		} else if (ready == 0) {
+			errno = ETIMEDOUT;
+		}
+	}
+	if (err != 0) {
 		printf("Socket unable to connect: errno %d\n", errno);
-		vTaskDelete(NULL);
+		close(sock);
+		return -1;
 	}
+	fcntl(sock, F_SETFL, flags);
+	printf("Successfully connected\n");
+
+	// Do not block forever on a dead connection
+	struct timeval timeout = { .tv_sec = 5, .tv_usec = 0 };
+	setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	return sock;
+}
+
+#if TCP_COMPACT_FORMAT
+static bool tcp_send_all(int sock, const char *data, size_t length)
+{
+	size_t sent = 0;
+	while (sent < length) {
+		int ret = send(sock, &data[sent], length - sent, 0);
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			printf("Socket send fail: errno %d\n", errno);
+			return false;
+		}
+		sent += ret;
+	}
+	return true;
+}
+
+// Convert parsed records to compact records, other records are sent as they are
+static size_t tcp_encode(COMPACT_STATE_t *state, char *frame, size_t size, const char *buffer, size_t received)
+{
+	int frame_len = -1;
+	if (compact_format_is_record(buffer, received)) {
+		frame_len = compact_format_encode(state, frame, size, buffer, received);
+		if (frame_len <= 0) frame_len = compact_format_unpack(frame, size, buffer, received);
+	}
+	if (frame_len <= 0) {
+		memcpy(frame, buffer, received);
+		frame_len = received;
+	}
+	return frame_len;
+}
+#endif
+
+static size_t tcp_receive(SINK_t *sink, char *buffer, size_t size, TickType_t xTicksToWait)
+{
+#if CONFIG_NET_LOGGING_SPOOL_TCP
+	// Records spooled while offline are sent first
+	return spool_sink_receive(sink, buffer, size, xTicksToWait);
+#else
+	return sink_receive(sink, buffer, size, xTicksToWait);
+#endif
+}
+
+void tcp_client(void *pvParameters)
+{
+	PARAMETER_t *task_parameter = pvParameters;
+	PARAMETER_t param;
+	memcpy((char *)&param, task_parameter, sizeof(PARAMETER_t));
+	free(task_parameter);
+	printf("Start:param.port=%d param.ipv4=[%s]\n", param.port, param.ipv4);
 
-	// Send ready to receive notify
-	xTaskNotifyGive(param.taskHandle);
+	// Records are collected into one batch and sent with a single send
+	static char batch[CONFIG_TCP_BATCH_SIZE];
+	size_t batch_len = 0;
+	size_t batch_sent = 0;
+	// Start offset of each record in the batch
+	uint16_t record_start[TCP_BATCH_RECORDS];
+	int record_count = 0;
+#if TCP_COMPACT_FORMAT || CONFIG_TCP_FORMAT_SYSLOG
+	// The record before it is encoded into the batch, not on the stack of this task
+	static char buffer[xItemSize];
+#endif
+#if TCP_COMPACT_FORMAT
+	// The tag dictionary is kept across connections and sent again after connecting
+	static COMPACT_STATE_t compact_state;
+	compact_format_reset(&compact_state);
+	// Timestamp base before each record in the batch
+	static uint32_t record_base[TCP_BATCH_RECORDS];
+	static char sync[COMPACT_SYNC_SIZE];
+#endif
+#if TCP_COMPRESSION
+	static COMPRESS_STATE_t compress_state;
+	static char packed[CONFIG_TCP_BATCH_SIZE];
+#endif
+
+#if CONFIG_NET_LOGGING_SPOOL_TCP
+	spool_open(CONFIG_NET_LOGGING_SPOOL_PARTITION);
+#endif
+
+	int sock = -1;
+	uint32_t backoff_ms = TCP_BACKOFF_MIN_MS;
 
 	while (1) {
-#if CONFIG_USE_RINGBUFFER
-        size_t received;
-        char *buffer = (char *)xRingbufferReceive(xRingBufferTrans, &received, portMAX_DELAY);
-        //printf("xRingBufferReceive received=%d\n", received);
+		if (sock < 0) {
+			sock = tcp_connect(&param);
+			if (sock < 0) {
+				sink_set_connected(param.sink, false);
+				// The batch and the records in the ring are kept while reconnecting
+#if CONFIG_NET_LOGGING_SPOOL_TCP
+				spool_store(param.sink, pdMS_TO_TICKS(backoff_ms));
 #else
-		char buffer[xItemSize];
-		size_t received = xMessageBufferReceive(xMessageBufferTrans, buffer, sizeof(buffer), portMAX_DELAY);
-		//printf("xMessageBufferReceive received=%d\n", received);
+				vTaskDelay(pdMS_TO_TICKS(backoff_ms));
 #endif
-		if (received > 0) {
-			//printf("xMessageBufferReceive buffer=[%.*s]\n",received, buffer);
-			int ret = send(sock, buffer, received, 0);
-			LWIP_ASSERT("ret == received", ret == received);
-#if CONFIG_USE_RINGBUFFER
-            vRingbufferReturnItem(xRingBufferTrans, (void *)buffer);
+				backoff_ms = backoff_ms * 2;
+				if (backoff_ms > TCP_BACKOFF_MAX_MS) backoff_ms = TCP_BACKOFF_MAX_MS;
+				continue;
+			}
+			backoff_ms = TCP_BACKOFF_MIN_MS;
+#if TCP_COMPACT_FORMAT
+			// The server starts every connection with an empty dictionary
+			uint32_t base = compact_state.timestamp;
+			for (int i=0;i<record_count;i++) {
+				if (batch_sent < batch_len && record_start[i] == batch_sent) base = record_base[i];
+			}
+			int sync_len = compact_format_sync(&compact_state, sync, sizeof(sync), base);
+			if (sync_len > 0 && tcp_send_all(sock, sync, sync_len) == false) {
+				close(sock);
+				sock = -1;
+				continue;
+			}
 #endif
-		} else {
-			//printf("xMessageBufferReceive fail\n");
-			break;
-		} // end if
-	} // end while
+			sink_set_connected(param.sink, true);
+		}
 
-	if (sock != -1) {
-		//ESP_LOGE(TAG, "Shutting down socket and restarting...");
-		shutdown(sock, 0);
-		close(sock);
-	}
-	vTaskDelete(NULL);
+		if (batch_len == 0) {
+			// Wait for the first record, then take every record that is already available
+			TickType_t xTicksToWait = portMAX_DELAY;
+			record_count = 0;
+			while (batch_len + TCP_RECORD_SIZE <= sizeof(batch) && record_count < TCP_BATCH_RECORDS) {
+#if TCP_COMPACT_FORMAT
+				size_t received = tcp_receive(param.sink, buffer, sizeof(buffer), xTicksToWait);
+				if (received == 0) break;
+				record_base[record_count] = compact_state.timestamp;
+				record_start[record_count++] = batch_len;
+				batch_len += tcp_encode(&compact_state, &batch[batch_len], sizeof(batch) - batch_len, buffer, received);
+#elif CONFIG_TCP_FORMAT_SYSLOG
+				size_t received = tcp_receive(param.sink, buffer, sizeof(buffer), xTicksToWait);
+				if (received == 0) break;
+				// Each record becomes one syslog message with its length and a space in front (RFC 6587)
+				int message_len = syslog_format_encode(&batch[batch_len], sizeof(batch) - batch_len, buffer, received, true);
+				if (message_len > 0) {
+					record_start[record_count++] = batch_len;
+					batch_len += message_len;
+				}
+#else
+				size_t received = tcp_receive(param.sink, &batch[batch_len], xItemSize, xTicksToWait);
+				if (received == 0) break;
+				//printf("sink_receive buffer=[%.*s]\n",received, &batch[batch_len]);
+				record_start[record_count++] = batch_len;
+				batch_len += received;
+#endif
+				xTicksToWait = 0;
+			}
+#if TCP_COMPRESSION
+			// The whole batch becomes one compressed frame, which is resent as one record
+			int packed_len = compress_frame(&compress_state, packed, sizeof(packed), batch, batch_len);
+			if (packed_len > 0) {
+				memcpy(batch, packed, packed_len);
+				batch_len = packed_len;
+				record_count = 1;
+			}
+#endif
+		}
+
+		while (batch_sent < batch_len) {
+			int ret = send(sock, &batch[batch_sent], batch_len - batch_sent, 0);
+			if (ret < 0) {
+				if (errno == EINTR) continue;
+				printf("Socket send fail: errno %d\n", errno);
+				sink_sent(param.sink, 0, false);
+				shutdown(sock, 0);
+				close(sock);
+				sock = -1;
+				sink_set_connected(param.sink, false);
+				// Resend the partially sent record from its beginning on the next connection
+				for (int i=record_count-1;i>=0;i--) {
+					if (record_start[i] <= batch_sent) {
+						batch_sent = record_start[i];
+						break;
+					}
+				}
+				break;
+			}
+			// Partial write, send the rest
+			batch_sent += ret;
+		}
+		if (batch_sent == batch_len) {
+			// Nothing was sent when every record of the batch was skipped
+			if (batch_len > 0) sink_sent(param.sink, batch_len, true);
+			batch_len = 0;
+			batch_sent = 0;
+		}
+	} // end while
 }
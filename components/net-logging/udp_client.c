@@ -9,24 +9,44 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
-#if CONFIG_USE_RINGBUFFER
-#include "freertos/ringbuf.h"
-#else
-#include "freertos/message_buffer.h"
-#endif
 #include "esp_system.h"
 #include "esp_log.h"
 #include "lwip/sockets.h"
+#if CONFIG_UDP_SEQUENCE
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#include <unistd.h> // getpid
+#else
+#include "esp_random.h"
+#endif
+#endif
 
 #include "net_logging.h"
+#include "sink.h"
+
+// Syslog and GELF messages are text, the compact format and compression apply to ESP log records only
+#define UDP_STRUCTURED_FORMAT (CONFIG_UDP_FORMAT_SYSLOG || CONFIG_UDP_FORMAT_GELF)
+#define UDP_COMPACT_FORMAT (CONFIG_COMPACT_FORMAT && !UDP_STRUCTURED_FORMAT)
+#define UDP_COMPRESSION (CONFIG_COMPRESSION && !UDP_STRUCTURED_FORMAT)
 
-#if CONFIG_USE_RINGBUFFER
-extern RingbufHandle_t xRingBufferTrans;
+#if UDP_STRUCTURED_FORMAT
+#include "structured_format.h"
+#endif
+#if CONFIG_UDP_SEQUENCE
+#include "frame.h"
+#define UDP_SEQUENCE_SIZE SEQUENCE_FRAME_SIZE
 #else
-extern MessageBufferHandle_t xMessageBufferTrans;
+#define UDP_SEQUENCE_SIZE 0
+#endif
+#if UDP_COMPACT_FORMAT
+#include "compact_format.h"
+#endif
+#if UDP_COMPRESSION
+#include "compress.h"
 #endif
 
 void udp_dump(char *id, char *data, int len)
@@ -40,12 +60,156 @@ void udp_dump(char *id, char *data, int len)
   printf("\n");
 }
 
+static SINK_t *udp_sink;
+
+// Wait this long before sending again while the network is not reachable
+#define UDP_RETRY_MS 500
+
+// Send one datagram, the sink is connected while datagrams get out.
+// Before the network is up, the records wait in the fan-out ring.
+static void udp_sendto(int fd, struct sockaddr_in *addr, const char *data, size_t length)
+{
+	while (1) {
+		int ret = lwip_sendto(fd, data, length, 0, (struct sockaddr *)addr, sizeof(*addr));
+		sink_sent(udp_sink, length, ret == length);
+		if (ret == length) {
+			sink_set_connected(udp_sink, true);
+			return;
+		}
+		// Other errors drop the datagram
+		if (errno != ENETUNREACH && errno != EHOSTUNREACH && errno != ENETDOWN) return;
+		sink_set_connected(udp_sink, false);
+		vTaskDelay(pdMS_TO_TICKS(UDP_RETRY_MS));
+	}
+}
+
+#if !UDP_STRUCTURED_FORMAT
+// Largest UDP payload that fits into one Ethernet/WiFi MTU
+#define UDP_PAYLOAD_SIZE 1472
+
+#if CONFIG_UDP_SEQUENCE
+// Put the sequence frame in front of the datagram
+static size_t udp_sequence(char *packet, uint16_t records)
+{
+	// A new boot id tells the server that the sequence starts again
+	static uint32_t boot_id;
+	static uint32_t sequence;
+#if CONFIG_IDF_TARGET_LINUX
+	if (boot_id == 0) boot_id = ((uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16)) | 1;
+#else
+	if (boot_id == 0) boot_id = esp_random() | 1;
+#endif
+	size_t length = SEQUENCE_FRAME_SIZE;
+	packet[0] = FRAME_MARKER;
+	packet[1] = FRAME_TYPE_SEQUENCE;
+	packet[2] = length & 0xff;
+	packet[3] = (length >> 8) & 0xff;
+	memcpy(&packet[FRAME_HEADER_SIZE], &boot_id, sizeof(boot_id));
+	memcpy(&packet[FRAME_HEADER_SIZE + 4], &sequence, sizeof(sequence));
+	memcpy(&packet[FRAME_HEADER_SIZE + 8], &records, sizeof(records));
+	sequence++;
+	return length;
+}
+#endif
+
+// Send one datagram of records, compressed when that makes it smaller
+static void udp_send(int fd, struct sockaddr_in *addr, const char *data, size_t length, uint16_t records)
+{
+#if UDP_COMPRESSION
+	static COMPRESS_STATE_t compress_state;
+	static char packed[UDP_PAYLOAD_SIZE];
+	int packed_len = compress_frame(&compress_state, packed, sizeof(packed) - UDP_SEQUENCE_SIZE, data, length);
+	if (packed_len > 0) {
+		data = packed;
+		length = packed_len;
+	}
+#endif
+#if CONFIG_UDP_SEQUENCE
+	// Records are never longer than one datagram, see NET_LOGGING_ITEM_SIZE
+	static char packet[UDP_PAYLOAD_SIZE + UDP_SEQUENCE_SIZE];
+	size_t header_len = udp_sequence(packet, records);
+	memcpy(&packet[header_len], data, length);
+	data = packet;
+	length += header_len;
+#endif
+	udp_sendto(fd, addr, data, length);
+}
+#endif
+
+#if UDP_STRUCTURED_FORMAT
+// Send one record as one syslog or GELF message
+static void udp_send_structured(int fd, struct sockaddr_in *addr, const char *record, size_t length)
+{
+	static char message[xItemSize + STRUCTURED_FORMAT_OVERHEAD];
+#if CONFIG_UDP_FORMAT_SYSLOG
+	int message_len = syslog_format_encode(message, sizeof(message), record, length, false);
+	if (message_len <= 0) return;
+	udp_sendto(fd, addr, message, message_len);
+#else
+	int message_len = gelf_format_encode(message, sizeof(message), record, length);
+	if (message_len <= 0) return;
+	if (message_len <= GELF_CHUNK_SIZE) {
+		udp_sendto(fd, addr, message, message_len);
+		return;
+	}
+	// Larger messages are chunked, all chunks carry the same id
+	static char chunk[GELF_CHUNK_SIZE];
+	uint8_t id[GELF_MESSAGE_ID_SIZE];
+	gelf_format_message_id(id);
+	int chunk_len;
+	for (int index=0;(chunk_len = gelf_format_chunk(chunk, id, message, message_len, index)) > 0;index++) {
+		udp_sendto(fd, addr, chunk, chunk_len);
+	}
+#endif
+}
+#endif
+
+#if CONFIG_NET_LOGGING_FILTER
+// Look for control packets this often
+#define UDP_CONTROL_POLL_MS 1000
+
+// Apply the filter settings sent back by the logging server
+static void udp_control(int fd, struct sockaddr_in *server)
+{
+	char command[128];
+	struct sockaddr_in from;
+	socklen_t from_len = sizeof(from);
+	int len;
+	while ((len = lwip_recvfrom(fd, command, sizeof(command), MSG_DONTWAIT, (struct sockaddr *)&from, &from_len)) > 0) {
+		// Only the server may change the filter, unless records are broadcast
+		if (server->sin_addr.s_addr == htonl(INADDR_BROADCAST) || from.sin_addr.s_addr == server->sin_addr.s_addr) {
+			net_logging_control(command, len);
+		}
+		from_len = sizeof(from);
+	}
+}
+#endif
+
+#if UDP_COMPACT_FORMAT
+// Convert parsed records to compact records, other records are sent as they are
+static size_t udp_encode(COMPACT_STATE_t *state, char *frame, size_t size, const char *buffer, size_t received)
+{
+	int frame_len = -1;
+	if (compact_format_is_record(buffer, received)) {
+		frame_len = compact_format_encode(state, frame, size, buffer, received);
+		if (frame_len <= 0) frame_len = compact_format_unpack(frame, size, buffer, received);
+	}
+	if (frame_len <= 0) {
+		memcpy(frame, buffer, received);
+		frame_len = received;
+	}
+	return frame_len;
+}
+#endif
+
 // UDP Client Task
 void udp_client(void *pvParameters) {
 	PARAMETER_t *task_parameter = pvParameters;
 	PARAMETER_t param;
 	memcpy((char *)&param, task_parameter, sizeof(PARAMETER_t));
+	free(task_parameter);
 	//printf("Start:param.port=%d param.ipv4=[%s]\n", param.port, param.ipv4);
+	udp_sink = param.sink;
 
 	struct sockaddr_in addr;
 	memset(&addr, 0, sizeof(addr));
@@ -61,26 +225,101 @@ void udp_client(void *pvParameters) {
 	fd = lwip_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP ); // Create a UDP socket.
 	LWIP_ASSERT("fd >= 0", fd >= 0);
 
-	// Send ready to receive notify
-	xTaskNotifyGive(param.taskHandle);
+#if CONFIG_UDP_BATCH
+	// Records are packed into one datagram until it is full or the linger time expires
+	char datagram[CONFIG_UDP_BATCH_SIZE - UDP_SEQUENCE_SIZE];
+	size_t datagram_len = 0;
+	uint16_t datagram_records = 0;
+	TickType_t linger_ticks = pdMS_TO_TICKS(CONFIG_UDP_BATCH_LINGER_MS);
+	if (linger_ticks == 0) linger_ticks = 1;
+	TickType_t linger_start = 0;
+#endif
+
+#if UDP_COMPACT_FORMAT
+	// Each datagram carries its own tag dictionary and timestamp base
+	static COMPACT_STATE_t compact_state;
+	compact_format_reset(&compact_state);
+	static char frame[xItemSize + COMPACT_FORMAT_OVERHEAD];
+#endif
+
+#if CONFIG_NET_LOGGING_FILTER
+	TickType_t poll_ticks = pdMS_TO_TICKS(UDP_CONTROL_POLL_MS);
+	TickType_t poll_start = xTaskGetTickCount();
+#endif
 
 	while(1) {
-#if CONFIG_USE_RINGBUFFER
-		size_t received;
-		char *buffer = (char *)xRingbufferReceive(xRingBufferTrans, &received, portMAX_DELAY);
-		//printf("xRingBufferReceive received=%d\n", received);
-#else
-		char buffer[xItemSize];
-		size_t received = xMessageBufferReceive(xMessageBufferTrans, buffer, sizeof(buffer), portMAX_DELAY);
-		//printf("xMessageBufferReceive received=%d\n", received);
+		TickType_t xTicksToWait = portMAX_DELAY;
+#if CONFIG_UDP_BATCH
+		if (datagram_len) {
+			TickType_t elapsed = xTaskGetTickCount() - linger_start;
+			xTicksToWait = (elapsed < linger_ticks) ? linger_ticks - elapsed : 0;
+		}
 #endif
+#if CONFIG_NET_LOGGING_FILTER
+		// Control packets arrive on the sending socket
+		TickType_t poll_elapsed = xTaskGetTickCount() - poll_start;
+		if (poll_elapsed >= poll_ticks) {
+			udp_control(fd, &addr);
+			poll_start = xTaskGetTickCount();
+			poll_elapsed = 0;
+		}
+		if (xTicksToWait > poll_ticks - poll_elapsed) xTicksToWait = poll_ticks - poll_elapsed;
+#endif
+		char buffer[xItemSize];
+		size_t received = sink_receive(param.sink, buffer, sizeof(buffer), xTicksToWait);
 		if (received > 0) {
 			//printf("xMessageBufferReceive buffer=[%.*s]\n",received, buffer);
 			//udp_dump("buffer", buffer, received);
-			ret = lwip_sendto(fd, buffer, received, 0, (struct sockaddr *)&addr, sizeof(addr));
-			LWIP_ASSERT("ret == received", ret == received);
-#if CONFIG_USE_RINGBUFFER
-			vRingbufferReturnItem(xRingBufferTrans, (void *)buffer);
+#if UDP_STRUCTURED_FORMAT
+			udp_send_structured(fd, &addr, buffer, received);
+#else
+			char *record = buffer;
+			size_t record_len = received;
+#if UDP_COMPACT_FORMAT
+			record = frame;
+			record_len = udp_encode(&compact_state, frame, sizeof(frame), buffer, received);
+#endif
+#if CONFIG_UDP_BATCH
+			// Flush when the record does not fit into the current datagram
+			if (datagram_len && datagram_len + record_len > sizeof(datagram)) {
+				udp_send(fd, &addr, datagram, datagram_len, datagram_records);
+				datagram_len = 0;
+				datagram_records = 0;
+#if UDP_COMPACT_FORMAT
+				compact_format_reset(&compact_state);
+				record_len = udp_encode(&compact_state, frame, sizeof(frame), buffer, received);
+#endif
+			}
+			if (record_len > sizeof(datagram)) {
+				// A record larger than one datagram is sent alone
+				udp_send(fd, &addr, record, record_len, 1);
+#if UDP_COMPACT_FORMAT
+				compact_format_reset(&compact_state);
+#endif
+				continue;
+			}
+			if (datagram_len == 0) linger_start = xTaskGetTickCount();
+			memcpy(&datagram[datagram_len], record, record_len);
+			datagram_len += record_len;
+			datagram_records++;
+#else
+			udp_send(fd, &addr, record, record_len, 1);
+#if UDP_COMPACT_FORMAT
+			compact_format_reset(&compact_state);
+#endif
+#endif
+#endif
+		} else if (xTicksToWait != portMAX_DELAY) {
+#if CONFIG_UDP_BATCH
+			// Linger time expired
+			if (datagram_len) {
+				udp_send(fd, &addr, datagram, datagram_len, datagram_records);
+				datagram_len = 0;
+				datagram_records = 0;
+#if UDP_COMPACT_FORMAT
+				compact_format_reset(&compact_state);
+#endif
+			}
 #endif
 		} else {
 			printf("xMessageBufferReceive fail\n");
@@ -0,0 +1,423 @@
+/*
+	Log storm benchmark
+
+	Logging threads call ESP_LOGI as fast as they can, or at a given rate.
+	The records go through logging_vprintf, the buffer, the dispatcher and
+	the UDP, TCP or MQTT sender to a stand-in server on the loopback interface.
+	For MQTT the server is a broker that acknowledges the publishes of QoS 1 and 2.
+	It reports the caller latency, the records per second and the drops.
+	With -s the records are also mirrored to STDOUT, which is line buffered like a console
+	and goes to /dev/null during the storm, so the cost of the mirror shows in the caller latency.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include "lwip/sockets.h"
+
+// Before net_logging.h, whose xBufferSizeBytes is also a parameter name in them
+#if CONFIG_USE_SLAB_POOL
+#include "freertos/message_buffer.h"
+#include "freertos/ringbuf.h"
+#include "slab_pool.h"
+#endif
+
+#include "net_logging.h"
+
+#define TAG "BENCH"
+#define SETTLE_MS 2000
+#if CONFIG_NET_LOGGING_STDOUT_ASYNC
+#define STDOUT_MODE "async"
+#else
+#define STDOUT_MODE "sync"
+#endif
+
+static const char padding[] = "................................................................................................................................................................................................................................................................";
+
+typedef enum {
+	PROTOCOL_UDP,
+	PROTOCOL_TCP,
+	PROTOCOL_MQTT,
+} PROTOCOL_t;
+
+static const char *protocol_names[] = { "udp", "tcp", "mqtt" };
+
+static struct {
+	int threads;
+	int records;
+	int length; // Length of the message part of each record
+	int rate; // Records per second of each thread, 0 for no limit
+	PROTOCOL_t protocol;
+	bool mirror; // Mirror the records to STDOUT
+	size_t buffer_size;
+} bench = {
+	.threads = 4,
+	.records = 20000,
+	.length = 40,
+	.rate = 0,
+	.protocol = PROTOCOL_UDP,
+	.buffer_size = xBufferSizeBytes,
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Stand-in server
+
+static struct {
+	int listen_fd;
+	int fd;
+	uint16_t port;
+	uint32_t delivered; // Records of the benchmark received
+	uint32_t packets; // Datagrams, reads of the TCP stream or publishes
+	uint64_t bytes; // Payload bytes for MQTT
+	char line[xItemSize * 2];
+	size_t line_len;
+	uint8_t frame[65536]; // MQTT packet being received
+	size_t frame_len;
+} server;
+
+// Count the records of the benchmark, a record may arrive in pieces over TCP
+static void server_feed(const char *data, size_t length)
+{
+	for (size_t i=0;i<length;i++) {
+		if (server.line_len < sizeof(server.line) - 1) server.line[server.line_len++] = data[i];
+		if (data[i] != '\n') continue;
+		server.line[server.line_len] = 0;
+		if (strstr(server.line, " " TAG ": ")) __atomic_fetch_add(&server.delivered, 1, __ATOMIC_RELAXED);
+		server.line_len = 0;
+	}
+}
+
+static void broker_reply(int fd, uint8_t type, const uint8_t *msg_id)
+{
+	uint8_t reply[4] = { type, 2, 0, 0 };
+	if (msg_id) memcpy(&reply[2], msg_id, 2);
+	send(fd, reply, sizeof(reply), MSG_NOSIGNAL);
+}
+
+// Handles the complete packets of the frame buffer
+static void broker_packets(int fd)
+{
+	size_t pos = 0;
+	while (1) {
+		// Fixed header with the remaining length
+		size_t remaining = 0;
+		size_t header = 1;
+		bool complete = false;
+		for (int shift=0; pos+header<server.frame_len && shift<28; shift+=7) {
+			uint8_t byte = server.frame[pos + header++];
+			remaining |= (size_t)(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) {
+				complete = true;
+				break;
+			}
+		}
+		if (complete == false || pos + header + remaining > server.frame_len) break;
+		uint8_t type = server.frame[pos];
+		uint8_t *body = &server.frame[pos + header];
+		pos += header + remaining;
+		switch (type & 0xf0) {
+			case 0x10: // CONNECT
+				broker_reply(fd, 0x20, NULL);
+				break;
+			case 0x30: { // PUBLISH
+				int qos = (type >> 1) & 3;
+				size_t offset = 2 + ((body[0] << 8) | body[1]);
+				if (qos == 1) broker_reply(fd, 0x40, &body[offset]);
+				if (qos == 2) broker_reply(fd, 0x50, &body[offset]);
+				if (qos) offset += 2;
+				__atomic_fetch_add(&server.bytes, remaining - offset, __ATOMIC_RELAXED);
+				__atomic_fetch_add(&server.packets, 1, __ATOMIC_RELAXED);
+				server_feed((const char *)&body[offset], remaining - offset);
+				server_feed("\n", 1);
+				break;
+			}
+			case 0x60: // PUBREL
+				broker_reply(fd, 0x70, body);
+				break;
+			default:
+				break;
+		}
+	}
+	memmove(server.frame, &server.frame[pos], server.frame_len - pos);
+	server.frame_len -= pos;
+}
+
+// Stand-in broker: the records of each payload are separated by LF, without a trailing LF
+static void broker_feed(int fd, const char *data, size_t length)
+{
+	while (length) {
+		size_t copy = sizeof(server.frame) - server.frame_len;
+		if (copy > length) copy = length;
+		memcpy(&server.frame[server.frame_len], data, copy);
+		server.frame_len += copy;
+		data += copy;
+		length -= copy;
+		broker_packets(fd);
+	}
+}
+
+static void *server_main(void *arg)
+{
+	int fd = server.fd;
+	if (bench.protocol != PROTOCOL_UDP) {
+		fd = accept(server.listen_fd, NULL, NULL);
+		if (fd < 0) return NULL;
+	}
+	char data[65536];
+	while (1) {
+		ssize_t received = recv(fd, data, sizeof(data), 0);
+		if (received <= 0) break;
+		if (bench.protocol == PROTOCOL_MQTT) {
+			broker_feed(fd, data, received);
+			continue;
+		}
+		__atomic_fetch_add(&server.bytes, received, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&server.packets, 1, __ATOMIC_RELAXED);
+		server_feed(data, received);
+	}
+	return NULL;
+}
+
+static void server_start(void)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int fd = socket(AF_INET, (bench.protocol == PROTOCOL_UDP) ? SOCK_DGRAM : SOCK_STREAM, 0);
+	// A large receive buffer, so that the server is not the bottleneck
+	int rcvbuf = 8 * 1024 * 1024;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		perror("bind");
+		exit(1);
+	}
+	socklen_t addr_len = sizeof(addr);
+	getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+	server.port = ntohs(addr.sin_port);
+	if (bench.protocol != PROTOCOL_UDP) {
+		listen(fd, 1);
+		server.listen_fd = fd;
+	} else {
+		server.fd = fd;
+	}
+	pthread_t thread;
+	pthread_create(&thread, NULL, server_main, NULL);
+	pthread_detach(thread);
+}
+
+#if CONFIG_USE_SLAB_POOL
+// Records of the benchmark that fit into the same memory in each kind of buffer, before the pipeline starts
+static void capacity(void)
+{
+	char record[xItemSize];
+	int length = snprintf(record, sizeof(record), LOG_FORMAT(I, "thread %d record %d %.*s"), esp_log_timestamp(), TAG, 0, 0, bench.length, padding);
+	if (length >= sizeof(record)) length = sizeof(record) - 1;
+	uint8_t *storage = malloc(bench.buffer_size + 1);
+	if (storage == NULL) return;
+
+	StaticMessageBuffer_t message_struct;
+	MessageBufferHandle_t message_buffer = xMessageBufferCreateStatic(bench.buffer_size, storage, &message_struct);
+	int message_count = 0;
+	while (xMessageBufferSend(message_buffer, record, length, 0)) message_count++;
+
+	StaticRingbuffer_t ring_struct;
+	RingbufHandle_t ring = xRingbufferCreateStatic(bench.buffer_size, RINGBUF_TYPE_NOSPLIT, storage, &ring_struct);
+	int ring_count = 0;
+	while (xRingbufferSend(ring, record, length, 0)) ring_count++;
+	free(storage);
+
+	// The pool is created again by the pipeline
+	int slab_count = 0;
+	if (slab_pool_create(bench.buffer_size, xItemSize, 0)) {
+		while (slab_pool_send(record, length)) slab_count++;
+	}
+	printf("capacity of %zu bytes for %d-byte records: slab pool=%d message buffer=%d ringbuffer=%d\n",
+		bench.buffer_size, length, slab_count, message_count, ring_count);
+}
+#endif
+
+// Logging threads
+
+typedef struct {
+	int id;
+	uint32_t *latency_ns;
+} PRODUCER_t;
+
+static void *producer_main(void *arg)
+{
+	PRODUCER_t *producer = arg;
+	uint64_t start = now_ns();
+	uint64_t interval = bench.rate ? 1000000000ULL / bench.rate : 0;
+	for (int i=0;i<bench.records;i++) {
+		if (interval) {
+			// Pace the records, the time of each record is fixed in advance
+			uint64_t due = start + i * interval;
+			uint64_t now = now_ns();
+			if (due > now) {
+				struct timespec delay = { .tv_sec = (due - now) / 1000000000, .tv_nsec = (due - now) % 1000000000 };
+				nanosleep(&delay, NULL);
+			}
+		}
+		uint64_t before = now_ns();
+		ESP_LOGI(TAG, "thread %d record %d %.*s", producer->id, i, bench.length, padding);
+		uint64_t elapsed = now_ns() - before;
+		producer->latency_ns[i] = (elapsed > UINT32_MAX) ? UINT32_MAX : elapsed;
+	}
+	return NULL;
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-p udp|tcp|mqtt] [-t threads] [-n records per thread] [-l message length] [-r records per second per thread] [-b buffer size] [-s]\n", name);
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "p:t:n:l:r:b:s")) != -1) {
+		switch (opt) {
+			case 'p':
+				if (strcmp(optarg, "tcp") == 0) bench.protocol = PROTOCOL_TCP;
+				else if (strcmp(optarg, "mqtt") == 0) bench.protocol = PROTOCOL_MQTT;
+				else bench.protocol = PROTOCOL_UDP;
+				break;
+			case 't': bench.threads = atoi(optarg); break;
+			case 'n': bench.records = atoi(optarg); break;
+			case 'l': bench.length = atoi(optarg); break;
+			case 'r': bench.rate = atoi(optarg); break;
+			case 'b': bench.buffer_size = atoi(optarg); break;
+			case 's': bench.mirror = true; break;
+			default: usage(argv[0]);
+		}
+	}
+	if (bench.threads <= 0 || bench.records <= 0 || bench.length < 0 || bench.length > 256) usage(argv[0]);
+	// Before anything is written, as a console flushes every line
+	if (bench.mirror) setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+
+#if CONFIG_USE_SLAB_POOL
+	capacity();
+#endif
+	server_start();
+	NET_LOGGING_CONFIG_t config = NET_LOGGING_CONFIG_DEFAULT();
+	config.buffer_size = bench.buffer_size;
+	if (net_logging_configure(&config) != ESP_OK) usage(argv[0]);
+	esp_err_t ret;
+	if (bench.protocol == PROTOCOL_TCP) {
+		ret = tcp_logging_init("127.0.0.1", server.port, bench.mirror);
+#if CONFIG_ENABLE_MQTT_LOG
+	} else if (bench.protocol == PROTOCOL_MQTT) {
+		char url[32];
+		snprintf(url, sizeof(url), "mqtt://127.0.0.1:%u", server.port);
+		ret = mqtt_logging_init(url, "/bench/logging", bench.mirror);
+#endif
+	} else {
+		ret = udp_logging_init("127.0.0.1", server.port, bench.mirror);
+	}
+	if (ret != ESP_OK) {
+		printf("logging init fail %d\n", ret);
+		return 1;
+	}
+	// Let the sender connect
+	vTaskDelay(pdMS_TO_TICKS(200));
+	// The mirrored records go to /dev/null, the results to the real STDOUT
+	FILE *report = stdout;
+	if (bench.mirror) {
+		fflush(stdout);
+		report = fdopen(dup(STDOUT_FILENO), "w");
+		int null = open("/dev/null", O_WRONLY);
+		if (report == NULL || null < 0) return 1;
+		dup2(null, STDOUT_FILENO);
+		close(null);
+	}
+
+	pthread_t threads[bench.threads];
+	PRODUCER_t producers[bench.threads];
+	uint32_t *latency = malloc(sizeof(uint32_t) * bench.threads * bench.records);
+	if (latency == NULL) return 1;
+	uint64_t start = now_ns();
+	for (int i=0;i<bench.threads;i++) {
+		producers[i].id = i;
+		producers[i].latency_ns = &latency[i * bench.records];
+		pthread_create(&threads[i], NULL, producer_main, &producers[i]);
+	}
+	for (int i=0;i<bench.threads;i++) {
+		pthread_join(threads[i], NULL);
+	}
+	uint64_t elapsed = now_ns() - start;
+
+	// Wait until the senders have nothing more to send
+	uint32_t delivered = 0;
+	uint64_t settle_start = now_ns();
+	while (now_ns() - settle_start < SETTLE_MS * 1000000ULL) {
+		vTaskDelay(pdMS_TO_TICKS(100));
+		uint32_t now = __atomic_load_n(&server.delivered, __ATOMIC_RELAXED);
+		if (now == delivered && now) break;
+		delivered = now;
+	}
+	uint64_t delivered_elapsed = now_ns() - start;
+	delivered = __atomic_load_n(&server.delivered, __ATOMIC_RELAXED);
+
+	NET_LOGGING_STATS_t stats;
+	net_logging_get_stats(&stats);
+	uint32_t lost = 0;
+	for (int i=0;i<stats.sink_count;i++) {
+		if (strcmp(stats.sinks[i].name, "STDOUT")) lost += stats.sinks[i].lost;
+	}
+
+	size_t total = (size_t)bench.threads * bench.records;
+	qsort(latency, total, sizeof(uint32_t), compare_latency);
+	fprintf(report, "protocol=%s threads=%d records=%zu length=%d rate=%d buffer=%zu stdout=%s\n",
+		protocol_names[bench.protocol], bench.threads, total, bench.length, bench.rate, bench.buffer_size, bench.mirror ? STDOUT_MODE : "off");
+	fprintf(report, "caller latency us: p50=%.2f p99=%.2f max=%.2f\n",
+		latency[total / 2] / 1000.0, latency[total * 99 / 100] / 1000.0, latency[total - 1] / 1000.0);
+	fprintf(report, "logged records/s=%.0f delivered records/s=%.0f delivered bytes=%"PRIu64"\n",
+		total * 1e9 / elapsed, delivered * 1e9 / delivered_elapsed, server.bytes);
+	// Over TCP, the packets are only the reads of the server
+	static const char *packet_names[] = { "datagrams", "reads", "publishes" };
+	fprintf(report, "%s=%"PRIu32" packets/s=%.0f bytes/s=%.0f records/packet=%.1f\n", packet_names[bench.protocol],
+		server.packets, server.packets * 1e9 / delivered_elapsed, server.bytes * 1e9 / delivered_elapsed,
+		server.packets ? (double)delivered / server.packets : 0.0);
+	fprintf(report, "enqueued=%"PRIu32" dropped=%"PRIu32" (%.2f%%) sink lost=%"PRIu32" delivered=%"PRIu32" (%.2f%%)\n",
+		stats.enqueued, stats.dropped, stats.dropped * 100.0 / total, lost, delivered, delivered * 100.0 / total);
+
+	// Every record is either in the buffer or counted as dropped
+	int result = 0;
+	if (stats.enqueued < total - stats.dropped || delivered == 0) {
+		fprintf(report, "FAIL: records are not accounted for\n");
+		result = 1;
+	}
+	// TCP and MQTT deliver everything that the fan-out ring kept
+	if (bench.protocol != PROTOCOL_UDP && delivered + stats.dropped + lost < total) {
+		fprintf(report, "FAIL: %s lost records\n", protocol_names[bench.protocol]);
+		result = 1;
+	}
+	free(latency);
+	fflush(report);
+	return result;
+}
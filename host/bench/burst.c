@@ -0,0 +1,133 @@
+/*
+	Burst absorption benchmark
+
+	One thread logs a fixed burst of records as fast as it can, as during boot or a WiFi reconnect,
+	once for each buffer size given on the command line, each time in a new process.
+	It reports the records absorbed before the first drop and the records dropped in the whole burst.
+	The dispatcher drains the buffer during the burst, so at least a full buffer must be absorbed.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include "lwip/sockets.h"
+
+#include "net_logging.h"
+
+#define TAG "BURST"
+// The level, the timestamp, the tag and the colors of a record, at most
+#define PREFIX_MAX 64
+
+static const char padding[] = "................................................................................................................................................................................................................................................................";
+
+static struct {
+	int records;
+	int length; // Length of the message part of each record
+} bench = {
+	.records = 4000,
+	.length = 40,
+};
+
+static uint32_t dropped_records(void)
+{
+	NET_LOGGING_DROPPED_t dropped;
+	net_logging_get_dropped(&dropped);
+	uint32_t total = 0;
+	for (int level=0; level<=ESP_LOG_VERBOSE; level++) total += dropped.records[level];
+	return total;
+}
+
+// A port that receives the datagrams but is never read, the kernel drops them when its queue is full
+static uint16_t server_port(void)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) return 0;
+	socklen_t addr_len = sizeof(addr);
+	getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+	return ntohs(addr.sin_port);
+}
+
+// Runs in a process of its own, as the buffer is created once
+static int burst(size_t buffer_size)
+{
+	uint16_t port = server_port();
+	if (port == 0) return 1;
+	NET_LOGGING_CONFIG_t config = NET_LOGGING_CONFIG_DEFAULT();
+	config.buffer_size = buffer_size;
+	if (net_logging_configure(&config) != ESP_OK) return 2;
+	if (udp_logging_init("127.0.0.1", port, false) != ESP_OK) return 1;
+	// Let the sender start
+	vTaskDelay(pdMS_TO_TICKS(200));
+
+	int absorbed = bench.records;
+	for (int i=0;i<bench.records;i++) {
+		ESP_LOGI(TAG, "burst record %05d %.*s", i, bench.length, padding);
+		if (absorbed == bench.records && dropped_records()) absorbed = i;
+	}
+	NET_LOGGING_STATS_t stats;
+	net_logging_get_stats(&stats);
+	// Every record is at most this long in the buffer
+	size_t record_max = PREFIX_MAX + 20 + bench.length + sizeof(size_t);
+	int capacity = stats.buffer_size / record_max;
+	printf("buffer=%"PRIu32" burst=%d absorbed=%d dropped=%"PRIu32" (%.1f%%) high water=%"PRIu32" (at least %d absorbed)\n",
+		stats.buffer_size, bench.records, absorbed, stats.dropped, stats.dropped * 100.0 / bench.records,
+		stats.buffer_high_water, capacity);
+	if (absorbed < capacity && absorbed < bench.records) {
+		printf("FAIL: the burst was dropped before the buffer was full\n");
+		return 1;
+	}
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-n records] [-l message length] [buffer size...]\n", name);
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "n:l:")) != -1) {
+		switch (opt) {
+			case 'n': bench.records = atoi(optarg); break;
+			case 'l': bench.length = atoi(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (bench.records <= 0 || bench.length < 0 || bench.length > 128) usage(argv[0]);
+	static const char *default_sizes[] = { "1024", "4096", "16384", "65536" };
+	const char **sizes = (const char **)&argv[optind];
+	int size_count = argc - optind;
+	if (size_count == 0) {
+		sizes = default_sizes;
+		size_count = sizeof(default_sizes) / sizeof(default_sizes[0]);
+	}
+
+	int result = 0;
+	for (int i=0;i<size_count;i++) {
+		size_t buffer_size = atoi(sizes[i]);
+		fflush(stdout);
+		pid_t pid = fork();
+		if (pid < 0) return 1;
+		if (pid == 0) exit(burst(buffer_size));
+		int status;
+		waitpid(pid, &status, 0);
+		if (WIFEXITED(status) == false || WEXITSTATUS(status) == 2) usage(argv[0]);
+		if (WEXITSTATUS(status)) result = 1;
+	}
+	return result;
+}
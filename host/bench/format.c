@@ -0,0 +1,102 @@
+/*
+	Deferred format benchmark
+
+	Time of the caller per record, formatting with vsnprintf or packing a deferred record.
+	Cycles are counted with the time stamp counter on x86, otherwise only the time is reported.
+	Build with -no-pie, so that the format strings have 4-byte addresses as in flash.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#endif
+
+#include "esp_log.h"
+#include "deferred_format.h"
+
+#define RECORD_SIZE 256
+
+static int iterations = 200000;
+
+typedef int (*FORMAT_t)(char *record, size_t size, const char *fmt, va_list l);
+
+static int format_vsnprintf(char *record, size_t size, const char *fmt, va_list l)
+{
+	return vsnprintf(record, size, fmt, l);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Run one format many times, as logging_vprintf does: copy the va_list and format into a stack buffer
+static void measure(const char *name, FORMAT_t format, double *ns, double *cycles, const char *fmt, ...)
+{
+	char record[RECORD_SIZE];
+	va_list l;
+	va_start(l, fmt);
+	int length = 0;
+	uint64_t start = now_ns();
+#ifdef CYCLES
+	uint64_t start_cycles = CYCLES();
+#endif
+	for (int i=0;i<iterations;i++) {
+		va_list args;
+		va_copy(args, l);
+		length = format(record, sizeof(record), fmt, args);
+		va_end(args);
+		// Keep the compiler from dropping the record
+		__asm__ volatile("" : : "r"(record) : "memory");
+	}
+#ifdef CYCLES
+	*cycles = (double)(CYCLES() - start_cycles) / iterations;
+#else
+	*cycles = 0;
+#endif
+	*ns = (double)(now_ns() - start) / iterations;
+	va_end(l);
+	if (length <= 0) {
+		printf("%s failed for \"%s\"\n", name, fmt);
+		exit(1);
+	}
+}
+
+#define MEASURE(label, fmt, ...) do { \
+	double text_ns, text_cycles, deferred_ns, deferred_cycles; \
+	measure("vsnprintf", format_vsnprintf, &text_ns, &text_cycles, fmt, ##__VA_ARGS__); \
+	measure("deferred_format_pack", deferred_format_pack, &deferred_ns, &deferred_cycles, fmt, ##__VA_ARGS__); \
+	printf("%-12s %10.1f %10.1f %10.1f %10.1f %8.1fx\n", label, text_ns, deferred_ns, text_cycles, deferred_cycles, text_ns / deferred_ns); \
+} while(0)
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1) iterations = atoi(argv[1]);
+	if (iterations <= 0) {
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return 2;
+	}
+	printf("%-12s %10s %10s %10s %10s %9s\n", "record", "text ns", "defer ns", "text cyc", "defer cyc", "speedup");
+	// The records of ESP_LOGI, with the timestamp and the tag as the first arguments
+	MEASURE("no args", LOG_FORMAT(I, "wifi connected"), 123456, "wifi");
+	MEASURE("ints", LOG_FORMAT(I, "free heap %d, min %d, largest %u"), 123456, "heap", 204800, 150000, 65536u);
+	MEASURE("hex", LOG_FORMAT(D, "reg 0x%08x = 0x%08x"), 123456, "i2c", 0x3ff44000, 0xdeadbeef);
+	MEASURE("string", LOG_FORMAT(W, "%s: %s"), 123456, "mqtt", "/esp32/logging", "connection refused");
+	MEASURE("long long", LOG_FORMAT(I, "uptime %lld us"), 123456, "main", 123456789012LL);
+	MEASURE("double", LOG_FORMAT(I, "temperature %.2f humidity %.1f"), 123456, "sensor", 23.456, 45.5);
+	return 0;
+}
@@ -0,0 +1,165 @@
+/*
+	Producer benchmark of the IPC
+
+	1, 2 and N logging threads send records into the shared message buffer
+	and into the per-core rings, while one consumer drains them.
+	It reports the time of each send in ns per record, averaged over the threads.
+	The threads are spread over the cores of the shim, so with the per-core rings
+	two threads on different cores do not take the same lock.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/message_buffer.h"
+#include "esp_log.h"
+#include "percore_ring.h"
+
+#define RECORD_LENGTH 80
+#define RECORD_MAX 256
+
+typedef struct {
+	const char *name;
+	bool (*send)(const void *data, size_t length);
+	size_t (*receive)(void *buffer, size_t size, TickType_t xTicksToWait);
+} IPC_t;
+
+static MessageBufferHandle_t message_buffer;
+
+static bool message_buffer_send(const void *data, size_t length)
+{
+	// As logging_vprintf sends, without waiting
+	return xMessageBufferSendFromISR(message_buffer, data, length, NULL) == length;
+}
+
+static size_t message_buffer_receive(void *buffer, size_t size, TickType_t xTicksToWait)
+{
+	return xMessageBufferReceive(message_buffer, buffer, size, xTicksToWait);
+}
+
+static const IPC_t ipcs[] = {
+	{ "message buffer", message_buffer_send, message_buffer_receive },
+	{ "per-core ring", percore_ring_send, percore_ring_receive },
+};
+
+static struct {
+	int threads;
+	int records;
+	const IPC_t *ipc;
+	uint32_t dropped;
+	uint32_t received;
+	bool done;
+} bench = {
+	.threads = 4,
+	.records = 20000,
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void *producer_main(void *arg)
+{
+	uint64_t *elapsed = arg;
+	char record[RECORD_LENGTH];
+	memset(record, '.', sizeof(record));
+	uint64_t start = now_ns();
+	for (int i=0;i<bench.records;i++) {
+		memcpy(record, &i, sizeof(i));
+		if (bench.ipc->send(record, sizeof(record)) == false) __atomic_fetch_add(&bench.dropped, 1, __ATOMIC_RELAXED);
+	}
+	*elapsed = now_ns() - start;
+	return NULL;
+}
+
+static void *consumer_main(void *arg)
+{
+	char record[RECORD_MAX];
+	while (1) {
+		if (bench.ipc->receive(record, sizeof(record), 1)) {
+			bench.received++;
+		} else if (__atomic_load_n(&bench.done, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+// Mean ns per record of the producers
+static double run(const IPC_t *ipc, int threads)
+{
+	bench.ipc = ipc;
+	bench.dropped = 0;
+	bench.received = 0;
+	bench.done = false;
+	pthread_t consumer;
+	pthread_create(&consumer, NULL, consumer_main, NULL);
+	pthread_t producers[threads];
+	uint64_t elapsed[threads];
+	for (int i=0;i<threads;i++) pthread_create(&producers[i], NULL, producer_main, &elapsed[i]);
+	uint64_t total = 0;
+	for (int i=0;i<threads;i++) {
+		pthread_join(producers[i], NULL);
+		total += elapsed[i];
+	}
+	__atomic_store_n(&bench.done, true, __ATOMIC_RELEASE);
+	pthread_join(consumer, NULL);
+	return (double)total / threads / bench.records;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t threads] [-n records per thread]\n", name);
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "t:n:")) != -1) {
+		switch (opt) {
+			case 't': bench.threads = atoi(optarg); break;
+			case 'n': bench.records = atoi(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (bench.threads < 2 || bench.records <= 0) usage(argv[0]);
+
+	// Large enough that the producers never wait for the consumer
+	size_t buffer_size = (size_t)bench.threads * bench.records * (RECORD_LENGTH + 16);
+	uint8_t *storage = malloc(buffer_size + 1);
+	static StaticMessageBuffer_t message_buffer_struct;
+	message_buffer = xMessageBufferCreateStatic(buffer_size, storage, &message_buffer_struct);
+	if (storage == NULL || percore_ring_create(buffer_size, 0) == false) return 1;
+
+	int result = 0;
+	int thread_counts[] = { 1, 2, bench.threads };
+	for (int i=0;i<sizeof(ipcs)/sizeof(ipcs[0]);i++) {
+		for (int j=0;j<3;j++) {
+			if (j == 2 && bench.threads == 2) break;
+			double ns = run(&ipcs[i], thread_counts[j]);
+			uint32_t total = thread_counts[j] * bench.records;
+			printf("ipc=%s threads=%d records=%"PRIu32" ns/record=%.0f dropped=%"PRIu32"\n",
+				ipcs[i].name, thread_counts[j], total, ns, bench.dropped);
+			if (bench.received + bench.dropped != total) {
+				printf("FAIL: %"PRIu32" records received\n", bench.received);
+				result = 1;
+			}
+		}
+	}
+	return result;
+}
@@ -0,0 +1,70 @@
+#ifndef SDKCONFIG_H_
+#define SDKCONFIG_H_
+
+// The defaults of Kconfig.projbuild for the linux target.
+// Each program of the host build overrides them with compile definitions.
+
+#define CONFIG_IDF_TARGET_LINUX 1
+
+#ifndef CONFIG_LOG_COLORS
+#define CONFIG_LOG_COLORS 1
+#endif
+#ifndef CONFIG_NET_LOGGING_STDOUT_ASYNC
+#define CONFIG_NET_LOGGING_STDOUT_ASYNC 0
+#endif
+#ifndef CONFIG_UDP_BATCH_SIZE
+#define CONFIG_UDP_BATCH_SIZE 1472
+#endif
+#ifndef CONFIG_UDP_BATCH_LINGER_MS
+#define CONFIG_UDP_BATCH_LINGER_MS 5
+#endif
+#ifndef CONFIG_TCP_BATCH_SIZE
+#define CONFIG_TCP_BATCH_SIZE 2920
+#endif
+#ifndef CONFIG_MQTT_QOS
+#define CONFIG_MQTT_QOS 1
+#endif
+#ifndef CONFIG_MQTT_BATCH_SIZE
+#define CONFIG_MQTT_BATCH_SIZE 2048
+#endif
+#ifndef CONFIG_NET_LOGGING_SYSLOG_FACILITY
+#define CONFIG_NET_LOGGING_SYSLOG_FACILITY 16
+#endif
+#ifndef CONFIG_NET_LOGGING_BUFFER_SIZE
+#define CONFIG_NET_LOGGING_BUFFER_SIZE 1024
+#endif
+#ifndef CONFIG_NET_LOGGING_ITEM_SIZE
+#define CONFIG_NET_LOGGING_ITEM_SIZE 256
+#endif
+#ifndef CONFIG_NET_LOGGING_LONG_RECORD_SIZE
+#define CONFIG_NET_LOGGING_LONG_RECORD_SIZE 2048
+#endif
+#ifndef CONFIG_OVERFLOW_BLOCK_TIMEOUT_MS
+#define CONFIG_OVERFLOW_BLOCK_TIMEOUT_MS 100
+#endif
+#ifndef CONFIG_NET_LOGGING_EARLY_CAPTURE_SIZE
+#define CONFIG_NET_LOGGING_EARLY_CAPTURE_SIZE 4096
+#endif
+#ifndef CONFIG_NET_LOGGING_SPOOL_PARTITION
+#define CONFIG_NET_LOGGING_SPOOL_PARTITION "netlog"
+#endif
+#ifndef CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE
+#define CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE 8192
+#endif
+#ifndef CONFIG_NET_LOGGING_FILTER_TAGS
+#define CONFIG_NET_LOGGING_FILTER_TAGS 32
+#endif
+#ifndef CONFIG_NET_LOGGING_RATE_LIMIT_RATE
+#define CONFIG_NET_LOGGING_RATE_LIMIT_RATE 20
+#endif
+#ifndef CONFIG_NET_LOGGING_RATE_LIMIT_BURST
+#define CONFIG_NET_LOGGING_RATE_LIMIT_BURST 50
+#endif
+#ifndef CONFIG_NET_LOGGING_RATE_LIMIT_TAGS
+#define CONFIG_NET_LOGGING_RATE_LIMIT_TAGS 32
+#endif
+#ifndef CONFIG_NET_LOGGING_STATS_INTERVAL
+#define CONFIG_NET_LOGGING_STATS_INTERVAL 60
+#endif
+
+#endif /* SDKCONFIG_H_ */
@@ -0,0 +1,8 @@
+#ifndef ESP_ATTR_H_
+#define ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif /* ESP_ATTR_H_ */
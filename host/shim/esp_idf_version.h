@@ -0,0 +1,7 @@
+#ifndef ESP_IDF_VERSION_H_
+#define ESP_IDF_VERSION_H_
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) ((major << 16) | (minor << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(5, 1, 0)
+
+#endif /* ESP_IDF_VERSION_H_ */
@@ -0,0 +1,15 @@
+#ifndef ESP_MAC_H_
+#define ESP_MAC_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// A fixed locally administered address
+static inline esp_err_t esp_base_mac_addr_get(uint8_t *mac)
+{
+	static const uint8_t base[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+	for (int i=0;i<6;i++) mac[i] = base[i];
+	return ESP_OK;
+}
+
+#endif /* ESP_MAC_H_ */
@@ -0,0 +1,15 @@
+#ifndef ESP_MEMORY_UTILS_H_
+#define ESP_MEMORY_UTILS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Deferred records keep 4-byte format pointers.
+// Link with -no-pie so that string literals are below 4 GB like the flash of the targets,
+// everything else is formatted by the caller like strings outside of flash.
+static inline bool esp_ptr_in_drom(const void *p)
+{
+	return p != NULL && (uintptr_t)p <= UINT32_MAX;
+}
+
+#endif /* ESP_MEMORY_UTILS_H_ */
@@ -0,0 +1,9 @@
+#ifndef ESP_ROM_CRC_H_
+#define ESP_ROM_CRC_H_
+
+#include <stdint.h>
+
+// CRC-32 as zlib computes it, the ROM function of the target gives the same result
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif /* ESP_ROM_CRC_H_ */
@@ -0,0 +1,18 @@
+#ifndef ESP_SYSTEM_H_
+#define ESP_SYSTEM_H_
+
+#include "esp_err.h"
+#include "esp_idf_version.h"
+
+typedef enum {
+	ESP_RST_UNKNOWN,
+	ESP_RST_POWERON,
+	ESP_RST_EXT,
+	ESP_RST_SW,
+	ESP_RST_PANIC,
+} esp_reset_reason_t;
+
+// A host process always starts from power on
+static inline esp_reset_reason_t esp_reset_reason(void) { return ESP_RST_POWERON; }
+
+#endif /* ESP_SYSTEM_H_ */
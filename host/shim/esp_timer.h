@@ -0,0 +1,9 @@
+#ifndef ESP_TIMER_H_
+#define ESP_TIMER_H_
+
+#include <stdint.h>
+
+// Microseconds since the process started
+int64_t esp_timer_get_time(void);
+
+#endif /* ESP_TIMER_H_ */
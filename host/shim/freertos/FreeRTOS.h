@@ -0,0 +1,51 @@
+#ifndef FREERTOS_H_
+#define FREERTOS_H_
+
+// POSIX stand-in for the parts of FreeRTOS used by net-logging.
+// Tasks are threads, a tick is one millisecond and a critical section is a recursive mutex.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portNUM_PROCESSORS 2
+#define configASSERT(x) assert(x)
+
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+static inline void portMUX_INITIALIZE(portMUX_TYPE *mux)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(mux, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux) pthread_mutex_unlock(mux)
+#define portENTER_CRITICAL_SAFE(mux) pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL_SAFE(mux) pthread_mutex_unlock(mux)
+#define portENTER_CRITICAL_ISR(mux) pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL_ISR(mux) pthread_mutex_unlock(mux)
+
+// There are no interrupts, every caller is a task
+static inline BaseType_t xPortInIsrContext(void) { return pdFALSE; }
+static inline BaseType_t xPortCanYield(void) { return pdTRUE; }
+// Tasks are given to the two cores in turn when they are created
+BaseType_t xPortGetCoreID(void);
+
+#endif /* FREERTOS_H_ */
@@ -0,0 +1,23 @@
+#ifndef EVENT_GROUPS_H_
+#define EVENT_GROUPS_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct EVENT_GROUP *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+// From esp_bit_defs.h
+#ifndef BIT0
+#define BIT0 0x00000001
+#define BIT1 0x00000002
+#define BIT2 0x00000004
+#define BIT3 0x00000008
+#endif
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor, const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits, TickType_t xTicksToWait);
+
+#endif /* EVENT_GROUPS_H_ */
@@ -0,0 +1,23 @@
+#ifndef MESSAGE_BUFFER_H_
+#define MESSAGE_BUFFER_H_
+
+#include "freertos/FreeRTOS.h"
+
+// Messages are stored with a 4-byte length, as on the 32-bit targets
+typedef struct {
+	uint8_t *storage;
+	size_t size;
+	size_t head; // Offset of the oldest byte
+	size_t used;
+	pthread_mutex_t lock;
+	pthread_cond_t readable;
+} StaticMessageBuffer_t;
+typedef StaticMessageBuffer_t *MessageBufferHandle_t;
+
+MessageBufferHandle_t xMessageBufferCreateStatic(size_t xBufferSizeBytes, uint8_t *pucMessageBufferStorageArea, StaticMessageBuffer_t *pxStaticMessageBuffer);
+size_t xMessageBufferSend(MessageBufferHandle_t xMessageBuffer, const void *pvTxData, size_t xDataLengthBytes, TickType_t xTicksToWait);
+size_t xMessageBufferSendFromISR(MessageBufferHandle_t xMessageBuffer, const void *pvTxData, size_t xDataLengthBytes, BaseType_t *pxHigherPriorityTaskWoken);
+size_t xMessageBufferReceive(MessageBufferHandle_t xMessageBuffer, void *pvRxData, size_t xBufferLengthBytes, TickType_t xTicksToWait);
+size_t xMessageBufferSpacesAvailable(MessageBufferHandle_t xMessageBuffer);
+
+#endif /* MESSAGE_BUFFER_H_ */
@@ -0,0 +1,34 @@
+#ifndef RINGBUF_H_
+#define RINGBUF_H_
+
+#include "freertos/FreeRTOS.h"
+
+// Only no-split buffers: each item is contiguous with an 8-byte header, 4-byte aligned.
+// Items must be returned in the order they were received.
+typedef enum {
+	RINGBUF_TYPE_NOSPLIT = 0,
+} RingbufferType_t;
+
+typedef struct {
+	uint8_t *storage;
+	size_t size;
+	size_t write; // Offset of the next item
+	size_t read; // Offset of the next item to receive
+	size_t free; // Offset of the oldest item not returned
+	size_t used; // Bytes of items and of the space skipped at the wrap
+	int items; // Items not received yet
+	pthread_mutex_t lock;
+	pthread_cond_t readable;
+} StaticRingbuffer_t;
+typedef StaticRingbuffer_t *RingbufHandle_t;
+
+RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize, RingbufferType_t xBufferType, uint8_t *pucRingbufferStorage, StaticRingbuffer_t *pxStaticRingbuffer);
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xDataSize, TickType_t xTicksToWait);
+BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xDataSize, BaseType_t *pxHigherPriorityTaskWoken);
+void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait);
+void *xRingbufferReceiveFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize);
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
+void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, BaseType_t *pxHigherPriorityTaskWoken);
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer);
+
+#endif /* RINGBUF_H_ */
@@ -0,0 +1,28 @@
+#ifndef TASK_H_
+#define TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct TASK *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum {
+	taskSCHEDULER_SUSPENDED,
+	taskSCHEDULER_NOT_STARTED,
+	taskSCHEDULER_RUNNING,
+} eSchedulerState;
+
+#define tskNO_AFFINITY 0x7fffffff
+
+// Stack size and priority are ignored, every task is a detached thread
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask, BaseType_t xCoreID);
+void vTaskDelete(TaskHandle_t xTask);
+void vTaskDelay(TickType_t xTicksToDelay);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xTaskGetSchedulerState(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify);
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+
+#endif /* TASK_H_ */
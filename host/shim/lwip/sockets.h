@@ -0,0 +1,29 @@
+#ifndef LWIP_SOCKETS_H_
+#define LWIP_SOCKETS_H_
+
+// The BSD sockets of the host stand in for lwIP
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define lwip_socket socket
+#define lwip_sendto sendto
+#define lwip_recvfrom recvfrom
+#define lwip_close close
+
+#define LWIP_ASSERT(message, assertion) do { \
+	if (!(assertion)) { \
+		fprintf(stderr, "Assertion \"%s\" failed at line %d in %s\n", message, __LINE__, __FILE__); \
+		abort(); \
+	} \
+} while(0)
+
+#endif /* LWIP_SOCKETS_H_ */
@@ -0,0 +1,352 @@
+/*
+	POSIX stand-in for the ESP-MQTT client
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+
+#include "lwip/sockets.h"
+#include "mqtt_client.h"
+
+#define MQTT_PORT 1883
+#define MQTT_KEEPALIVE_S 120
+#define MQTT_RECONNECT_MS 1000
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PUBREC 0x50
+#define MQTT_PUBREL 0x62
+#define MQTT_PUBCOMP 0x70
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_DUP 0x08
+
+static const char *MQTT_EVENTS = "MQTT_EVENTS";
+
+// A publish of QoS 1 or 2 waiting for the broker, kept as it was sent
+typedef struct OUTBOX {
+	struct OUTBOX *next;
+	int msg_id;
+	size_t length;
+	uint8_t packet[];
+} OUTBOX_t;
+
+struct esp_mqtt_client {
+	struct sockaddr_in addr;
+	char client_id[64];
+	esp_event_handler_t handler;
+	void *handler_arg;
+	pthread_t thread;
+	pthread_mutex_t lock; // Sends, the socket and the outbox
+	int fd;
+	bool connected;
+	bool stop;
+	uint16_t msg_id;
+	OUTBOX_t *outbox;
+	int outbox_size;
+};
+
+static void mqtt_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id, int msg_id, char *topic, int topic_len, char *data, int data_len)
+{
+	if (client->handler == NULL) return;
+	esp_mqtt_event_t event = {
+		.event_id = event_id,
+		.client = client,
+		.data = data,
+		.data_len = data_len,
+		.total_data_len = data_len,
+		.topic = topic,
+		.topic_len = topic_len,
+		.msg_id = msg_id,
+	};
+	client->handler(client->handler_arg, MQTT_EVENTS, event_id, &event);
+}
+
+// Fixed header, returns its length
+static size_t mqtt_header(uint8_t *packet, uint8_t type, size_t remaining)
+{
+	size_t length = 0;
+	packet[length++] = type;
+	do {
+		uint8_t byte = remaining % 128;
+		remaining /= 128;
+		packet[length++] = byte | (remaining ? 0x80 : 0);
+	} while (remaining);
+	return length;
+}
+
+static size_t mqtt_string(uint8_t *packet, const char *text)
+{
+	size_t length = strlen(text);
+	packet[0] = length >> 8;
+	packet[1] = length & 0xff;
+	memcpy(&packet[2], text, length);
+	return length + 2;
+}
+
+// Called with the lock held
+static bool mqtt_send(esp_mqtt_client_handle_t client, const uint8_t *packet, size_t length)
+{
+	while (length) {
+		ssize_t sent = send(client->fd, packet, length, MSG_NOSIGNAL);
+		if (sent <= 0) return false;
+		packet += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+static bool mqtt_ack(esp_mqtt_client_handle_t client, uint8_t type, int msg_id)
+{
+	uint8_t packet[4] = { type, 2, msg_id >> 8, msg_id & 0xff };
+	pthread_mutex_lock(&client->lock);
+	bool ret = mqtt_send(client, packet, sizeof(packet));
+	pthread_mutex_unlock(&client->lock);
+	return ret;
+}
+
+static void mqtt_outbox_delete(esp_mqtt_client_handle_t client, int msg_id)
+{
+	pthread_mutex_lock(&client->lock);
+	for (OUTBOX_t **entry = &client->outbox; *entry; entry = &(*entry)->next) {
+		if ((*entry)->msg_id != msg_id) continue;
+		OUTBOX_t *found = *entry;
+		*entry = found->next;
+		client->outbox_size -= found->length;
+		free(found);
+		break;
+	}
+	pthread_mutex_unlock(&client->lock);
+}
+
+static int mqtt_connect(esp_mqtt_client_handle_t client)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+	if (connect(fd, (struct sockaddr *)&client->addr, sizeof(client->addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+	int nodelay = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+	uint8_t packet[128];
+	uint8_t body[96];
+	size_t body_len = mqtt_string(body, "MQTT");
+	body[body_len++] = 4; // 3.1.1
+	body[body_len++] = 0x02; // Clean session
+	body[body_len++] = MQTT_KEEPALIVE_S >> 8;
+	body[body_len++] = MQTT_KEEPALIVE_S & 0xff;
+	body_len += mqtt_string(&body[body_len], client->client_id);
+	size_t length = mqtt_header(packet, MQTT_CONNECT, body_len);
+	memcpy(&packet[length], body, body_len);
+	length += body_len;
+	uint8_t connack[4];
+	if (send(fd, packet, length, MSG_NOSIGNAL) != length
+		|| recv(fd, connack, sizeof(connack), MSG_WAITALL) != sizeof(connack)
+		|| connack[0] != MQTT_CONNACK || connack[3] != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Reads one packet, returns its type or -1 when the connection is closed
+static int mqtt_read(int fd, uint8_t **body, size_t *body_len)
+{
+	uint8_t type;
+	if (recv(fd, &type, 1, MSG_WAITALL) != 1) return -1;
+	size_t remaining = 0;
+	for (int shift=0; shift<28; shift+=7) {
+		uint8_t byte;
+		if (recv(fd, &byte, 1, MSG_WAITALL) != 1) return -1;
+		remaining |= (size_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) break;
+	}
+	*body = realloc(*body, remaining + 1);
+	if (*body == NULL) return -1;
+	if (remaining && recv(fd, *body, remaining, MSG_WAITALL) != remaining) return -1;
+	*body_len = remaining;
+	return type;
+}
+
+static void *mqtt_main(void *arg)
+{
+	esp_mqtt_client_handle_t client = arg;
+	uint8_t *body = NULL;
+	while (__atomic_load_n(&client->stop, __ATOMIC_ACQUIRE) == false) {
+		int fd = mqtt_connect(client);
+		if (fd < 0) {
+			usleep(MQTT_RECONNECT_MS * 1000);
+			continue;
+		}
+		// Publishes that were not acknowledged are sent again
+		pthread_mutex_lock(&client->lock);
+		client->fd = fd;
+		client->connected = true;
+		for (OUTBOX_t *entry = client->outbox; entry; entry = entry->next) {
+			entry->packet[0] |= MQTT_DUP;
+			mqtt_send(client, entry->packet, entry->length);
+		}
+		pthread_mutex_unlock(&client->lock);
+		mqtt_event(client, MQTT_EVENT_CONNECTED, 0, NULL, 0, NULL, 0);
+
+		size_t body_len;
+		int type;
+		while ((type = mqtt_read(fd, &body, &body_len)) >= 0) {
+			int msg_id = (body_len >= 2) ? (body[0] << 8) | body[1] : 0;
+			switch (type & 0xf0) {
+				case MQTT_PUBACK:
+				case MQTT_PUBCOMP:
+					mqtt_outbox_delete(client, msg_id);
+					mqtt_event(client, MQTT_EVENT_PUBLISHED, msg_id, NULL, 0, NULL, 0);
+					break;
+				case MQTT_PUBREC:
+					mqtt_ack(client, MQTT_PUBREL, msg_id);
+					break;
+				case MQTT_SUBACK:
+					mqtt_event(client, MQTT_EVENT_SUBSCRIBED, msg_id, NULL, 0, NULL, 0);
+					break;
+				case MQTT_PUBLISH: {
+					// Messages of the subscribed topics, QoS 0 only
+					int topic_len = msg_id;
+					if (2 + topic_len > body_len) break;
+					mqtt_event(client, MQTT_EVENT_DATA, 0, (char *)&body[2], topic_len,
+						(char *)&body[2 + topic_len], body_len - 2 - topic_len);
+					break;
+				}
+				default:
+					break;
+			}
+		}
+
+		pthread_mutex_lock(&client->lock);
+		client->connected = false;
+		client->fd = -1;
+		close(fd);
+		pthread_mutex_unlock(&client->lock);
+		mqtt_event(client, MQTT_EVENT_DISCONNECTED, 0, NULL, 0, NULL, 0);
+	}
+	free(body);
+	return NULL;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+	esp_mqtt_client_handle_t client = calloc(1, sizeof(struct esp_mqtt_client));
+	if (client == NULL) return NULL;
+	char host[64];
+	unsigned int port = MQTT_PORT;
+	if (sscanf(config->broker.address.uri, "mqtt://%63[^:/]:%u", host, &port) < 1) {
+		free(client);
+		return NULL;
+	}
+	client->addr.sin_family = AF_INET;
+	client->addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, host, &client->addr.sin_addr) != 1) {
+		free(client);
+		return NULL;
+	}
+	if (config->credentials.client_id) strncpy(client->client_id, config->credentials.client_id, sizeof(client->client_id) - 1);
+	pthread_mutex_init(&client->lock, NULL);
+	client->fd = -1;
+	return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void *event_handler_arg)
+{
+	client->handler = event_handler;
+	client->handler_arg = event_handler_arg;
+	return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+	if (pthread_create(&client->thread, NULL, mqtt_main, client) != 0) return ESP_FAIL;
+	return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+	__atomic_store_n(&client->stop, true, __ATOMIC_RELEASE);
+	pthread_mutex_lock(&client->lock);
+	if (client->fd >= 0) shutdown(client->fd, SHUT_RDWR);
+	pthread_mutex_unlock(&client->lock);
+	pthread_join(client->thread, NULL);
+	return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+	if (len <= 0) len = data ? strlen(data) : 0;
+	size_t remaining = 2 + strlen(topic) + (qos ? 2 : 0) + len;
+	OUTBOX_t *entry = malloc(sizeof(OUTBOX_t) + 5 + remaining);
+	if (entry == NULL) return -1;
+	uint8_t *packet = entry->packet;
+	size_t length = mqtt_header(packet, MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0), remaining);
+	length += mqtt_string(&packet[length], topic);
+	size_t id_offset = length;
+	if (qos) length += 2;
+	memcpy(&packet[length], data, len);
+	length += len;
+
+	pthread_mutex_lock(&client->lock);
+	int msg_id = -1;
+	if (client->connected) {
+		msg_id = 0;
+		if (qos) {
+			if (++client->msg_id == 0) client->msg_id = 1;
+			msg_id = client->msg_id;
+			packet[id_offset] = msg_id >> 8;
+			packet[id_offset + 1] = msg_id & 0xff;
+		}
+		if (mqtt_send(client, packet, length) == false) msg_id = -1;
+	}
+	if (msg_id > 0) {
+		entry->msg_id = msg_id;
+		entry->length = length;
+		entry->next = client->outbox;
+		client->outbox = entry;
+		client->outbox_size += length;
+		entry = NULL;
+	}
+	pthread_mutex_unlock(&client->lock);
+	free(entry);
+	return msg_id;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+	uint8_t packet[128];
+	size_t topic_len = strlen(topic);
+	if (topic_len > sizeof(packet) - 16) return -1;
+	pthread_mutex_lock(&client->lock);
+	if (++client->msg_id == 0) client->msg_id = 1;
+	int msg_id = client->msg_id;
+	size_t length = mqtt_header(packet, MQTT_SUBSCRIBE, 2 + 2 + topic_len + 1);
+	packet[length++] = msg_id >> 8;
+	packet[length++] = msg_id & 0xff;
+	length += mqtt_string(&packet[length], topic);
+	packet[length++] = qos;
+	if (client->connected == false || mqtt_send(client, packet, length) == false) msg_id = -1;
+	pthread_mutex_unlock(&client->lock);
+	return msg_id;
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+	pthread_mutex_lock(&client->lock);
+	int size = client->outbox_size;
+	pthread_mutex_unlock(&client->lock);
+	return size;
+}
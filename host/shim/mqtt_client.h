@@ -0,0 +1,62 @@
+#ifndef MQTT_CLIENT_H_
+#define MQTT_CLIENT_H_
+
+// Stand-in for the ESP-MQTT client: MQTT 3.1.1 over a TCP socket of the host.
+// A thread connects, reconnects and reads the acknowledgements, as the MQTT task does.
+// Publishes of QoS 1 and 2 stay in the outbox until the broker acknowledges them,
+// and are sent again after a reconnect.
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum {
+	MQTT_EVENT_ANY = -1,
+	MQTT_EVENT_ERROR = 0,
+	MQTT_EVENT_CONNECTED,
+	MQTT_EVENT_DISCONNECTED,
+	MQTT_EVENT_SUBSCRIBED,
+	MQTT_EVENT_UNSUBSCRIBED,
+	MQTT_EVENT_PUBLISHED,
+	MQTT_EVENT_DATA,
+	MQTT_EVENT_BEFORE_CONNECT,
+} esp_mqtt_event_id_t;
+
+typedef struct {
+	esp_mqtt_event_id_t event_id;
+	esp_mqtt_client_handle_t client;
+	char *data;
+	int data_len;
+	int total_data_len;
+	int current_data_offset;
+	char *topic;
+	int topic_len;
+	int msg_id;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+// The fields used by net-logging, with the names of ESP-IDF 5
+typedef struct {
+	struct {
+		struct {
+			const char *uri; // mqtt://<IPv4 address>[:port]
+		} address;
+	} broker;
+	struct {
+		const char *client_id;
+	} credentials;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void *event_handler_arg);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+// Bytes of the publishes waiting in the outbox for the broker
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client);
+
+#endif /* MQTT_CLIENT_H_ */
@@ -0,0 +1,625 @@
+/*
+	POSIX stand-in for FreeRTOS and ESP-IDF
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "freertos/message_buffer.h"
+#include "freertos/ringbuf.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+struct TASK {
+	TaskFunction_t function;
+	void *parameter;
+	char name[16];
+	BaseType_t core;
+	pthread_mutex_t lock;
+	pthread_cond_t notified;
+	uint32_t notify;
+};
+
+static __thread struct TASK *current_task;
+
+// Monotonic time since the first call
+static uint64_t shim_time_us(void)
+{
+	static uint64_t start;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t us = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+	if (start == 0) start = us - 1;
+	return us - start;
+}
+
+// Condition variables wait on the monotonic clock, so the tick count and the timeouts agree
+static void shim_cond_init(pthread_cond_t *cond)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+// Returns false when the timeout expired
+static bool shim_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, struct timespec *deadline)
+{
+	if (deadline == NULL) {
+		pthread_cond_wait(cond, lock);
+		return true;
+	}
+	return pthread_cond_timedwait(cond, lock, deadline) == 0;
+}
+
+static struct timespec *shim_deadline(struct timespec *deadline, TickType_t xTicksToWait)
+{
+	if (xTicksToWait == portMAX_DELAY) return NULL;
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += xTicksToWait / 1000;
+	deadline->tv_nsec += (long)(xTicksToWait % 1000) * 1000000;
+	if (deadline->tv_nsec >= 1000000000) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000;
+	}
+	return deadline;
+}
+
+static struct TASK *task_new(TaskFunction_t function, const char *name, void *parameter)
+{
+	static int created;
+	struct TASK *task = calloc(1, sizeof(struct TASK));
+	if (task == NULL) return NULL;
+	task->function = function;
+	task->parameter = parameter;
+	strncpy(task->name, name, sizeof(task->name) - 1);
+	task->core = __atomic_fetch_add(&created, 1, __ATOMIC_RELAXED) % portNUM_PROCESSORS;
+	pthread_mutex_init(&task->lock, NULL);
+	shim_cond_init(&task->notified);
+	return task;
+}
+
+static void *task_main(void *arg)
+{
+	current_task = arg;
+	current_task->function(current_task->parameter);
+	return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask, BaseType_t xCoreID)
+{
+	struct TASK *task = task_new(pvTaskCode, pcName, pvParameters);
+	if (task == NULL) return pdFAIL;
+	if (xCoreID >= 0 && xCoreID < portNUM_PROCESSORS) task->core = xCoreID;
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, task_main, task) != 0) {
+		free(task);
+		return pdFAIL;
+	}
+	pthread_detach(thread);
+	if (pxCreatedTask) *pxCreatedTask = task;
+	return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+	return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTask)
+{
+	// Only the running task deletes itself
+	if (xTask == NULL || xTask == current_task) pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+	if (xTicksToDelay == 0) {
+		sched_yield();
+		return;
+	}
+	struct timespec delay = { .tv_sec = xTicksToDelay / 1000, .tv_nsec = (long)(xTicksToDelay % 1000) * 1000000 };
+	nanosleep(&delay, NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return shim_time_us() / 1000;
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+	return taskSCHEDULER_RUNNING;
+}
+
+// Threads that were not created by xTaskCreate, like main, get a handle on first use
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	if (current_task == NULL) current_task = task_new(NULL, "main", NULL);
+	return current_task;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+	return xTaskGetCurrentTaskHandle()->core;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+	pthread_mutex_lock(&xTaskToNotify->lock);
+	xTaskToNotify->notify++;
+	pthread_cond_signal(&xTaskToNotify->notified);
+	pthread_mutex_unlock(&xTaskToNotify->lock);
+	return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+	struct TASK *task = xTaskGetCurrentTaskHandle();
+	struct timespec deadline;
+	struct timespec *until = shim_deadline(&deadline, xTicksToWait);
+	pthread_mutex_lock(&task->lock);
+	while (task->notify == 0 && xTicksToWait) {
+		if (shim_cond_wait(&task->notified, &task->lock, until) == false) break;
+	}
+	uint32_t value = task->notify;
+	if (value) task->notify = xClearCountOnExit ? 0 : value - 1;
+	pthread_mutex_unlock(&task->lock);
+	return value;
+}
+
+// Event group
+
+struct EVENT_GROUP {
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+	struct EVENT_GROUP *group = calloc(1, sizeof(struct EVENT_GROUP));
+	if (group == NULL) return NULL;
+	pthread_mutex_init(&group->lock, NULL);
+	shim_cond_init(&group->changed);
+	return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+	pthread_mutex_lock(&xEventGroup->lock);
+	xEventGroup->bits |= uxBitsToSet;
+	EventBits_t bits = xEventGroup->bits;
+	pthread_cond_broadcast(&xEventGroup->changed);
+	pthread_mutex_unlock(&xEventGroup->lock);
+	return bits;
+}
+
+// Returns the bits before they were cleared
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+	pthread_mutex_lock(&xEventGroup->lock);
+	EventBits_t bits = xEventGroup->bits;
+	xEventGroup->bits &= ~uxBitsToClear;
+	pthread_mutex_unlock(&xEventGroup->lock);
+	return bits;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup)
+{
+	return xEventGroupClearBits(xEventGroup, 0);
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor, const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits, TickType_t xTicksToWait)
+{
+	struct timespec deadline;
+	struct timespec *until = shim_deadline(&deadline, xTicksToWait);
+	pthread_mutex_lock(&xEventGroup->lock);
+	while (1) {
+		EventBits_t set = xEventGroup->bits & uxBitsToWaitFor;
+		if (xWaitForAllBits ? (set == uxBitsToWaitFor) : (set != 0)) break;
+		if (xTicksToWait == 0 || shim_cond_wait(&xEventGroup->changed, &xEventGroup->lock, until) == false) break;
+	}
+	EventBits_t bits = xEventGroup->bits;
+	EventBits_t set = bits & uxBitsToWaitFor;
+	if (xClearOnExit && (xWaitForAllBits ? (set == uxBitsToWaitFor) : (set != 0))) xEventGroup->bits &= ~uxBitsToWaitFor;
+	pthread_mutex_unlock(&xEventGroup->lock);
+	return bits;
+}
+
+// Message buffer
+
+#define MESSAGE_LENGTH_SIZE 4
+
+static void message_copy_in(MessageBufferHandle_t buffer, size_t offset, const void *data, size_t length)
+{
+	size_t index = (buffer->head + offset) % buffer->size;
+	size_t first = buffer->size - index;
+	if (first > length) first = length;
+	memcpy(buffer->storage + index, data, first);
+	memcpy(buffer->storage, (const uint8_t *)data + first, length - first);
+}
+
+static void message_copy_out(MessageBufferHandle_t buffer, size_t offset, void *data, size_t length)
+{
+	size_t index = (buffer->head + offset) % buffer->size;
+	size_t first = buffer->size - index;
+	if (first > length) first = length;
+	memcpy(data, buffer->storage + index, first);
+	memcpy((uint8_t *)data + first, buffer->storage, length - first);
+}
+
+MessageBufferHandle_t xMessageBufferCreateStatic(size_t xBufferSizeBytes, uint8_t *pucMessageBufferStorageArea, StaticMessageBuffer_t *pxStaticMessageBuffer)
+{
+	MessageBufferHandle_t buffer = pxStaticMessageBuffer;
+	buffer->storage = pucMessageBufferStorageArea;
+	buffer->size = xBufferSizeBytes;
+	buffer->head = 0;
+	buffer->used = 0;
+	pthread_mutex_init(&buffer->lock, NULL);
+	shim_cond_init(&buffer->readable);
+	return buffer;
+}
+
+size_t xMessageBufferSendFromISR(MessageBufferHandle_t xMessageBuffer, const void *pvTxData, size_t xDataLengthBytes, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	size_t sent = 0;
+	uint32_t length = xDataLengthBytes;
+	pthread_mutex_lock(&xMessageBuffer->lock);
+	if (xMessageBuffer->size - xMessageBuffer->used >= MESSAGE_LENGTH_SIZE + xDataLengthBytes) {
+		message_copy_in(xMessageBuffer, xMessageBuffer->used, &length, MESSAGE_LENGTH_SIZE);
+		message_copy_in(xMessageBuffer, xMessageBuffer->used + MESSAGE_LENGTH_SIZE, pvTxData, xDataLengthBytes);
+		xMessageBuffer->used += MESSAGE_LENGTH_SIZE + xDataLengthBytes;
+		sent = xDataLengthBytes;
+		pthread_cond_signal(&xMessageBuffer->readable);
+	}
+	pthread_mutex_unlock(&xMessageBuffer->lock);
+	return sent;
+}
+
+size_t xMessageBufferSend(MessageBufferHandle_t xMessageBuffer, const void *pvTxData, size_t xDataLengthBytes, TickType_t xTicksToWait)
+{
+	TickType_t start = xTaskGetTickCount();
+	while (1) {
+		size_t sent = xMessageBufferSendFromISR(xMessageBuffer, pvTxData, xDataLengthBytes, NULL);
+		if (sent || xTaskGetTickCount() - start >= xTicksToWait) return sent;
+		vTaskDelay(1);
+	}
+}
+
+size_t xMessageBufferReceive(MessageBufferHandle_t xMessageBuffer, void *pvRxData, size_t xBufferLengthBytes, TickType_t xTicksToWait)
+{
+	struct timespec deadline;
+	struct timespec *until = shim_deadline(&deadline, xTicksToWait);
+	size_t received = 0;
+	pthread_mutex_lock(&xMessageBuffer->lock);
+	while (xMessageBuffer->used == 0 && xTicksToWait) {
+		if (shim_cond_wait(&xMessageBuffer->readable, &xMessageBuffer->lock, until) == false) break;
+	}
+	if (xMessageBuffer->used) {
+		uint32_t length;
+		message_copy_out(xMessageBuffer, 0, &length, MESSAGE_LENGTH_SIZE);
+		// A message larger than the buffer of the reader stays in the message buffer
+		if (length <= xBufferLengthBytes) {
+			message_copy_out(xMessageBuffer, MESSAGE_LENGTH_SIZE, pvRxData, length);
+			xMessageBuffer->head = (xMessageBuffer->head + MESSAGE_LENGTH_SIZE + length) % xMessageBuffer->size;
+			xMessageBuffer->used -= MESSAGE_LENGTH_SIZE + length;
+			received = length;
+		}
+	}
+	pthread_mutex_unlock(&xMessageBuffer->lock);
+	return received;
+}
+
+size_t xMessageBufferSpacesAvailable(MessageBufferHandle_t xMessageBuffer)
+{
+	pthread_mutex_lock(&xMessageBuffer->lock);
+	size_t spaces = xMessageBuffer->size - xMessageBuffer->used;
+	pthread_mutex_unlock(&xMessageBuffer->lock);
+	return spaces;
+}
+
+// No-split ring buffer
+
+typedef struct {
+	uint32_t length;
+	uint32_t flags;
+} RING_HEADER_t;
+
+#define RING_FLAG_RETURNED 1
+#define RING_FLAG_WRAP 2
+#define RING_ALIGN(n) (((n) + 3) & ~(size_t)3)
+
+RingbufHandle_t xRingbufferCreateStatic(size_t xBufferSize, RingbufferType_t xBufferType, uint8_t *pucRingbufferStorage, StaticRingbuffer_t *pxStaticRingbuffer)
+{
+	RingbufHandle_t ring = pxStaticRingbuffer;
+	ring->storage = pucRingbufferStorage;
+	ring->size = xBufferSize & ~(size_t)3;
+	ring->write = ring->read = ring->free = 0;
+	ring->used = 0;
+	ring->items = 0;
+	pthread_mutex_init(&ring->lock, NULL);
+	shim_cond_init(&ring->readable);
+	return ring;
+}
+
+// Offset of the item at offset, after the space skipped at the wrap
+static size_t ring_item(RingbufHandle_t ring, size_t offset)
+{
+	if (ring->size - offset < sizeof(RING_HEADER_t)) return 0;
+	RING_HEADER_t *header = (RING_HEADER_t *)&ring->storage[offset];
+	if (header->flags & RING_FLAG_WRAP) return 0;
+	return offset;
+}
+
+BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xDataSize, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	RingbufHandle_t ring = xRingbuffer;
+	size_t required = sizeof(RING_HEADER_t) + RING_ALIGN(xDataSize);
+	BaseType_t ret = pdFALSE;
+	pthread_mutex_lock(&ring->lock);
+	if (ring->used == 0) ring->write = ring->read = ring->free = 0;
+	size_t end = ring->size - ring->write;
+	size_t skip = 0;
+	bool fits;
+	if (ring->used && ring->write <= ring->free) {
+		// The free space is between the newest and the oldest item
+		fits = (ring->free - ring->write >= required);
+	} else if (end >= required) {
+		fits = true;
+	} else {
+		// Skip the end of the storage
+		skip = end;
+		fits = (ring->free >= required || ring->used == 0);
+	}
+	if (fits && required <= ring->size) {
+		if (skip) {
+			if (skip >= sizeof(RING_HEADER_t)) {
+				RING_HEADER_t wrap = { .length = 0, .flags = RING_FLAG_WRAP };
+				memcpy(&ring->storage[ring->write], &wrap, sizeof(wrap));
+			}
+			ring->used += skip;
+			ring->write = 0;
+		}
+		RING_HEADER_t header = { .length = xDataSize, .flags = 0 };
+		memcpy(&ring->storage[ring->write], &header, sizeof(header));
+		memcpy(&ring->storage[ring->write + sizeof(header)], pvItem, xDataSize);
+		ring->write = (ring->write + required) % ring->size;
+		ring->used += required;
+		ring->items++;
+		pthread_cond_signal(&ring->readable);
+		ret = pdTRUE;
+	}
+	pthread_mutex_unlock(&ring->lock);
+	return ret;
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xDataSize, TickType_t xTicksToWait)
+{
+	TickType_t start = xTaskGetTickCount();
+	while (1) {
+		if (xRingbufferSendFromISR(xRingbuffer, pvItem, xDataSize, NULL)) return pdTRUE;
+		if (xTaskGetTickCount() - start >= xTicksToWait) return pdFALSE;
+		vTaskDelay(1);
+	}
+}
+
+static void *ring_receive(RingbufHandle_t ring, size_t *pxItemSize, TickType_t xTicksToWait)
+{
+	struct timespec deadline;
+	struct timespec *until = shim_deadline(&deadline, xTicksToWait);
+	void *item = NULL;
+	pthread_mutex_lock(&ring->lock);
+	while (ring->items == 0 && xTicksToWait) {
+		if (shim_cond_wait(&ring->readable, &ring->lock, until) == false) break;
+	}
+	if (ring->items) {
+		ring->read = ring_item(ring, ring->read);
+		RING_HEADER_t *header = (RING_HEADER_t *)&ring->storage[ring->read];
+		item = &ring->storage[ring->read + sizeof(RING_HEADER_t)];
+		*pxItemSize = header->length;
+		ring->read = (ring->read + sizeof(RING_HEADER_t) + RING_ALIGN(header->length)) % ring->size;
+		ring->items--;
+	}
+	pthread_mutex_unlock(&ring->lock);
+	return item;
+}
+
+void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait)
+{
+	return ring_receive(xRingbuffer, pxItemSize, xTicksToWait);
+}
+
+void *xRingbufferReceiveFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize)
+{
+	return ring_receive(xRingbuffer, pxItemSize, 0);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
+{
+	RingbufHandle_t ring = xRingbuffer;
+	pthread_mutex_lock(&ring->lock);
+	RING_HEADER_t *header = (RING_HEADER_t *)((uint8_t *)pvItem - sizeof(RING_HEADER_t));
+	header->flags |= RING_FLAG_RETURNED;
+	// Free the returned items from the oldest on
+	while (ring->used) {
+		size_t offset = ring_item(ring, ring->free);
+		if (offset != ring->free) {
+			ring->used -= ring->size - ring->free;
+			ring->free = 0;
+			continue;
+		}
+		header = (RING_HEADER_t *)&ring->storage[offset];
+		if ((header->flags & RING_FLAG_RETURNED) == 0) break;
+		size_t length = sizeof(RING_HEADER_t) + RING_ALIGN(header->length);
+		ring->used -= length;
+		ring->free = (ring->free + length) % ring->size;
+	}
+	pthread_mutex_unlock(&ring->lock);
+}
+
+void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	vRingbufferReturnItem(xRingbuffer, pvItem);
+}
+
+// The largest item that fits, like ESP-IDF this is the larger of the two free areas
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer)
+{
+	RingbufHandle_t ring = xRingbuffer;
+	pthread_mutex_lock(&ring->lock);
+	size_t space;
+	if (ring->used == 0) {
+		space = ring->size;
+	} else if (ring->write <= ring->free) {
+		space = ring->free - ring->write;
+	} else {
+		space = ring->size - ring->write;
+		if (ring->free > space) space = ring->free;
+	}
+	pthread_mutex_unlock(&ring->lock);
+	return (space > sizeof(RING_HEADER_t)) ? space - sizeof(RING_HEADER_t) : 0;
+}
+
+// Logging
+
+static vprintf_like_t log_vprintf = vprintf;
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+	vprintf_like_t previous = log_vprintf;
+	log_vprintf = func;
+	return previous;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+	return xTaskGetTickCount();
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+	va_list list;
+	va_start(list, format);
+	log_vprintf(format, list);
+	va_end(list);
+}
+
+int64_t esp_timer_get_time(void)
+{
+	return shim_time_us();
+}
+
+uint32_t esp_random(void)
+{
+	static uint32_t state = 0x6e6c6f67;
+	// xorshift32, shared by all threads like the hardware generator
+	uint32_t x = __atomic_load_n(&state, __ATOMIC_RELAXED);
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	__atomic_store_n(&state, x, __ATOMIC_RELAXED);
+	return x;
+}
+
+// Flash partitions
+
+#define SHIM_PARTITION_MAX 4
+#define SHIM_SECTOR_SIZE 4096
+
+static struct {
+	esp_partition_t partition;
+	uint8_t *data;
+} partitions[SHIM_PARTITION_MAX];
+static int partition_count;
+
+const esp_partition_t *shim_partition_add(const char *label, size_t size)
+{
+	if (partition_count == SHIM_PARTITION_MAX || size % SHIM_SECTOR_SIZE) return NULL;
+	uint8_t *data = malloc(size);
+	if (data == NULL) return NULL;
+	memset(data, 0xff, size);
+	esp_partition_t *partition = &partitions[partition_count].partition;
+	partition->type = ESP_PARTITION_TYPE_DATA;
+	partition->subtype = 0;
+	partition->address = 0x110000 + partition_count * 0x100000;
+	partition->size = size;
+	strncpy(partition->label, label, sizeof(partition->label) - 1);
+	partition->encrypted = false;
+	partitions[partition_count++].data = data;
+	return partition;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+	for (int i=0;i<partition_count;i++) {
+		esp_partition_t *partition = &partitions[i].partition;
+		if (partition->type != type) continue;
+		if (subtype != ESP_PARTITION_SUBTYPE_ANY && partition->subtype != subtype) continue;
+		if (label && strcmp(partition->label, label)) continue;
+		return partition;
+	}
+	return NULL;
+}
+
+static uint8_t *partition_data(const esp_partition_t *partition, size_t offset, size_t size)
+{
+	for (int i=0;i<partition_count;i++) {
+		if (partition != &partitions[i].partition) continue;
+		if (offset > partition->size || size > partition->size - offset) return NULL;
+		return partitions[i].data + offset;
+	}
+	return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+	uint8_t *data = partition_data(partition, src_offset, size);
+	if (data == NULL) return ESP_ERR_INVALID_SIZE;
+	memcpy(dst, data, size);
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+	uint8_t *data = partition_data(partition, dst_offset, size);
+	if (data == NULL) return ESP_ERR_INVALID_SIZE;
+	// Bits go from 1 to 0 only, a write over written bytes keeps their zeros
+	for (size_t i=0;i<size;i++) data[i] &= ((const uint8_t *)src)[i];
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+	if (offset % SHIM_SECTOR_SIZE || size % SHIM_SECTOR_SIZE) return ESP_ERR_INVALID_ARG;
+	uint8_t *data = partition_data(partition, offset, size);
+	if (data == NULL) return ESP_ERR_INVALID_SIZE;
+	memset(data, 0xff, size);
+	return ESP_OK;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+	crc = ~crc;
+	for (uint32_t i=0;i<len;i++) {
+		crc ^= buf[i];
+		for (int bit=0;bit<8;bit++) crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
@@ -0,0 +1,116 @@
+/*
+	Loopback capture server for the host checks
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "lwip/sockets.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "capture.h"
+
+static struct {
+	bool tcp;
+	int fd;
+	pthread_mutex_t lock;
+	uint8_t *data;
+	size_t length;
+	size_t size;
+} capture = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void capture_append(const void *data, size_t length)
+{
+	pthread_mutex_lock(&capture.lock);
+	if (capture.length + length > capture.size) {
+		capture.size = (capture.length + length) * 2;
+		capture.data = realloc(capture.data, capture.size);
+	}
+	memcpy(&capture.data[capture.length], data, length);
+	capture.length += length;
+	pthread_mutex_unlock(&capture.lock);
+}
+
+static void *capture_main(void *arg)
+{
+	int fd = capture.fd;
+	if (capture.tcp) {
+		fd = accept(capture.fd, NULL, NULL);
+		if (fd < 0) return NULL;
+	}
+	uint8_t data[65536];
+	while (1) {
+		ssize_t received = recv(fd, data, sizeof(data), 0);
+		if (received < 0 || (received == 0 && capture.tcp)) break;
+		if (capture.tcp == false) {
+			uint16_t length = received;
+			capture_append(&length, sizeof(length));
+		}
+		capture_append(data, received);
+	}
+	return NULL;
+}
+
+uint16_t capture_start(bool tcp)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	capture.tcp = tcp;
+	capture.fd = socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+	int rcvbuf = 8 * 1024 * 1024;
+	setsockopt(capture.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	if (bind(capture.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		perror("bind");
+		exit(1);
+	}
+	socklen_t addr_len = sizeof(addr);
+	getsockname(capture.fd, (struct sockaddr *)&addr, &addr_len);
+	if (tcp) listen(capture.fd, 1);
+	pthread_t thread;
+	pthread_create(&thread, NULL, capture_main, NULL);
+	pthread_detach(thread);
+	return ntohs(addr.sin_port);
+}
+
+size_t capture_wait(int quiet_ms)
+{
+	size_t length = 0;
+	// Give up after 100 rounds, the check then fails on the missing data
+	for (int round=0;round<100;round++) {
+		vTaskDelay(pdMS_TO_TICKS(quiet_ms));
+		pthread_mutex_lock(&capture.lock);
+		size_t now = capture.length;
+		pthread_mutex_unlock(&capture.lock);
+		if (now == length && now) return now;
+		length = now;
+	}
+	return length;
+}
+
+const uint8_t *capture_data(void)
+{
+	return capture.data;
+}
+
+bool capture_save(const char *path)
+{
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL) return false;
+	pthread_mutex_lock(&capture.lock);
+	size_t written = fwrite(capture.data, 1, capture.length, fp);
+	pthread_mutex_unlock(&capture.lock);
+	fclose(fp);
+	return written == capture.length;
+}
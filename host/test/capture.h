@@ -0,0 +1,16 @@
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Loopback server that keeps everything it receives.
+// Datagrams are kept with a 2-byte length in front, TCP data as one stream.
+uint16_t capture_start(bool tcp);
+// Wait until nothing arrived for quiet_ms, returns the bytes captured
+size_t capture_wait(int quiet_ms);
+const uint8_t *capture_data(void);
+bool capture_save(const char *path);
+
+#endif /* CAPTURE_H_ */
@@ -0,0 +1,15 @@
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Stop the check at the first failure
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		exit(1); \
+	} \
+} while(0)
+
+#endif /* CHECK_H_ */
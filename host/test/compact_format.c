@@ -0,0 +1,101 @@
+/*
+	Compact format check
+
+	Log records are packed, compared after compact_format_unpack, and encoded into two connections:
+	the second one starts with compact_format_sync, as the TCP sender does after reconnecting.
+	There are more tags than the dictionary holds, and some timestamps go back.
+	The streams are saved for test_compact_format.py, which decodes them with netlog.RecordParser.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "compact_format.h"
+#include "check.h"
+
+#define RECORDS 100
+// Records of the first connection
+#define FIRST_CONNECTION 60
+#define TAGS (COMPACT_TAG_MAX + 8)
+#define RECORD_SIZE 256
+
+static const char level_letter[] = "NEWIDV";
+// The colors of LOG_FORMAT, debug and verbose have none
+static const char *level_color[] = { "", LOG_COLOR_E, LOG_COLOR_W, LOG_COLOR_I, "", "" };
+
+static void hex(FILE *output, const void *data, size_t length)
+{
+	for (size_t i=0;i<length;i++) fprintf(output, "%02x", ((const uint8_t *)data)[i]);
+	fputc('\n', output);
+}
+
+int main(int argc, char *argv[])
+{
+	static char stream[2][RECORDS * (RECORD_SIZE + COMPACT_FORMAT_OVERHEAD) + COMPACT_SYNC_SIZE];
+	size_t stream_len[2] = { 0, 0 };
+	static char expected[RECORDS * RECORD_SIZE];
+	size_t expected_len = 0;
+	COMPACT_STATE_t state;
+	compact_format_reset(&state);
+
+	for (int i=0;i<RECORDS;i++) {
+		int connection = (i < FIRST_CONNECTION) ? 0 : 1;
+		if (i == FIRST_CONNECTION) {
+			// The server starts every connection with an empty dictionary
+			int sync_len = compact_format_sync(&state, stream[1], sizeof(stream[1]), state.timestamp);
+			CHECK(sync_len > 0);
+			stream_len[1] = sync_len;
+		}
+		esp_log_level_t level = ESP_LOG_ERROR + i % ESP_LOG_VERBOSE;
+		// Every tenth record is older than the one before
+		uint32_t timestamp = 1000 + i * 7 - ((i % 10 == 5) ? 50 : 0);
+		const char *color = level_color[level];
+		char text[RECORD_SIZE];
+		int text_len = snprintf(text, sizeof(text), "%s%c (%"PRIu32") tag%d: record %d%s%s\n",
+			color, level_letter[level], timestamp, i % TAGS, i, (i % 3) ? " with some more text" : "", color[0] ? LOG_RESET_COLOR : "");
+
+		char record[RECORD_SIZE];
+		memcpy(record, text, text_len);
+		int record_len = compact_format_pack(record, sizeof(record), text_len, i % 2);
+		CHECK(record_len > 0);
+		CHECK(compact_format_is_record(record, record_len));
+		CHECK(compact_format_level(record) == level);
+		char unpacked[RECORD_SIZE];
+		CHECK(compact_format_unpack(unpacked, sizeof(unpacked), record, record_len) == text_len);
+		CHECK(memcmp(unpacked, text, text_len) == 0);
+
+		char *frame = &stream[connection][stream_len[connection]];
+		int frame_len = compact_format_encode(&state, frame, sizeof(stream[connection]) - stream_len[connection], record, record_len);
+		CHECK(frame_len > 0);
+		stream_len[connection] += frame_len;
+		memcpy(&expected[expected_len], text, text_len);
+		expected_len += text_len;
+	}
+
+	// Text that is not a log record stays text
+	char text[] = "plain text\n";
+	CHECK(compact_format_pack(text, sizeof(text), strlen(text), 0) < 0);
+	char colored[] = LOG_COLOR_I "I (5) tag: no reset\n";
+	CHECK(compact_format_pack(colored, sizeof(colored), strlen(colored), 0) < 0);
+	char no_tag[] = "I (5) no tag\n";
+	CHECK(compact_format_pack(no_tag, sizeof(no_tag), strlen(no_tag), 0) < 0);
+
+	if (argc > 1) {
+		FILE *output = fopen(argv[1], "w");
+		CHECK(output != NULL);
+		hex(output, stream[0], stream_len[0]);
+		hex(output, stream[1], stream_len[1]);
+		hex(output, expected, expected_len);
+		fclose(output);
+	}
+	printf("%d records, %zu bytes of text in %zu bytes\n", RECORDS, expected_len, stream_len[0] + stream_len[1]);
+	return 0;
+}
@@ -0,0 +1,100 @@
+/*
+	Compression check
+
+	Batches of log records, long runs and long literals are compressed with compress_frame.
+	Data that does not get smaller must be refused.
+	The frames are saved for test_compress.py, which decompresses them with netlog.lz4_decompress.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "compress.h"
+#include "check.h"
+
+#define DATA_SIZE 16384
+
+static FILE *output;
+static COMPRESS_STATE_t state;
+
+static void hex(const void *data, size_t length)
+{
+	for (size_t i=0;i<length;i++) fprintf(output, "%02x", ((const uint8_t *)data)[i]);
+}
+
+// Compress the data, the frame and the data are saved when it got smaller
+static int check(const char *data, size_t length)
+{
+	static char frame[DATA_SIZE];
+	int frame_len = compress_frame(&state, frame, sizeof(frame), data, length);
+	if (frame_len < 0) return frame_len;
+	CHECK(frame_len < (int)length);
+	CHECK(frame[0] == FRAME_MARKER && frame[1] == FRAME_TYPE_COMPRESSED);
+	CHECK((uint8_t)frame[2] + ((uint8_t)frame[3] << 8) == frame_len);
+	CHECK((uint8_t)frame[4] + ((uint8_t)frame[5] << 8) == length);
+	if (output) {
+		hex(frame, frame_len);
+		fputc(' ', output);
+		hex(data, length);
+		fputc('\n', output);
+	}
+	return frame_len;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1) {
+		output = fopen(argv[1], "w");
+		CHECK(output != NULL);
+	}
+	static char data[DATA_SIZE];
+	size_t length = 0;
+
+	// A batch of records as the TCP sender packs them
+	for (int i=0;i<40;i++) {
+		length += snprintf(&data[length], sizeof(data) - length, LOG_COLOR_I "I (%d) wifi: sta ip: 192.168.10.%d, mask: 255.255.255.0, gw: 192.168.10.1" LOG_RESET_COLOR "\n", 1000 + i * 13, i);
+		length += snprintf(&data[length], sizeof(data) - length, LOG_COLOR_E "E (%d) MAIN: connect failed, error %d" LOG_RESET_COLOR "\n", 1005 + i * 13, -i);
+	}
+	int frame_len = check(data, length);
+	CHECK(frame_len > 0);
+	printf("records: %zu bytes in %d bytes\n", length, frame_len);
+
+	// A single short record, mostly from the dictionary
+	length = snprintf(data, sizeof(data), LOG_COLOR_W "W (5) MAIN: wifi disconnected" LOG_RESET_COLOR "\n");
+	CHECK(check(data, length) > 0);
+
+	// A long run, overlapping matches with length bytes of 255
+	memset(data, 'a', 5000);
+	CHECK(check(data, 5000) > 0);
+
+	// A long literal before a long match
+	uint32_t seed = 1;
+	for (int i=0;i<1000;i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = 'A' + (seed >> 16) % 26;
+	}
+	memcpy(&data[1000], data, 1000);
+	CHECK(check(data, 2000) > 0);
+
+	// Random bytes do not get smaller
+	for (int i=0;i<1000;i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = seed >> 16;
+	}
+	CHECK(check(data, 1000) < 0);
+	// Nor does data shorter than the header
+	CHECK(check("I (", 3) < 0);
+
+	if (output) fclose(output);
+	printf("ok\n");
+	return 0;
+}
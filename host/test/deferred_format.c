@@ -0,0 +1,103 @@
+/*
+	Deferred format check
+
+	Each record is packed, formatted again with deferred_format_unpack and compared with vsnprintf.
+	The records are saved for test_deferred_format.py, which formats them with netlog.format_deferred.
+	Build with -no-pie, so that the format strings have 4-byte addresses as in flash.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "deferred_format.h"
+#include "check.h"
+
+static FILE *output;
+
+static void hex(const void *data, size_t length)
+{
+	for (size_t i=0;i<length;i++) fprintf(output, "%02x", ((const uint8_t *)data)[i]);
+}
+
+static int pack(const char *fmt, ...)
+{
+	char record[64];
+	va_list l;
+	va_start(l, fmt);
+	int record_len = deferred_format_pack(record, sizeof(record), fmt, l);
+	va_end(l);
+	return record_len;
+}
+
+// The records are saved for netlog.py, unless they have arguments with other sizes on the host, like %ld or %zu
+static void check(bool save, const char *fmt, ...)
+{
+	char record[256];
+	char text[256];
+	char expected[256];
+	va_list l;
+	va_start(l, fmt);
+	int record_len = deferred_format_pack(record, sizeof(record), fmt, l);
+	va_end(l);
+	va_start(l, fmt);
+	vsnprintf(expected, sizeof(expected), fmt, l);
+	va_end(l);
+	CHECK(record_len > 0);
+	CHECK(deferred_format_is_record(record, record_len));
+	CHECK(deferred_format_fmt(record) == fmt);
+	int text_len = deferred_format_unpack(text, sizeof(text), record, record_len);
+	if (text_len < 0 || strcmp(text, expected) != 0) {
+		printf("format \"%s\": \"%s\" expected \"%s\"\n", fmt, text_len < 0 ? "(error)" : text, expected);
+		exit(1);
+	}
+	if (output && save) {
+		// Format string, arguments and expected text
+		hex(fmt, strlen(fmt));
+		fputc(' ', output);
+		hex(&record[FRAME_HEADER_SIZE + 4], record_len - FRAME_HEADER_SIZE - 4);
+		fputc(' ', output);
+		hex(expected, strlen(expected));
+		fputc('\n', output);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1) {
+		output = fopen(argv[1], "w");
+		CHECK(output != NULL);
+	}
+	// Not terminated, only the precision may be read
+	static const char letters[3] = { 'a', 'b', 'c' };
+
+	check(true, "int %d %i %u %x %X %o %c %%", -1, 42, 3000000000u, 0xbeef, 0xbeef, 8, 'z');
+	check(true, "width %5d|%-5d|%05d|%*d|%-*d", 1, 2, 3, 6, 4, 6, 5);
+	check(true, "long long %lld %llu %llx", -1234567890123LL, 12345678901234ULL, 0x123456789abcULL);
+	check(true, "intmax %jd %ju %jx", INTMAX_MIN, UINTMAX_MAX, (uintmax_t)0xfedcba9876543210ULL);
+	check(true, "char %hhd %hd", 300, 70000);
+	check(true, "double %f %.2f %e %g %10.3f", 1.5, 3.14159, 123456.0, 0.0001, -2.5);
+	check(true, "string %s|%10s|%-10s|", "abc", "right", "left");
+	check(true, "precision %.3s|%.2s|%.0s|%.5s", letters, "abcdef", "abc", "ab");
+	check(true, "star precision %.*s|%.*s|%*.*s", 3, letters, -1, "all", 6, 2, letters);
+	check(true, "null %s", NULL);
+	check(true, "mixed %s=%lld %.1f%% %jd", "key", 5LL, 99.5, (intmax_t)-7);
+	// Sizes of the host
+	check(false, "long %ld %lu %zu %td", -5L, 7UL, (size_t)9, (ptrdiff_t)-3);
+
+	// A format string on the stack is formatted by the caller
+	char stack_fmt[] = "stack %d";
+	CHECK(pack(stack_fmt, 1) < 0);
+	// Unsupported conversions too
+	CHECK(pack("long double %Lf", 1.0L) < 0);
+
+	if (output) fclose(output);
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+	Early capture check
+
+	Records are logged before udp_logging_init, as during boot and WiFi association,
+	and another thread keeps logging while the transport starts.
+	With the early capture every record must reach the network once, without it the boot records are lost.
+	STDOUT is mirrored asynchronously, and every record must be on it once:
+	records shown by the capture are not shown again by the STDOUT sink.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "net_logging.h"
+#include "capture.h"
+#include "check.h"
+
+#define BOOT_RECORDS 20
+#define DURING_MAX 10000
+
+static bool stop;
+static int during_count;
+
+// Keeps logging while the transport starts
+static void *during_main(void *arg)
+{
+	while (__atomic_load_n(&stop, __ATOMIC_ACQUIRE) == false && during_count < DURING_MAX) {
+		ESP_LOGI("DURING", "during record %d end", during_count);
+		during_count++;
+		usleep(100);
+	}
+	return NULL;
+}
+
+// Times the text occurs in the data
+static int occurrences(const char *data, size_t length, const char *text)
+{
+	int count = 0;
+	size_t text_len = strlen(text);
+	const char *p = data;
+	while ((p = memmem(p, length - (p - data), text, text_len)) != NULL) {
+		count++;
+		p += text_len;
+	}
+	return count;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2 || (strcmp(argv[1], "on") && strcmp(argv[1], "off"))) {
+		fprintf(stderr, "usage: %s on|off\n", argv[0]);
+		return 2;
+	}
+	bool early = (strcmp(argv[1], "on") == 0);
+
+	// STDOUT goes to a file until the end, so the mirrored records can be counted
+	fflush(stdout);
+	int saved_stdout = dup(STDOUT_FILENO);
+	FILE *output = tmpfile();
+	CHECK(output != NULL);
+	dup2(fileno(output), STDOUT_FILENO);
+
+	if (early) CHECK(net_logging_early_init(true) == ESP_OK);
+	for (int i=0;i<BOOT_RECORDS;i++) ESP_LOGI("BOOT", "boot record %d end", i);
+
+	pthread_t during;
+	pthread_create(&during, NULL, during_main, NULL);
+	uint16_t port = capture_start(false);
+	NET_LOGGING_CONFIG_t config = NET_LOGGING_CONFIG_DEFAULT();
+	config.buffer_size = 65536;
+	CHECK(net_logging_configure(&config) == ESP_OK);
+	CHECK(udp_logging_init("127.0.0.1", port, true) == ESP_OK);
+	vTaskDelay(pdMS_TO_TICKS(50));
+	__atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+	pthread_join(during, NULL);
+	size_t length = capture_wait(300);
+	const char *data = (const char *)capture_data();
+
+	fflush(stdout);
+	dup2(saved_stdout, STDOUT_FILENO);
+	long output_len = ftell(output);
+	char *text = malloc(output_len + 1);
+	CHECK(text != NULL);
+	rewind(output);
+	CHECK(fread(text, 1, output_len, output) == output_len);
+
+	char record[64];
+	int delivered = 0;
+	for (int i=0;i<BOOT_RECORDS;i++) {
+		snprintf(record, sizeof(record), "boot record %d end", i);
+		int count = occurrences(data, length, record);
+		CHECK(count <= 1);
+		delivered += count;
+		if (occurrences(text, output_len, record) != 1) {
+			printf("%s is on STDOUT %d times\n", record, occurrences(text, output_len, record));
+			return 1;
+		}
+	}
+	for (int i=0;i<during_count;i++) {
+		snprintf(record, sizeof(record), "during record %d end", i);
+		if (occurrences(text, output_len, record) != 1) {
+			printf("%s is on STDOUT %d times\n", record, occurrences(text, output_len, record));
+			return 1;
+		}
+		// Without the capture, the records before udp_logging_init took over only went to STDOUT
+		if (early && occurrences(data, length, record) != 1) {
+			printf("%s was sent %d times\n", record, occurrences(data, length, record));
+			return 1;
+		}
+	}
+	printf("early capture %s: boot records delivered %d of %d, %d records logged during init\n",
+		argv[1], delivered, BOOT_RECORDS, during_count);
+	CHECK(delivered == (early ? BOOT_RECORDS : 0));
+	return 0;
+}
@@ -0,0 +1,70 @@
+/*
+	Long record check
+
+	Two threads log records longer than one item at the same time, so their fragments interleave.
+	Records longer than NET_LOGGING_LONG_RECORD_SIZE are truncated to it.
+	The capture is saved for test_fragments.py, which puts the records together with netlog.RecordParser
+	and compares them with the records listed on stdout.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "net_logging.h"
+#include "capture.h"
+
+#define THREADS 2
+#define RECORDS 21
+// Message lengths around one item, several items and over the limit
+static const int message_length[] = { 100, xItemSize - 16, xItemSize, 500, 1000, CONFIG_NET_LOGGING_LONG_RECORD_SIZE - 60, 3000 };
+#define LENGTHS (sizeof(message_length) / sizeof(message_length[0]))
+
+static void *producer_main(void *arg)
+{
+	int thread = (intptr_t)arg;
+	for (int i=0;i<RECORDS;i++) {
+		int length = message_length[i % LENGTHS];
+		char letter = 'a' + (thread * RECORDS + i) % 26;
+		char text[length + 1];
+		memset(text, letter, length);
+		text[length] = 0;
+		ESP_LOGI("LONG", "thread %d record %d %s", thread, i, text);
+		// The records for test_fragments.py
+		printf("record %d %d %d\n", thread, i, length);
+		// Leave the sender time, a dropped fragment would lose its record
+		if (i % 3 == 2) vTaskDelay(pdMS_TO_TICKS(5));
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3 || (strcmp(argv[1], "udp") && strcmp(argv[1], "tcp"))) {
+		fprintf(stderr, "usage: %s udp|tcp <capture file>\n", argv[0]);
+		return 2;
+	}
+	bool tcp = (strcmp(argv[1], "tcp") == 0);
+	uint16_t port = capture_start(tcp);
+	NET_LOGGING_CONFIG_t config = NET_LOGGING_CONFIG_DEFAULT();
+	config.buffer_size = 65536;
+	if (net_logging_configure(&config) != ESP_OK) return 1;
+	esp_err_t ret = tcp ? tcp_logging_init("127.0.0.1", port, false) : udp_logging_init("127.0.0.1", port, false);
+	if (ret != ESP_OK) return 1;
+	// Let the sender connect
+	vTaskDelay(pdMS_TO_TICKS(200));
+
+	pthread_t threads[THREADS];
+	for (int i=0;i<THREADS;i++) pthread_create(&threads[i], NULL, producer_main, (void *)(intptr_t)i);
+	for (int i=0;i<THREADS;i++) pthread_join(threads[i], NULL);
+	ESP_LOGI("LAST", "done");
+
+	capture_wait(300);
+	return capture_save(argv[2]) ? 0 : 1;
+}
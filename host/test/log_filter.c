@@ -0,0 +1,129 @@
+/*
+	Log filter check
+
+	The level and the tag are found in ESP_LOGx format strings with and without colors
+	and with the system time, and other text is left alone.
+	Control settings are parsed, applied and rejected as documented in README.md.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "net_logging.h"
+#include "log_filter.h"
+#include "check.h"
+
+static bool parse(esp_log_level_t *level, const char **tag, const char *fmt, ...)
+{
+	va_list l;
+	va_start(l, fmt);
+	bool result = log_filter_parse(fmt, l, level, tag);
+	va_end(l);
+	return result;
+}
+
+static bool pass(const char *fmt, ...)
+{
+	va_list l;
+	va_start(l, fmt);
+	bool result = log_filter_pass(fmt, l);
+	va_end(l);
+	return result;
+}
+
+#define PASS(letter, tag) pass(LOG_FORMAT(letter, "record %d"), esp_log_timestamp(), tag, 1)
+
+static esp_err_t control(const char *command)
+{
+	return net_logging_control(command, strlen(command));
+}
+
+int main(int argc, char *argv[])
+{
+	esp_log_level_t level;
+	const char *tag;
+
+	// ESP_LOGx with and without colors, and with the system time of LOG_TIMESTAMP_SOURCE_SYSTEM
+	CHECK(parse(&level, &tag, LOG_FORMAT(E, "error %d"), 10, "ERR", 1));
+	CHECK(level == ESP_LOG_ERROR && strcmp(tag, "ERR") == 0);
+	CHECK(parse(&level, &tag, LOG_FORMAT(D, "debug"), 10, "DBG"));
+	CHECK(level == ESP_LOG_DEBUG && strcmp(tag, "DBG") == 0);
+	CHECK(parse(&level, &tag, "W (%lu) %s: plain\n", 10UL, "PLAIN"));
+	CHECK(level == ESP_LOG_WARN && strcmp(tag, "PLAIN") == 0);
+	CHECK(parse(&level, &tag, LOG_COLOR_I "I (%s) %s: system time" LOG_RESET_COLOR "\n", "12:00:00.000", "TIME"));
+	CHECK(level == ESP_LOG_INFO && strcmp(tag, "TIME") == 0);
+	CHECK(parse(&level, &tag, "V (%lu) %s: null tag\n", 10UL, NULL));
+	CHECK(level == ESP_LOG_VERBOSE && tag == NULL);
+	// Other text
+	CHECK(parse(&level, &tag, "plain text\n") == false);
+	CHECK(parse(&level, &tag, "") == false);
+	CHECK(parse(&level, &tag, "X (%lu) %s: unknown level\n", 10UL, "X") == false);
+	CHECK(parse(&level, &tag, "I (%lu) no tag\n", 10UL) == false);
+	CHECK(parse(&level, &tag, LOG_COLOR_E) == false);
+
+	// Everything passes by default, text always passes
+	CHECK(PASS(V, "wifi"));
+	CHECK(pass("plain text\n"));
+	CHECK(pass("V (%lu) %s: null tag\n", 10UL, NULL));
+
+	// The default level and one tag, separated by spaces, commas or semicolons
+	CHECK(control("*=W wifi=D") == ESP_OK);
+	CHECK(PASS(W, "app"));
+	CHECK(PASS(I, "app") == false);
+	CHECK(PASS(D, "wifi"));
+	CHECK(PASS(V, "wifi") == false);
+	CHECK(pass("V (%lu) %s: null tag\n", 10UL, NULL) == false);
+	CHECK(pass("plain text\n"));
+	CHECK(control("mqtt=e,http=i;;\n  tcp=N") == ESP_OK);
+	CHECK(PASS(E, "mqtt"));
+	CHECK(PASS(W, "mqtt") == false);
+	CHECK(PASS(I, "http"));
+	CHECK(PASS(E, "tcp") == false);
+	// "tag=-" goes back to the default level
+	CHECK(control("wifi=-") == ESP_OK);
+	CHECK(PASS(D, "wifi") == false);
+	CHECK(PASS(W, "wifi"));
+	// A removed tag can be set again
+	CHECK(control("wifi=V") == ESP_OK);
+	CHECK(PASS(V, "wifi"));
+
+	// Invalid settings are reported, the valid ones around them still apply
+	CHECK(control("app=X") != ESP_OK);
+	CHECK(control("app=") != ESP_OK);
+	CHECK(control("=I") != ESP_OK);
+	CHECK(control("app") != ESP_OK);
+	CHECK(control("app=II") != ESP_OK);
+	CHECK(control("this_tag_is_much_too_long_for_a_setting=I") == ESP_ERR_INVALID_SIZE);
+	CHECK(control("bad good=V") != ESP_OK);
+	CHECK(PASS(V, "good"));
+	// Rate settings need the rate limit
+	CHECK(control("app@I=5/10") == ESP_ERR_NOT_SUPPORTED);
+	CHECK(control("app@X=5") == ESP_ERR_INVALID_ARG);
+	CHECK(control("app=70000") == ESP_ERR_INVALID_ARG);
+
+	// Only the given length is read
+	CHECK(net_logging_control("solo=E trailing=E", 6) == ESP_OK);
+	CHECK(PASS(W, "solo") == false);
+	CHECK(PASS(W, "trailing"));
+
+	// A full table refuses new tags, but existing tags can still change
+	char name[16];
+	esp_err_t ret = ESP_OK;
+	for (int i=0; i<CONFIG_NET_LOGGING_FILTER_TAGS && ret == ESP_OK; i++) {
+		snprintf(name, sizeof(name), "tag%d", i);
+		ret = net_logging_set_level(name, ESP_LOG_ERROR);
+	}
+	CHECK(ret == ESP_ERR_NO_MEM);
+	CHECK(net_logging_set_level("wifi", ESP_LOG_ERROR) == ESP_OK);
+	CHECK(PASS(W, "wifi") == false);
+	CHECK(net_logging_set_level(NULL, ESP_LOG_ERROR) == ESP_ERR_INVALID_ARG);
+	CHECK(net_logging_set_level("wifi", ESP_LOG_VERBOSE + 1) == ESP_ERR_INVALID_ARG);
+	printf("ok\n");
+	return 0;
+}
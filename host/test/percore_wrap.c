@@ -0,0 +1,65 @@
+/*
+	Per-core ring wrap check
+
+	More than 4 GB of records go through a per-core ring whose size is not a power of two,
+	so the offsets pass the point where a 32-bit byte counter wraps around.
+	Every record must come out as it went in.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "percore_ring.h"
+#include "check.h"
+
+#define RECORD_SIZE 60000
+// Three records and a little, not a power of two
+#define RING_SIZE (3 * (RECORD_SIZE + 12) + 100)
+
+static void fill(char *record, uint32_t index)
+{
+	memset(record, 'a' + index % 26, RECORD_SIZE);
+	memcpy(record, &index, sizeof(index));
+}
+
+int main(int argc, char *argv[])
+{
+	static char record[RECORD_SIZE];
+	static char expected[RECORD_SIZE];
+	CHECK(percore_ring_create(RING_SIZE, 0));
+
+	// The reader stays two records behind, so the ring is nearly full of unread records
+	// and a record written to the wrong place overwrites one of them
+	uint64_t total = 0;
+	uint32_t index = 0;
+	for (uint32_t i=0;i<2;i++) {
+		fill(record, i);
+		CHECK(percore_ring_send(record, RECORD_SIZE));
+		total += RECORD_SIZE;
+	}
+	while (total < (1ULL << 32) + 8 * RING_SIZE) {
+		fill(record, index + 2);
+		CHECK(percore_ring_send(record, RECORD_SIZE));
+		total += RECORD_SIZE;
+		CHECK(percore_ring_receive(record, sizeof(record), 0) == RECORD_SIZE);
+		fill(expected, index);
+		if (memcmp(record, expected, RECORD_SIZE) != 0) {
+			printf("record %u differs after %llu bytes\n", index, (unsigned long long)total);
+			return 1;
+		}
+		index++;
+	}
+	for (int i=0;i<2;i++) {
+		CHECK(percore_ring_receive(record, sizeof(record), 0) == RECORD_SIZE);
+		index++;
+	}
+	CHECK(percore_ring_receive(record, sizeof(record), 0) == 0);
+	printf("%u records, %llu bytes\n", index, (unsigned long long)total);
+	return 0;
+}
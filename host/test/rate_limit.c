@@ -0,0 +1,122 @@
+/*
+	Rate limit check
+
+	Several threads log one tag as fast as they can, only the burst and the refill may pass.
+	Errors pass unless a rate is set for them, and the suppressed records are summarized once.
+	A tag logged at a steady rate below its limit passes whole while another thread floods a second tag.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "net_logging.h"
+#include "rate_limit.h"
+#include "check.h"
+
+#define THREADS 4
+#define RECORDS 20000
+#define STEADY_RECORDS 100
+
+static bool pass(const char *fmt, ...)
+{
+	va_list l;
+	va_start(l, fmt);
+	bool result = rate_limit_pass(fmt, l);
+	va_end(l);
+	return result;
+}
+
+#define PASS(level, tag) pass(LOG_FORMAT(level, "record"), esp_log_timestamp(), tag)
+
+static uint32_t passed;
+
+static void *storm(void *arg)
+{
+	for (int i=0;i<RECORDS;i++) {
+		if (PASS(I, "storm")) __atomic_fetch_add(&passed, 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+static bool flooding;
+
+static void *flood(void *arg)
+{
+	while (__atomic_load_n(&flooding, __ATOMIC_ACQUIRE)) PASS(I, "flood");
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	char report[128];
+
+	// Threads race for the same bucket, and for the same empty slot on the first record
+	uint32_t start = esp_log_timestamp();
+	pthread_t threads[THREADS];
+	for (int i=0;i<THREADS;i++) pthread_create(&threads[i], NULL, storm, NULL);
+	for (int i=0;i<THREADS;i++) pthread_join(threads[i], NULL);
+	uint32_t elapsed = esp_log_timestamp() - start;
+	uint32_t refill = (elapsed + 1) * CONFIG_NET_LOGGING_RATE_LIMIT_RATE / 1000 + 1;
+	printf("%u of %u records passed in %u ms\n", passed, THREADS * RECORDS, elapsed);
+	CHECK(passed >= CONFIG_NET_LOGGING_RATE_LIMIT_BURST);
+	CHECK(passed <= CONFIG_NET_LOGGING_RATE_LIMIT_BURST + refill);
+	CHECK(rate_limit_suppressed() == THREADS * RECORDS - passed);
+
+	// Errors are not limited by default
+	for (int i=0;i<1000;i++) CHECK(PASS(E, "storm"));
+	// Records without a tag are not limited
+	for (int i=0;i<1000;i++) CHECK(pass("plain record\n"));
+
+	// The summary comes once the tag was suppressed for a second
+	CHECK(rate_limit_report(report, sizeof(report)) == 0);
+	vTaskDelay(pdMS_TO_TICKS(1100));
+	CHECK(rate_limit_report(report, sizeof(report)) > 0);
+	printf("%s", report);
+	char expected[64];
+	snprintf(expected, sizeof(expected), "tag storm level I suppressed %u lines", THREADS * RECORDS - passed);
+	CHECK(strstr(report, expected) != NULL);
+	CHECK(rate_limit_report(report, sizeof(report)) == 0);
+
+	// The default of all levels leaves errors alone, a rate of 0 removes the limit
+	CHECK(net_logging_set_rate("*", ESP_LOG_NONE, 0, 0) == ESP_OK);
+	for (int i=0;i<1000;i++) CHECK(PASS(W, "storm"));
+	// Errors are limited when their level is named
+	CHECK(net_logging_set_rate("storm", ESP_LOG_ERROR, 1, 2) == ESP_OK);
+	CHECK(PASS(E, "storm"));
+	CHECK(PASS(E, "storm"));
+	CHECK(PASS(E, "storm") == false);
+	CHECK(PASS(E, "other"));
+	// The same settings as control settings
+	CHECK(net_logging_control("quiet@D=1/3", 11) == ESP_OK);
+	for (int i=0;i<3;i++) CHECK(PASS(D, "quiet"));
+	CHECK(PASS(D, "quiet") == false);
+	CHECK(PASS(I, "quiet"));
+
+	// At most 100 records/s against a rate of 200, for twenty times the burst.
+	// The default was removed above, so the flood gets a rate of its own.
+	CHECK(net_logging_set_rate("steady", ESP_LOG_INFO, 200, 5) == ESP_OK);
+	CHECK(net_logging_set_rate("flood", ESP_LOG_INFO, 20, 50) == ESP_OK);
+	uint32_t suppressed = rate_limit_suppressed();
+	__atomic_store_n(&flooding, true, __ATOMIC_RELEASE);
+	pthread_t flooder;
+	pthread_create(&flooder, NULL, flood, NULL);
+	int steady = 0;
+	for (int i=0;i<STEADY_RECORDS;i++) {
+		if (PASS(I, "steady")) steady++;
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	__atomic_store_n(&flooding, false, __ATOMIC_RELEASE);
+	pthread_join(flooder, NULL);
+	printf("steady tag: %d of %d records passed, %u flood records suppressed\n", steady, STEADY_RECORDS, rate_limit_suppressed() - suppressed);
+	CHECK(steady == STEADY_RECORDS);
+	CHECK(rate_limit_suppressed() - suppressed > STEADY_RECORDS);
+	printf("ok\n");
+	return 0;
+}
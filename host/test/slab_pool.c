@@ -0,0 +1,114 @@
+/*
+	Slab pool contention check
+
+	Several threads send records of every length into a small pool while one consumer
+	reads them in place and gives the slots back, so the free lists are popped and pushed
+	by all threads at once. Each record must come out whole, once, and in the order of its thread.
+	At the end every slot must be free again.
+	After a burst of short records has carved every page, long records must fill the pool again.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "slab_pool.h"
+#include "check.h"
+
+#define THREADS 4
+#define RECORDS 20000
+#define MAX_LENGTH 256
+#define POOL_SIZE 16384
+
+typedef struct {
+	uint16_t thread;
+	uint16_t length;
+	uint32_t sequence;
+} RECORD_HEADER_t;
+
+static uint32_t full; // Sends refused because the pool was full
+
+static void *producer_main(void *arg)
+{
+	int thread = (intptr_t)arg;
+	uint8_t record[MAX_LENGTH];
+	for (uint32_t i=0;i<RECORDS;i++) {
+		RECORD_HEADER_t header = { .thread = thread, .sequence = i };
+		header.length = sizeof(header) + (i * 7 + thread) % (MAX_LENGTH - sizeof(header) + 1);
+		memcpy(record, &header, sizeof(header));
+		memset(&record[sizeof(header)], (thread * 31 + i) & 0xff, header.length - sizeof(header));
+		while (slab_pool_send(record, header.length) == false) {
+			__atomic_fetch_add(&full, 1, __ATOMIC_RELAXED);
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	CHECK(slab_pool_create(POOL_SIZE, MAX_LENGTH, 0));
+	pthread_t threads[THREADS];
+	for (int i=0;i<THREADS;i++) pthread_create(&threads[i], NULL, producer_main, (void *)(intptr_t)i);
+
+	uint32_t next[THREADS] = { 0 };
+	for (uint32_t received=0; received<THREADS * RECORDS; received++) {
+		size_t length = 0;
+		const uint8_t *record = slab_pool_acquire(&length, pdMS_TO_TICKS(5000));
+		CHECK(record != NULL);
+		RECORD_HEADER_t header;
+		CHECK(length >= sizeof(header));
+		memcpy(&header, record, sizeof(header));
+		CHECK(header.thread < THREADS);
+		CHECK(header.length == length);
+		if (header.sequence != next[header.thread]) {
+			printf("thread %u record %u came after %u\n", header.thread, header.sequence, next[header.thread]);
+			return 1;
+		}
+		next[header.thread]++;
+		for (size_t i=sizeof(header); i<length; i++) {
+			if (record[i] != ((header.thread * 31 + header.sequence) & 0xff)) {
+				printf("thread %u record %u overwritten at byte %zu\n", header.thread, header.sequence, i);
+				return 1;
+			}
+		}
+		slab_pool_release(record);
+	}
+	for (int i=0;i<THREADS;i++) pthread_join(threads[i], NULL);
+
+	// Nothing left, and every slot is free again
+	size_t length;
+	CHECK(slab_pool_acquire(&length, 0) == NULL);
+	CHECK(slab_pool_used() == 0);
+	// A burst of short records takes every page, once they are released the pages go back
+	uint8_t record[MAX_LENGTH] = { 0 };
+	int count = 0;
+	while (slab_pool_send(record, 40)) count++;
+	CHECK(count > POOL_SIZE / MAX_LENGTH);
+	const void *data;
+	while ((data = slab_pool_acquire(&length, 0))) {
+		CHECK(length == 40);
+		slab_pool_release(data);
+		count--;
+	}
+	CHECK(count == 0);
+	CHECK(slab_pool_used() == 0);
+	// So long records fill the whole pool again
+	while (slab_pool_send(record, MAX_LENGTH)) count++;
+	CHECK(count == POOL_SIZE / MAX_LENGTH);
+	while ((data = slab_pool_acquire(&length, 0))) {
+		slab_pool_release(data);
+		count--;
+	}
+	CHECK(count == 0);
+	printf("%d records, pool full %u times\n", THREADS * RECORDS, full);
+	return 0;
+}
@@ -0,0 +1,161 @@
+/*
+	Flash spool check
+
+	The sender is offline: records are moved from the sink to a partition in RAM that behaves like flash.
+	Then it is back online: the spooled records come first, in order and at the replay rate,
+	while the live records are not held back. Every block is marked as replayed afterwards.
+	A spool that is written past its end keeps the newest records,
+	and the full blocks are found again when the spool is opened after a reset.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_partition.h"
+#include "net_logging.h"
+#include "sink.h"
+#include "spool.h"
+#include "check.h"
+
+#define STORED 300
+#define LIVE 20
+#define LIVE_FIRST 1000
+#define WRAP_RECORDS 400
+#define WRAP_FIRST 2000
+#define RECORD_LEN 100
+
+static SINK_t *sink;
+
+static void publish(int index)
+{
+	char record[RECORD_LEN];
+	int length = snprintf(record, sizeof(record), "I (%d) SPOOL: record %05d ", index, index);
+	CHECK(length < RECORD_LEN);
+	memset(&record[length], '.', RECORD_LEN - length);
+	record[RECORD_LEN - 1] = '\n';
+	sink_publish(record, RECORD_LEN);
+}
+
+// Offline: the sender moves the records from the sink to the spool between connection attempts
+static void store(int first, int count)
+{
+	for (int i=0;i<count;i++) {
+		publish(first + i);
+		if (i % 50 == 49) spool_store(sink, pdMS_TO_TICKS(5));
+	}
+	spool_store(sink, pdMS_TO_TICKS(5));
+}
+
+// Blocks on the partition, all of them or only those not replayed yet
+static int blocks(const esp_partition_t *partition, bool pending)
+{
+	int count = 0;
+	for (size_t offset=0; offset<partition->size; offset+=SPOOL_BLOCK_SIZE) {
+		struct {
+			uint16_t magic;
+			uint16_t length;
+			uint32_t seq;
+			uint32_t crc;
+			uint32_t state;
+		} header;
+		CHECK(esp_partition_read(partition, offset, &header, sizeof(header)) == ESP_OK);
+		if (header.magic != 0x4c53) continue;
+		if (pending == false || header.state != 0) count++;
+	}
+	return count;
+}
+
+// Back online: receive until the spool is empty and count records came, returns the tick of the last spooled record
+static TickType_t replay(int count, int *first, int *last, int *live)
+{
+	TickType_t last_tick = 0;
+	TickType_t start = xTaskGetTickCount();
+	*first = -1;
+	*live = 0;
+	int received = 0;
+	while (xTaskGetTickCount() - start < pdMS_TO_TICKS(20000)) {
+		char buffer[xItemSize];
+		size_t length = spool_sink_receive(sink, buffer, sizeof(buffer), pdMS_TO_TICKS(10));
+		if (length == 0) {
+			if (spool_pending() == false && received >= count) break;
+			continue;
+		}
+		CHECK(length == RECORD_LEN);
+		int index;
+		CHECK(sscanf(buffer, "I (%*d) SPOOL: record %d", &index) == 1);
+		received++;
+		if (index >= LIVE_FIRST && index < LIVE_FIRST + LIVE) {
+			CHECK(index == LIVE_FIRST + *live);
+			(*live)++;
+			continue;
+		}
+		// Spooled records come in order, without gaps
+		if (*first < 0) *first = index;
+		else CHECK(index == *last + 1);
+		*last = index;
+		last_tick = xTaskGetTickCount();
+	}
+	return last_tick;
+}
+
+int main(int argc, char *argv[])
+{
+	CHECK(sink_create(65536, 0) == ESP_OK);
+	sink = sink_register("TCP", true);
+	CHECK(sink != NULL);
+
+	// Store
+	const esp_partition_t *partition = shim_partition_add(CONFIG_NET_LOGGING_SPOOL_PARTITION, 16 * 4096);
+	CHECK(partition != NULL);
+	CHECK(spool_open(CONFIG_NET_LOGGING_SPOOL_PARTITION));
+	CHECK(spool_pending() == false);
+	store(0, STORED);
+	CHECK(spool_pending());
+	// Records are written block by block, the last block is still in RAM
+	int stored_blocks = blocks(partition, true);
+	CHECK(stored_blocks == STORED / ((SPOOL_BLOCK_SIZE - 16) / (RECORD_LEN + 2)));
+
+	// Replay, live records go along
+	for (int i=0;i<LIVE;i++) publish(LIVE_FIRST + i);
+	TickType_t start = xTaskGetTickCount();
+	int first, last, live;
+	TickType_t last_tick = replay(STORED + LIVE, &first, &last, &live);
+	CHECK(first == 0 && last == STORED - 1 && live == LIVE);
+	CHECK(spool_pending() == false);
+	CHECK(blocks(partition, true) == 0);
+	// The first second of the rate is available at once
+	uint32_t replay_ms = (last_tick - start) * portTICK_PERIOD_MS;
+	uint32_t expected_ms = (uint64_t)(STORED * RECORD_LEN - CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE) * 1000 / CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE;
+	printf("stored %d records in %d blocks, replayed in %"PRIu32" ms at %d bytes/s (at least %"PRIu32" ms)\n",
+		STORED, stored_blocks, replay_ms, CONFIG_NET_LOGGING_SPOOL_REPLAY_RATE, expected_ms);
+	CHECK(replay_ms >= expected_ms * 9 / 10 && replay_ms <= expected_ms * 2);
+
+	// Wrap: four sectors hold fewer records than are stored.
+	// The sector after the write position is given up, so that a full spool does not look empty.
+	const esp_partition_t *small = shim_partition_add("wrap", 4 * 4096);
+	CHECK(small != NULL);
+	CHECK(spool_open("wrap"));
+	store(WRAP_FIRST, WRAP_RECORDS);
+	// A reset loses the block in RAM, the blocks on flash are replayed
+	CHECK(spool_open("wrap"));
+	CHECK(spool_pending());
+	int per_block = (SPOOL_BLOCK_SIZE - 16) / (RECORD_LEN + 2);
+	int wrap_blocks = 3 * 4;
+	replay(0, &first, &last, &live);
+	printf("wrap: records %d to %d of %d to %d kept\n", first, last, WRAP_FIRST, WRAP_FIRST + WRAP_RECORDS - 1);
+	CHECK(first > WRAP_FIRST && last < WRAP_FIRST + WRAP_RECORDS && last >= WRAP_FIRST + WRAP_RECORDS - per_block);
+	CHECK(last - first + 1 == wrap_blocks * per_block);
+	CHECK(live == 0);
+	CHECK(spool_pending() == false);
+	// Nothing is replayed twice after the next reset
+	CHECK(spool_open("wrap"));
+	CHECK(spool_pending() == false);
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,99 @@
+/*
+	Sink statistics check
+
+	More records are published than the fan-out ring holds, so the ring wraps before the sink reads.
+	net_logging_get_stats must then report the overwritten records as lost,
+	and the bytes and packets the sender counted with sink_sent.
+	Packets sent 20 ms after their record was published fall into the 16-31 ms latency bucket.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "net_logging.h"
+#include "sink.h"
+#include "check.h"
+
+#define RECORD_LEN 100
+// The ring holds 9 records of 100 bytes and their 8-byte headers
+#define RING_SIZE 1024
+#define RING_RECORDS (RING_SIZE / (RECORD_LEN + 8))
+#define PUBLISHED 20
+#define DELAY_MS 20
+
+static void publish(int index)
+{
+	char record[RECORD_LEN];
+	memset(record, '.', sizeof(record));
+	int length = snprintf(record, sizeof(record), "I (%d) STATS: record %d", index, index);
+	record[length] = ' ';
+	record[RECORD_LEN - 1] = '\n';
+	sink_publish(record, RECORD_LEN);
+}
+
+static NET_LOGGING_SINK_STATS_t *find(NET_LOGGING_STATS_t *stats, const char *name)
+{
+	for (int i=0;i<stats->sink_count;i++) {
+		if (strcmp(stats->sinks[i].name, name) == 0) return &stats->sinks[i];
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	CHECK(sink_create(RING_SIZE, 0) == ESP_OK);
+	SINK_t *sink = sink_register("TEST", false);
+	CHECK(sink != NULL);
+
+	// The ring wraps, the oldest records are overwritten before the sink reads them
+	for (int i=0;i<PUBLISHED;i++) publish(i);
+	vTaskDelay(pdMS_TO_TICKS(DELAY_MS));
+
+	// The sender gets the lost marker first, then the records that are left, and sends each one
+	char buffer[xItemSize];
+	uint32_t bytes = 0;
+	uint32_t packets = 0;
+	int records = 0;
+	size_t received;
+	while ((received = sink_receive(sink, buffer, sizeof(buffer), 0)) > 0) {
+		if (received == RECORD_LEN) {
+			int index;
+			CHECK(sscanf(buffer, "I (%*d) STATS: record %d", &index) == 1);
+			CHECK(index == PUBLISHED - RING_RECORDS + records);
+			records++;
+		} else {
+			CHECK(strstr(buffer, "TEST sink lost 11 records") != NULL);
+		}
+		sink_sent(sink, received, true);
+		bytes += received;
+		packets++;
+	}
+	CHECK(records == RING_RECORDS);
+	// A failed send counts an error, but neither bytes nor a packet
+	sink_sent(sink, RECORD_LEN, false);
+
+	NET_LOGGING_STATS_t stats;
+	net_logging_get_stats(&stats);
+	NET_LOGGING_SINK_STATS_t *result = find(&stats, "TEST");
+	CHECK(result != NULL);
+	printf("lost=%"PRIu32" bytes=%"PRIu32" packets=%"PRIu32" errors=%"PRIu32" backlog_hwm=%"PRIu32"\n",
+		result->lost, result->bytes, result->packets, result->errors, result->backlog_high_water);
+	CHECK(result->lost == PUBLISHED - RING_RECORDS);
+	CHECK(result->bytes == bytes);
+	CHECK(result->packets == packets);
+	CHECK(result->errors == 1);
+	CHECK(result->backlog_high_water == RING_RECORDS * (RECORD_LEN + 8));
+	// Each packet with a record measures its latency, the marker is not a record of the ring
+	uint32_t measured = 0;
+	for (int bucket=0; bucket<NET_LOGGING_LATENCY_BUCKETS; bucket++) measured += result->latency[bucket];
+	CHECK(measured == RING_RECORDS);
+	CHECK(result->latency[5] == RING_RECORDS);
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,42 @@
+/*
+	TCP syslog check
+
+	Records logged here are sent by the TCP sender in syslog format.
+	The captured stream is saved for test_tcp_syslog.py, which splits it
+	with netlog.OctetCounting and checks each message with netlog.parse_syslog.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "net_logging.h"
+#include "capture.h"
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <capture file>\n", argv[0]);
+		return 2;
+	}
+	uint16_t port = capture_start(true);
+	if (tcp_logging_init("127.0.0.1", port, false) != ESP_OK) return 1;
+
+	ESP_LOGE("ERR", "error %d", 1);
+	ESP_LOGW("WARN", "warning with \"quotes\" and [brackets]");
+	ESP_LOGI("INFO", "info %s", "text");
+	// More records than fit into one batch
+	for (int i=0;i<100;i++) {
+		ESP_LOGI("BATCH", "record %d", i);
+		if (i % 10 == 9) vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	ESP_LOGI("LAST", "done");
+
+	capture_wait(300);
+	return capture_save(argv[1]) ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+# Decode the compact streams of the compact_format check with netlog.RecordParser
+
+import os
+import sys
+import argparse
+import subprocess
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+import netlog
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser()
+	parser.add_argument('program', help='compact_format program')
+	args = parser.parse_args()
+
+	with tempfile.TemporaryDirectory() as directory:
+		path = os.path.join(directory, 'streams')
+		subprocess.run([args.program, path], check=True, stdout=subprocess.DEVNULL)
+		with open(path) as f:
+			streams = [bytes.fromhex(line) for line in f.read().split()]
+	expected = streams.pop().decode()
+
+	# One parser per connection, fed in small pieces so that frames are split
+	text = ''
+	for stream in streams:
+		records = netlog.RecordParser()
+		for pos in range(0, len(stream), 5):
+			text += ''.join(records.feed(stream[pos:pos+5]))
+		assert records.pending == b'', 'stream ends inside a frame'
+
+	for line, expected_line in zip(text.splitlines(), expected.splitlines()):
+		assert line == expected_line, '{!r} expected {!r}'.format(line, expected_line)
+	assert text == expected
+	print('{} records'.format(len(expected.splitlines())))
@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+# Decompress the frames of the compress check with netlog.lz4_decompress
+
+import os
+import sys
+import argparse
+import subprocess
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+import netlog
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser()
+	parser.add_argument('program', help='compress program')
+	args = parser.parse_args()
+
+	with tempfile.TemporaryDirectory() as directory:
+		path = os.path.join(directory, 'frames')
+		subprocess.run([args.program, path], check=True, stdout=subprocess.DEVNULL)
+		with open(path) as f:
+			lines = f.read().split()
+
+	count = 0
+	for frame, data in zip(lines[0::2], lines[1::2]):
+		frame = bytes.fromhex(frame)
+		data = bytes.fromhex(data)
+		assert netlog.decompress_frame(frame) == data, 'frame {} differs'.format(count)
+		count += 1
+	assert count > 0
+
+	# The first frame holds text records, the parser returns them as they were
+	frame = bytes.fromhex(lines[0])
+	records = netlog.RecordParser()
+	text = ''.join(records.feed(frame))
+	assert text == bytes.fromhex(lines[1]).decode(), 'records differ'
+	print('{} frames'.format(count))
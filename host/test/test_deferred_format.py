@@ -0,0 +1,32 @@
+#!/usr/bin/env python3
+# Format the records of the deferred_format check with netlog.format_deferred
+
+import os
+import sys
+import argparse
+import subprocess
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+import netlog
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser()
+	parser.add_argument('program', help='deferred_format program')
+	args = parser.parse_args()
+
+	with tempfile.TemporaryDirectory() as directory:
+		path = os.path.join(directory, 'records')
+		subprocess.run([args.program, path], check=True, stdout=subprocess.DEVNULL)
+		with open(path) as f:
+			lines = f.read().split()
+
+	count = 0
+	for fmt, record, expected in zip(lines[0::3], lines[1::3], lines[2::3]):
+		fmt = bytes.fromhex(fmt).decode()
+		text = netlog.format_deferred(fmt, bytes.fromhex(record))
+		expected = bytes.fromhex(expected).decode()
+		assert text == expected, '{!r}: {!r} expected {!r}'.format(fmt, text, expected)
+		count += 1
+	assert count > 0
+	print('{} records'.format(count))
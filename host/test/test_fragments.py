@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Put the long records of the fragments check together with netlog.RecordParser
+
+import os
+import re
+import sys
+import struct
+import argparse
+import subprocess
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+import netlog
+
+LONG_RECORD = re.compile(r'(?:\x1b\[[0-9;]*m)?I \(\d+\) LONG: thread (\d+) record (\d+) ([a-z]*)(\x1b\[0m)?\n')
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser()
+	parser.add_argument('program', help='fragments program')
+	parser.add_argument('protocol', choices=['udp', 'tcp'])
+	parser.add_argument('--long-record-size', type=int, default=2048, help='NET_LOGGING_LONG_RECORD_SIZE')
+	args = parser.parse_args()
+
+	with tempfile.TemporaryDirectory() as directory:
+		path = os.path.join(directory, 'capture')
+		output = subprocess.run([args.program, args.protocol, path], check=True, stdout=subprocess.PIPE).stdout.decode()
+		with open(path, 'rb') as f:
+			capture = f.read()
+	expected = {}
+	for line in output.splitlines():
+		if not line.startswith('record '): continue
+		thread, record, length = map(int, line.split()[1:])
+		expected[(thread, record)] = length
+
+	per_thread = sum(1 for thread, record in expected if thread == 0)
+
+	records = netlog.RecordParser()
+	text = []
+	if args.protocol == 'udp':
+		# Each datagram has its length in front
+		pos = 0
+		while pos < len(capture):
+			length = struct.unpack_from('<H', capture, pos)[0]
+			records.new_datagram()
+			text += records.feed(capture[pos+2:pos+2+length])
+			pos += 2 + length
+	else:
+		for pos in range(0, len(capture), 100):
+			text += records.feed(capture[pos:pos+100])
+	text = ''.join(text)
+	assert '[fragments lost]' not in text, 'fragments lost'
+	assert records.fragments == {}, 'records not finished'
+
+	found = {}
+	for match in LONG_RECORD.finditer(text):
+		thread, record, letters = int(match.group(1)), int(match.group(2)), match.group(3)
+		assert letters == chr(ord('a') + (thread * per_thread + record) % 26) * len(letters), 'record {} {} is mixed'.format(thread, record)
+		length = expected.get((thread, record))
+		assert length is not None, 'record {} {} was not logged'.format(thread, record)
+		if len(match.group(0)) - 1 == args.long_record_size:
+			# Truncated, the line end is added by the parser
+			assert len(letters) < length and match.group(4) is None, 'record {} {} is cut short'.format(thread, record)
+		else:
+			assert len(letters) == length, 'record {} {} has {} of {} letters'.format(thread, record, len(letters), length)
+		assert (thread, record) not in found, 'record {} {} twice'.format(thread, record)
+		found[(thread, record)] = len(letters)
+	missing = sorted(set(expected) - set(found))
+	assert not missing, 'records missing: {}'.format(missing)
+	assert 'LAST: done' in text
+	truncated = sum(1 for key in found if found[key] < expected[key])
+	print('{} records, {} truncated'.format(len(found), truncated))
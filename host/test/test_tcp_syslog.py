@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+# Check the octet counted syslog stream of the TCP sender
+
+import os
+import sys
+import argparse
+import subprocess
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+import netlog
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser()
+	parser.add_argument('program', help='tcp_syslog program')
+	args = parser.parse_args()
+
+	with tempfile.TemporaryDirectory() as directory:
+		path = os.path.join(directory, 'capture')
+		subprocess.run([args.program, path], check=True, stdout=subprocess.DEVNULL)
+		with open(path, 'rb') as f:
+			stream = f.read()
+
+	# Feed the stream in small pieces, so that counts and messages are split
+	framing = netlog.OctetCounting()
+	messages = []
+	for pos in range(0, len(stream), 7):
+		messages += framing.feed(stream[pos:pos+7])
+	assert framing.pending == b'', 'stream ends inside a message'
+
+	fields = [netlog.parse_syslog(message) for message in messages]
+	apps = [field['app'] for field in fields]
+	assert apps[:3] == ['ERR', 'WARN', 'INFO'], apps[:3]
+	assert [field['severity'] for field in fields[:3]] == [3, 4, 6]
+	assert all(field['facility'] == 16 for field in fields)
+	assert fields[0]['message'] == 'error 1', fields[0]['message']
+	assert fields[1]['message'] == 'warning with "quotes" and [brackets]', fields[1]['message']
+	batch = [field['message'] for field in fields if field['app'] == 'BATCH']
+	assert batch == ['record {}'.format(i) for i in range(100)], batch
+	assert apps[-1] == 'LAST'
+	print('{} messages in {} bytes'.format(len(messages), len(stream)))
@@ -10,8 +10,13 @@ from http.server import BaseHTTPRequestHandler
 from urllib.parse import urlparse
 from urllib.parse import parse_qs
 import argparse
+import json
+import netlog
 
 class class1(BaseHTTPRequestHandler):
+	# Keep the connection open between posts
+	protocol_version = "HTTP/1.1"
+
 	def do_POST(self):
 		#parsed = urlparse(self.path)
 		#print("parsed={}".format(parsed))
@@ -19,14 +24,28 @@ class class1(BaseHTTPRequestHandler):
 		#print("params={}".format(params))
 		content_len  = int(self.headers.get("content-length"))
 		#print("content_len={}".format(content_len))
-		req_body = self.rfile.read(content_len).decode("utf-8")
+		req_body = self.rfile.read(content_len)
+		if self.headers.get("content-encoding") == netlog.COMPRESS_ENCODING:
+			req_body = netlog.decompress_frame(req_body)
+		req_body = req_body.decode("utf-8")
 		#print("req_body={}".format(req_body))
-		print("{}".format(req_body))
+		# A batched post is a JSON array of records
+		try:
+			records = json.loads(req_body)
+		except ValueError:
+			records = None
+		if type(records) is list:
+			for record in records:
+				print("{}".format(record))
+		else:
+			print("{}".format(req_body))
 
 		body = "OK"
 		self.send_response(200)
 		self.send_header('Content-type', 'text/html; charset=utf-8')
 		self.send_header('Content-length', len(body.encode()))
+		# Tell the client that compressed posts are accepted (RFC 7694)
+		self.send_header('Accept-Encoding', netlog.COMPRESS_ENCODING)
 		self.end_headers()
 		self.wfile.write(body.encode())
 
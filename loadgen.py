@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Load generator for collector.py.
+# Simulates devices that send ESP log records over UDP, TCP or HTTP.
+# Each device sends from its own loopback address, so the collector sees it as its own device.
+# With --outdir, the files written by the collector are read back to count the lost records.
+
+import argparse
+import asyncio
+import ipaddress
+import json
+import os
+import random
+import re
+import socket
+import struct
+import time
+import uuid
+
+# Records are sent in bursts this often
+TICK = 0.01
+
+def record(run, device, seq, start):
+	timestamp = int((time.monotonic() - start) * 1000)
+	return 'I ({}) LOADGEN: run={} device={} seq={}\n'.format(timestamp, run, device, seq)
+
+class Device:
+	def __init__(self, args, index, run, start):
+		self.args = args
+		self.index = index
+		self.run = run
+		self.start = start
+		self.source = str(ipaddress.ip_address(args.source) + index)
+		self.sent = 0
+		self.failed = 0
+
+	def burst(self, count):
+		records = [record(self.run, self.index, self.sent + i, self.start) for i in range(count)]
+		self.sent += count
+		return records
+
+	async def send(self, deadline):
+		# Spread the devices over the first tick
+		await asyncio.sleep(TICK * self.index / self.args.devices)
+		budget = 0.0
+		next_tick = time.monotonic()
+		while time.monotonic() < deadline:
+			budget += self.args.rate * TICK
+			count = int(budget)
+			budget -= count
+			if count:
+				try:
+					await self.send_records(self.burst(count))
+				except OSError:
+					self.failed += count
+			next_tick += TICK
+			await asyncio.sleep(max(0, next_tick - time.monotonic()))
+		await self.close()
+
+class UdpDevice(Device):
+	async def open(self):
+		self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+		self.sock.bind((self.source, 0))
+		self.sock.setblocking(False)
+		self.address = (self.args.host, self.args.port)
+		self.boot_id = random.getrandbits(32) | 1
+		self.datagrams = 0
+
+	async def send_records(self, records):
+		# Records are packed into datagrams like UDP batching
+		for i in range(0, len(records), self.args.batch):
+			batch = records[i:i+self.args.batch]
+			data = ''.join(batch).encode()
+			if self.args.sequence:
+				# Same as the sequence frame of udp_client.c
+				data = struct.pack('<BBHIIH', 0, ord('S'), 14, self.boot_id, self.datagrams, len(batch)) + data
+			self.datagrams += 1
+			self.sock.sendto(data, self.address)
+
+	async def close(self):
+		self.sock.close()
+
+class TcpDevice(Device):
+	async def open(self):
+		self.reader, self.writer = await asyncio.open_connection(self.args.host, self.args.port, local_addr=(self.source, 0))
+
+	async def send_records(self, records):
+		self.writer.write(''.join(records).encode())
+		await self.writer.drain()
+
+	async def close(self):
+		self.writer.close()
+
+class HttpDevice(TcpDevice):
+	async def send_records(self, records):
+		body = json.dumps([r.rstrip('\n') for r in records]).encode()
+		self.writer.write(('POST /post HTTP/1.1\r\nHost: {}\r\nContent-Type: application/json\r\n'
+			'Content-Length: {}\r\n\r\n').format(self.args.host, len(body)).encode() + body)
+		await self.writer.drain()
+		header = await self.reader.readuntil(b'\r\n\r\n')
+		length = re.search(rb'Content-Length: (\d+)', header, re.I)
+		await self.reader.readexactly(int(length.group(1)) if length else 0)
+
+def count_received(outdir, run):
+	"""Count the records of this run in the files written by the collector."""
+	pattern = re.compile(r'run={} device=(\d+) seq=(\d+)'.format(run))
+	received = set()
+	for name in os.listdir(outdir):
+		with open(os.path.join(outdir, name), encoding='utf-8', errors='replace') as file:
+			for line in file:
+				match = pattern.search(line)
+				if match: received.add((int(match.group(1)), int(match.group(2))))
+	return len(received)
+
+async def main(args):
+	run = uuid.uuid4().hex[:8]
+	start = time.monotonic()
+	device_class = {'udp': UdpDevice, 'tcp': TcpDevice, 'http': HttpDevice}[args.protocol]
+	devices = [device_class(args, i, run, start) for i in range(args.devices)]
+	await asyncio.gather(*(device.open() for device in devices))
+	print("run={} devices={} rate={} lines/s per device duration={}s".format(run, args.devices, args.rate, args.duration))
+
+	start = time.monotonic()
+	await asyncio.gather(*(device.send(start + args.duration) for device in devices))
+	elapsed = time.monotonic() - start
+	sent = sum(device.sent for device in devices)
+	failed = sum(device.failed for device in devices)
+	print("sent={} failed={} elapsed={:.1f}s sustained={:.0f} lines/s".format(sent, failed, elapsed, (sent - failed) / elapsed))
+
+	if args.outdir:
+		# Wait for the collector to write its buffers
+		await asyncio.sleep(args.settle)
+		received = count_received(args.outdir, run)
+		print("received={} dropped={} drop rate={:.3f}%".format(received, sent - received, 100.0 * (sent - received) / max(sent, 1)))
+
+if __name__ == '__main__':
+	parser = argparse.ArgumentParser()
+	parser.add_argument('--protocol', choices=['udp', 'tcp', 'http'], default='udp')
+	parser.add_argument('--host', help='collector address', default='127.0.0.1')
+	parser.add_argument('--port', type=int, help='collector port', default=6789)
+	parser.add_argument('--devices', type=int, help='number of simulated devices', default=100)
+	parser.add_argument('--rate', type=float, help='records per second of each device', default=100)
+	parser.add_argument('--duration', type=float, help='seconds to send', default=10)
+	parser.add_argument('--batch', type=int, help='records per UDP datagram', default=1)
+	parser.add_argument('--sequence', action='store_true', help='start each UDP datagram with a sequence frame')
+	parser.add_argument('--source', help='loopback address of the first device', default='127.1.0.1')
+	parser.add_argument('--outdir', help='directory of the collector files, to count the lost records')
+	parser.add_argument('--settle', type=float, help='seconds to wait for the collector before counting', default=2)
+	args = parser.parse_args()
+	asyncio.run(main(args))
@@ -0,0 +1,446 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Decoder for the binary records of esp-idf-net-logging.
+# Text records are passed through as is.
+# A binary record starts with a NUL byte:
+# [0]=0x00 [1]=type [2-3]=total length (little endian)
+
+import json
+import re
+import struct
+import zlib
+
+FRAME_MARKER = 0x00
+FRAME_HEADER_SIZE = 4
+FRAME_TYPE_DEFERRED = ord('D')
+FRAME_TYPE_COMPACT = ord('C')
+FRAME_TYPE_TAG = ord('T')
+FRAME_TYPE_BASE = ord('B')
+FRAME_TYPE_COMPRESSED = ord('Z')
+FRAME_TYPE_FRAGMENT = ord('F')
+FRAME_TYPE_SEQUENCE = ord('S')
+SEQUENCE_FRAME_SIZE = FRAME_HEADER_SIZE + 10
+FRAGMENT_HEADER_SIZE = FRAME_HEADER_SIZE + 4
+FRAGMENT_LAST = 0x8000
+COMPRESS_HEADER_SIZE = FRAME_HEADER_SIZE + 2
+COMPRESS_ENCODING = 'x-netlog-lz4'
+
+# Preset dictionary, must be the same as dictionary in compress.c
+COMPRESS_DICTIONARY = (
+	b"\033[0;31mE (\033[0;33mW (\033[0;32mI (\033[0m\nD (V ("
+	b" wifi:wifi_init: esp_netif_handlers: sta ip: , mask: , gw: "
+	b" phy_init: cpu_start: heap_init: spi_flash: system_api: app_start: "
+	b"connected disconnected failed error timeout ready start stop "
+	b" MAIN: ")
+
+LEVEL_LETTER = 'NEWIDV'
+# Same colors as esp_log.h
+LEVEL_COLOR = ['', '\033[0;31m', '\033[0;33m', '\033[0;32m', '', '']
+RESET_COLOR = '\033[0m'
+
+# %[flags][width][.precision][length]conversion
+SPEC = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|z|j|t)?([diouxXcfFeEgGaAsp%])')
+
+class ElfStrings:
+	"""Read format strings from the string table of the application ELF."""
+	def __init__(self, path):
+		from elftools.elf.elffile import ELFFile
+		from elftools.elf.constants import SH_FLAGS
+		self.file = open(path, 'rb')
+		elf = ELFFile(self.file)
+		self.sections = []
+		for section in elf.iter_sections():
+			if section['sh_flags'] & SH_FLAGS.SHF_ALLOC == 0: continue
+			if section['sh_type'] == 'SHT_NOBITS' or section['sh_size'] == 0: continue
+			self.sections.append((section['sh_addr'], section['sh_size'], section.data()))
+		self.cache = {}
+
+	def string(self, address):
+		if address in self.cache: return self.cache[address]
+		for (start, size, data) in self.sections:
+			if start <= address < start + size:
+				offset = address - start
+				end = data.find(b'\0', offset)
+				text = data[offset:end].decode('utf-8', errors='replace')
+				self.cache[address] = text
+				return text
+		return None
+
+def format_deferred(fmt, args):
+	"""Format raw arguments with a C format string."""
+	output = []
+	pos = 0
+	last = 0
+
+	def take(size, signed):
+		nonlocal pos
+		value = int.from_bytes(args[pos:pos+size], 'little', signed=signed)
+		pos += size
+		return value
+
+	def narrow(value, length, signed):
+		# char and short arguments are passed as int and converted back by printf
+		bits = {'hh': 8, 'h': 16}.get(length)
+		if bits is None: return value
+		value &= (1 << bits) - 1
+		if signed and value >> (bits - 1): value -= 1 << bits
+		return value
+
+	for match in SPEC.finditer(fmt):
+		output.append(fmt[last:match.start()])
+		last = match.end()
+		flags, width, precision, length, conversion = match.groups()
+		if conversion == '%':
+			output.append('%')
+			continue
+		if width == '*': width = str(take(4, True))
+		if precision == '*':
+			# A negative precision is taken as if it were missing
+			precision = take(4, True)
+			precision = str(precision) if precision >= 0 else None
+		spec = '%' + flags + (width or '') + ('.' + precision if precision is not None else '')
+		size = 8 if length in ('ll', 'j') else 4
+		if conversion in 'di':
+			output.append((spec + 'd') % narrow(take(size, True), length, True))
+		elif conversion in 'ouxX':
+			output.append((spec + conversion) % narrow(take(size, False), length, False))
+		elif conversion == 'c':
+			output.append((spec + 'c') % take(4, False))
+		elif conversion in 'fFeEgG':
+			value = struct.unpack_from('<d', args, pos)[0]
+			pos += 8
+			output.append((spec + conversion) % value)
+		elif conversion in 'aA':
+			value = struct.unpack_from('<d', args, pos)[0]
+			pos += 8
+			output.append(value.hex())
+		elif conversion == 's':
+			end = args.index(b'\0', pos)
+			value = args[pos:end].decode('utf-8', errors='replace')
+			pos = end + 1
+			output.append((spec + 's') % value)
+		elif conversion == 'p':
+			output.append('0x%x' % take(4, False))
+	output.append(fmt[last:])
+	return ''.join(output)
+
+def lz4_decompress(block, dictionary=COMPRESS_DICTIONARY):
+	"""Decompress one LZ4 block that was compressed with a preset dictionary."""
+	output = bytearray(dictionary)
+	pos = 0
+	while pos < len(block):
+		token = block[pos]
+		pos += 1
+		length = token >> 4
+		if length == 15:
+			while True:
+				byte = block[pos]
+				pos += 1
+				length += byte
+				if byte != 255: break
+		output += block[pos:pos+length]
+		pos += length
+		# The last sequence has no match
+		if pos >= len(block): break
+		offset = block[pos] | (block[pos+1] << 8)
+		pos += 2
+		length = token & 0x0f
+		if length == 15:
+			while True:
+				byte = block[pos]
+				pos += 1
+				length += byte
+				if byte != 255: break
+		length += 4
+		start = len(output) - offset
+		if offset >= length:
+			output += output[start:start+length]
+		else:
+			# Overlapping match repeats the last bytes
+			for i in range(length):
+				output.append(output[start+i])
+	return bytes(output[len(dictionary):])
+
+def decompress_frame(frame):
+	"""Return the records in a compressed frame, or the data as is."""
+	if len(frame) >= COMPRESS_HEADER_SIZE and frame[0] == FRAME_MARKER and frame[1] == FRAME_TYPE_COMPRESSED:
+		length = struct.unpack_from('<H', frame, FRAME_HEADER_SIZE)[0]
+		frame_length = struct.unpack_from('<H', frame, 2)[0]
+		data = lz4_decompress(frame[COMPRESS_HEADER_SIZE:frame_length])
+		if len(data) != length: raise ValueError('compressed frame length mismatch')
+		return data
+	return frame
+
+def read_varint(data, pos):
+	value = 0
+	shift = 0
+	while True:
+		byte = data[pos]
+		pos += 1
+		value |= (byte & 0x7f) << shift
+		shift += 7
+		if byte < 0x80: return value, pos
+
+class RecordParser:
+	"""Split a byte stream into text and decoded binary records.
+	Use one parser per connection, or one per source address for UDP
+	and call new_datagram() before each datagram."""
+	def __init__(self, elf=None):
+		self.elf = elf
+		self.pending = b''
+		# State of the compact format
+		self.tags = {}
+		self.timestamp = 0
+		# Long records being put together: id -> (next index, text)
+		self.fragments = {}
+		# (boot id, sequence number, record count) of the current datagram
+		self.sequence = None
+
+	def new_datagram(self):
+		"""The compact format state is per datagram, fragments continue across datagrams."""
+		self.pending = b''
+		self.tags = {}
+		self.timestamp = 0
+		self.sequence = None
+
+	def decode_fragment(self, frame):
+		record_id, index = struct.unpack_from('<HH', frame, FRAME_HEADER_SIZE)
+		last = index & FRAGMENT_LAST
+		index &= ~FRAGMENT_LAST
+		text = frame[FRAGMENT_HEADER_SIZE:]
+		lost = ''
+		if index == 0:
+			if record_id in self.fragments: lost = '[fragments lost]\n'
+			self.fragments[record_id] = (0, b'')
+		elif record_id not in self.fragments or self.fragments[record_id][0] != index:
+			# Drop the whole record, the rest of it is not usable
+			self.fragments.pop(record_id, None)
+			return '[fragments lost]\n'
+		self.fragments[record_id] = (index + 1, self.fragments[record_id][1] + text)
+		if not last: return lost or None
+		text = self.fragments.pop(record_id)[1].decode('utf-8', errors='replace')
+		# A truncated record has no line end
+		if not text.endswith('\n'): text += '\n'
+		return lost + text
+
+	def decode_compact(self, frame):
+		zigzag, pos = read_varint(frame, FRAME_HEADER_SIZE)
+		delta = (zigzag >> 1) ^ -(zigzag & 1)
+		self.timestamp = (self.timestamp + delta) & 0xffffffff
+		flags = frame[pos]
+		tag_id, pos = read_varint(frame, pos + 1)
+		if tag_id == 0:
+			end = frame.index(b'\0', pos)
+			tag = frame[pos:end].decode('utf-8', errors='replace')
+			pos = end + 1
+		else:
+			tag = self.tags.get(tag_id, '#{}'.format(tag_id))
+		level = flags & 0x07
+		message = frame[pos:].decode('utf-8', errors='replace')
+		if level >= len(LEVEL_LETTER): level = 0
+		color = LEVEL_COLOR[level] if flags & 0x80 else ''
+		return '{}{} ({}) {}: {}{}\n'.format(color, LEVEL_LETTER[level], self.timestamp, tag, message, RESET_COLOR if color else '')
+
+	def decode_frame(self, frame):
+		if frame[1] == FRAME_TYPE_COMPACT:
+			return self.decode_compact(frame)
+		if frame[1] == FRAME_TYPE_TAG:
+			self.tags[frame[FRAME_HEADER_SIZE]] = frame[FRAME_HEADER_SIZE+1:].decode('utf-8', errors='replace')
+			return None
+		if frame[1] == FRAME_TYPE_BASE:
+			self.timestamp = struct.unpack_from('<I', frame, FRAME_HEADER_SIZE)[0]
+			return None
+		if frame[1] == FRAME_TYPE_COMPRESSED:
+			# Records in a compressed frame are always complete
+			records, pending = self.split(decompress_frame(frame))
+			return ''.join(records)
+		if frame[1] == FRAME_TYPE_FRAGMENT:
+			return self.decode_fragment(frame)
+		if frame[1] == FRAME_TYPE_SEQUENCE:
+			self.sequence = struct.unpack_from('<IIH', frame, FRAME_HEADER_SIZE)
+			return None
+		if frame[1] == FRAME_TYPE_DEFERRED:
+			address = struct.unpack_from('<I', frame, FRAME_HEADER_SIZE)[0]
+			fmt = self.elf.string(address) if self.elf else None
+			if fmt is None:
+				return "[deferred record fmt=0x{:08x}, start with --elf to decode]\n".format(address)
+			return format_deferred(fmt, frame[FRAME_HEADER_SIZE+4:])
+		return "[unknown record type 0x{:02x}]\n".format(frame[1])
+
+	def feed(self, data):
+		records, self.pending = self.split(self.pending + data)
+		return records
+
+	def split(self, data):
+		"""Split data into records, returns the records and the incomplete rest."""
+		pending = b''
+		records = []
+		while data:
+			marker = data.find(bytes([FRAME_MARKER]))
+			if marker < 0:
+				records.append(data.decode('utf-8', errors='replace'))
+				break
+			if marker > 0:
+				records.append(data[:marker].decode('utf-8', errors='replace'))
+				data = data[marker:]
+			if len(data) < FRAME_HEADER_SIZE:
+				pending = data
+				break
+			length = struct.unpack_from('<H', data, 2)[0]
+			if length < FRAME_HEADER_SIZE:
+				# Not a valid frame, skip the marker
+				data = data[1:]
+				continue
+			if len(data) < length:
+				pending = data
+				break
+			record = self.decode_frame(data[:length])
+			if record is not None: records.append(record)
+			data = data[length:]
+		return records, pending
+
+# RFC 5424: <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID SD [MSG]
+SYSLOG_MESSAGE = re.compile(r'<(\d{1,3})>1 (\S+) (\S+) (\S+) (\S+) (\S+) (-|(?:\[(?:[^"\]]|"(?:[^"\\]|\\.)*")*\])+)(?: (.*))?', re.S)
+# Syslog severity 0-7 as ESP level letters, N for notice
+SEVERITY_LETTER = 'EEEEWNID'
+GELF_CHUNK_MAGIC = b'\x1e\x0f'
+GELF_CHUNK_HEADER_SIZE = 12
+GELF_CHUNK_MAX = 128
+
+def parse_syslog(data):
+	"""Check one RFC 5424 message and return its fields."""
+	text = data.decode('utf-8', errors='replace') if isinstance(data, bytes) else data
+	match = SYSLOG_MESSAGE.fullmatch(text)
+	if match is None: raise ValueError('not an RFC 5424 message')
+	pri = int(match.group(1))
+	if pri > 191: raise ValueError('PRI out of range')
+	if len(match.group(4)) > 48: raise ValueError('APP-NAME too long')
+	return {
+		'facility': pri >> 3, 'severity': pri & 7, 'timestamp': match.group(2),
+		'host': match.group(3), 'app': match.group(4), 'sd': match.group(7),
+		'message': match.group(8) or ''}
+
+def format_syslog(fields):
+	return '{} {} {}[{}]: {}\n'.format(fields['timestamp'], fields['host'], fields['app'],
+		SEVERITY_LETTER[fields['severity']], fields['message'])
+
+class OctetCounting:
+	"""Split a TCP stream of "LEN SP MSG" frames (RFC 6587)."""
+	def __init__(self):
+		self.pending = b''
+
+	def feed(self, data):
+		self.pending += data
+		messages = []
+		while True:
+			space = self.pending.find(b' ')
+			if space < 0:
+				# Wait for the rest of the count
+				if len(self.pending) > 5 or (self.pending and not self.pending.isdigit()):
+					raise ValueError('octet count expected')
+				break
+			count = self.pending[:space]
+			if not count.isdigit() or count.startswith(b'0'): raise ValueError('bad octet count {!r}'.format(count))
+			end = space + 1 + int(count)
+			if len(self.pending) < end: break
+			messages.append(self.pending[space+1:end])
+			self.pending = self.pending[end:]
+		return messages
+
+class GelfReassembler:
+	"""Put chunked GELF messages together, one instance per source address."""
+	def __init__(self):
+		# message id -> {sequence number: data}
+		self.chunks = {}
+
+	def feed(self, datagram):
+		"""Return the decoded message, or None while chunks are missing."""
+		if datagram[:2] == GELF_CHUNK_MAGIC:
+			if len(datagram) < GELF_CHUNK_HEADER_SIZE: raise ValueError('short GELF chunk')
+			message_id = datagram[2:10]
+			index, count = datagram[10], datagram[11]
+			if count == 0 or count > GELF_CHUNK_MAX or index >= count: raise ValueError('bad GELF chunk sequence')
+			chunks = self.chunks.setdefault(message_id, {})
+			chunks[index] = datagram[GELF_CHUNK_HEADER_SIZE:]
+			if len(chunks) < count: return None
+			del self.chunks[message_id]
+			datagram = b''.join(chunks[i] for i in range(count))
+		if datagram[:2] == b'\x1f\x8b' or datagram[:1] == b'\x78':
+			datagram = zlib.decompress(datagram, zlib.MAX_WBITS | 32)
+		message = json.loads(datagram)
+		for field in ('version', 'host', 'short_message'):
+			if field not in message: raise ValueError('GELF field {} missing'.format(field))
+		return message
+
+def format_gelf(message):
+	return '{} {}[{}]: {}\n'.format(message['host'], message.get('_tag', '-'),
+		SEVERITY_LETTER[message.get('level', 1) & 7], message['short_message'])
+
+class LossTracker:
+	"""Lost, reordered and duplicated datagrams of one device, from the sequence frames."""
+	# A missing datagram that has not arrived within this many datagrams is lost for good
+	WINDOW = 1024
+
+	def __init__(self):
+		self.boot_id = None
+		self.reboots = 0
+		self.received = 0
+		self.records = 0
+		self.first = 0
+		self.highest = -1
+		self.missing = set()
+		self.expired = 0
+		self.gaps = 0
+		self.reordered = 0
+		self.reorder_depth = 0
+		self.duplicates = 0
+
+	def update(self, boot_id, sequence, records):
+		"""Account one datagram, returns the number of datagrams missing before it."""
+		if boot_id != self.boot_id:
+			# The sequence starts again after a reboot, the totals are kept
+			if self.boot_id is not None: self.reboots += 1
+			self.boot_id = boot_id
+			self.expired += len(self.missing)
+			self.missing = set()
+			self.first = sequence
+			self.highest = sequence - 1
+		self.received += 1
+		self.records += records
+		if sequence > self.highest:
+			gap = sequence - self.highest - 1
+			if gap:
+				self.gaps += 1
+				if gap > self.WINDOW:
+					self.expired += gap - self.WINDOW
+					self.missing.update(range(sequence - self.WINDOW, sequence))
+				else:
+					self.missing.update(range(self.highest + 1, sequence))
+			self.highest = sequence
+			# Forget the oldest missing datagrams
+			if len(self.missing) > self.WINDOW:
+				old = [s for s in self.missing if s < sequence - self.WINDOW]
+				self.missing.difference_update(old)
+				self.expired += len(old)
+			return gap
+		if sequence in self.missing:
+			self.missing.remove(sequence)
+			self.reordered += 1
+			self.reorder_depth = max(self.reorder_depth, self.highest - sequence)
+		else:
+			self.duplicates += 1
+		return 0
+
+	@property
+	def lost(self):
+		return self.expired + len(self.missing)
+
+	@property
+	def loss_ratio(self):
+		expected = self.received - self.duplicates + self.lost
+		return self.lost / expected if expected else 0.0
+
+def open_elf(path):
+	if path is None: return None
+	return ElfStrings(path)
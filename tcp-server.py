@@ -4,6 +4,7 @@ import signal
 import socket
 import select
 import argparse
+import netlog
 
 def handler(signal, frame):
 	global running
@@ -16,6 +17,8 @@ if __name__ == "__main__":
 
 	parser = argparse.ArgumentParser()
 	parser.add_argument('--port', type=int, help='tcp port', default=8080)
+	parser.add_argument('--elf', help='application ELF to format deferred records')
+	parser.add_argument('--format', choices=['raw', 'syslog'], default='raw', help='record format selected in menuconfig')
 	args = parser.parse_args()
 	print("args.port={}".format(args.port))
 
@@ -32,18 +35,33 @@ if __name__ == "__main__":
 	tcp_server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
 	tcp_server.bind((server_ip, args.port))
 	tcp_server.listen(listen_num)
-	client,address = tcp_server.accept()
-	#print("Connected!! [ Source : {}]".format(address))
-	client.setblocking(0)
-
+	elf = netlog.open_elf(args.elf)
 	while running:
-		ready = select.select([client], [], [], 1)
-		#print("ready={}".format(ready[0]))
-		if ready[0]:
-			data = client.recv(buffer_size)
-			if (type(data) is bytes):
-				data = data.decode('utf-8')
+		client,address = tcp_server.accept()
+		#print("Connected!! [ Source : {}]".format(address))
+		client.setblocking(0)
+		# Binary records of each connection start with a new state
+		record_parser = netlog.RecordParser(elf)
+		# Syslog messages are framed by octet counting
+		syslog_framing = netlog.OctetCounting()
+
+		while running:
+			ready = select.select([client], [], [], 1)
+			#print("ready={}".format(ready[0]))
+			if ready[0]:
+				data = client.recv(buffer_size)
 				#print("[*] Received Data : {}".format(data))
-				print(data, end='')
-	
-	client.close()
+				if not data: break
+				if args.format == 'syslog':
+					try:
+						for message in syslog_framing.feed(data):
+							print(netlog.format_syslog(netlog.parse_syslog(message)), end='')
+					except ValueError as e:
+						# The stream cannot be resynchronized
+						print("[invalid syslog message: {}]".format(e))
+						break
+					continue
+				for record in record_parser.feed(data):
+					print(record, end='')
+
+		client.close()
@@ -4,12 +4,17 @@
 import sys
 import select, socket
 import argparse
+import netlog
 
 if __name__ == "__main__":
 	parser = argparse.ArgumentParser()
 	parser.add_argument('--port', type=int, help='tcp port', default=6789)
+	parser.add_argument('--elf', help='application ELF to format deferred records')
+	parser.add_argument('--format', choices=['raw', 'syslog', 'gelf'], default='raw', help='record format selected in menuconfig')
+	parser.add_argument('--control', help='filter settings sent to each device, e.g. "*=W wifi=D"')
 	args = parser.parse_args()
 	print("args.port={}".format(args.port))
+	elf = netlog.open_elf(args.elf)
 
 	server_ip = "0.0.0.0" # Both Limited Broadcast/Directed Broadcast/Unicast
 	#server_ip = "255.255.255.255" # Only Limited broadcast
@@ -23,11 +28,44 @@ if __name__ == "__main__":
 	print("+==========================+")
 	print("")
 
+	# Long records are split over several datagrams, so each device has its own parser
+	parsers = {}
+	# Sequence frames of each device
+	trackers = {}
 	while True:
 		result = select.select([sock],[],[])
-		data = result[0][0].recv(1024)
-		if (type(data) is bytes):
-			data = data.decode('utf-8')
-		print(data, end='')
+		# One datagram may contain multiple records
+		data, address = result[0][0].recvfrom(65535)
+		if address not in parsers:
+			if args.format == 'gelf':
+				parsers[address] = netlog.GelfReassembler()
+			else:
+				parsers[address] = netlog.RecordParser(elf)
+			# The device reads control packets on the socket it sends from
+			if args.control: sock.sendto(args.control.encode(), address)
+		parser = parsers[address]
+		# Syslog and GELF send one message per datagram
+		try:
+			if args.format == 'syslog':
+				print(netlog.format_syslog(netlog.parse_syslog(data)), end='')
+				continue
+			if args.format == 'gelf':
+				message = parser.feed(data)
+				if message is not None: print(netlog.format_gelf(message), end='')
+				continue
+		except ValueError as e:
+			print("[invalid {} message from {}: {}]".format(args.format, address, e))
+			continue
+		parser.new_datagram()
+		records = parser.feed(data)
+		if parser.sequence is not None:
+			tracker = trackers.setdefault(address, netlog.LossTracker())
+			reboots = tracker.reboots
+			lost = tracker.update(*parser.sequence)
+			if tracker.reboots != reboots: print("[{} restarted]".format(address[0]))
+			if lost: print("[{} datagrams lost, {:.2f}% so far]".format(lost, 100 * tracker.loss_ratio))
+		for text in records:
+			for record in text.splitlines(keepends=True):
+				print(record, end='')
 
 